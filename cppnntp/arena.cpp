@@ -0,0 +1,64 @@
+#include <algorithm>
+#include "arena.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	arena::arena() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	arena::~arena() {}
+
+	/**
+	 * Copy a string into the arena.
+	 *
+	 * @public
+	 *
+	 * @param   data = The chars to copy.
+	 * @param length = The amount of chars to copy.
+	 * @return The offset of the string inside the arena.
+	 */
+	unsigned long arena::append(const char *data, const unsigned long &length) {
+		unsigned long offset = buffer.length();
+		buffer.append(data, length);
+		return offset;
+	}
+
+	/**
+	 * Amount of chars stored in the arena.
+	 *
+	 * @public
+	 */
+	unsigned long arena::size() const {
+		return buffer.length();
+	}
+
+	/**
+	 * Reserve space for a known amount of chars.
+	 *
+	 * @note Grows to at least twice the capacity, so reserving a
+	 * bit more on every call does not copy the arena each time.
+	 * @public
+	 *
+	 * @param length = The amount of chars.
+	 */
+	void arena::reserve(const unsigned long &length) {
+		if (buffer.capacity() < length)
+			buffer.reserve(std::max<unsigned long>(length, buffer.capacity() * 2));
+	}
+
+	/**
+	 * Remove every string from the arena, keep the memory.
+	 *
+	 * @public
+	 */
+	void arena::clear() {
+		buffer.clear();
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstring>
+#include <string>
+
+namespace cppnntp
+{
+	/**
+	 * A view of a string stored in an arena (or a mapped file).
+	 *
+	 * @note The pointer is only valid until the arena it points into
+	 * is modified or destroyed.
+	 */
+	struct field
+	{
+		/**
+		 * First char of the string (not NUL terminated).
+		 */
+		const char *data;
+
+		/**
+		 * Amount of chars in the string.
+		 */
+		unsigned long length;
+
+		/**
+		 * Copy the field into a std::string.
+		 *
+		 * @public
+		 *
+		 * @return The copy.
+		 */
+		std::string str() const {
+			return std::string(data, length);
+		}
+
+		/**
+		 * Compare the field to a string.
+		 *
+		 * @public
+		 *
+		 * @param other = The string to compare to.
+		 * @return bool = Are they equal?
+		 */
+		bool operator==(const std::string &other) const {
+			return length == other.length()
+				&& (length == 0 || std::memcmp(data, other.data(), length) == 0);
+		}
+	};
+
+	class arena
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		arena();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~arena();
+
+		/**
+		 * Copy a string into the arena.
+		 *
+		 * @public
+		 *
+		 * @param   data = The chars to copy.
+		 * @param length = The amount of chars to copy.
+		 * @return The offset of the string inside the arena.
+		 */
+		unsigned long append(const char *data, const unsigned long &length);
+
+		/**
+		 * Get a view of a string stored in the arena.
+		 *
+		 * @public
+		 *
+		 * @param offset = The offset returned by append.
+		 * @param length = The length passed to append.
+		 * @return The view.
+		 */
+		field view(const unsigned long &offset, const unsigned long &length) const {
+			field f = { buffer.data() + offset, length };
+			return f;
+		}
+
+		/**
+		 * Amount of chars stored in the arena.
+		 *
+		 * @public
+		 */
+		unsigned long size() const;
+
+		/**
+		 * Reserve space for a known amount of chars.
+		 *
+		 * @note Grows to at least twice the capacity, so reserving a
+		 * bit more on every call does not copy the arena each time.
+		 * @public
+		 *
+		 * @param length = The amount of chars.
+		 */
+		void reserve(const unsigned long &length);
+
+		/**
+		 * Remove every string from the arena, keep the memory.
+		 *
+		 * @public
+		 */
+		void clear();
+
+	private:
+		/**
+		 * Every string in the arena, back to back.
+		 *
+		 * @private
+		 */
+		std::string buffer;
+	};
+}
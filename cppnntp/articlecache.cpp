@@ -0,0 +1,224 @@
+#include "articlecache.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param budget = Most bytes of bodies to keep.
+	 */
+	articlecache::articlecache(const unsigned long &budget)
+		: limit(budget), found(0), notfound(0), evicted(0) {
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	articlecache::~articlecache() {}
+
+	/**
+	 * Look up a body.
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id, with the < and >.
+	 * @param      data = Where the body is stored.
+	 * @return     bool = Was it cached?
+	 */
+	bool articlecache::get(const std::string &messageid, std::string &data) {
+		std::lock_guard<std::mutex> guard(lock);
+		std::unordered_map<std::string, unsigned long>::const_iterator it = slots.find(messageid);
+		if (it == slots.end()) {
+			notfound++;
+			return false;
+		}
+		entry &e = entries[it->second];
+		e.referenced = true;
+		data = e.data;
+		found++;
+		return true;
+	}
+
+	/**
+	 * Add or replace a body, evicting others until it fits.
+	 *
+	 * @note Bodies larger than the budget are not cached.
+	 * @public
+	 *
+	 * @param messageid = The message-id, with the < and >.
+	 * @param      data = The body.
+	 */
+	void articlecache::put(const std::string &messageid, const std::string &data) {
+		std::lock_guard<std::mutex> guard(lock);
+		std::unordered_map<std::string, unsigned long>::const_iterator it = slots.find(messageid);
+		if (it != slots.end())
+			remove(it->second);
+		if (data.length() > limit)
+			return;
+
+		evict(data.length());
+
+		unsigned long slot;
+		if (!freeslots.empty()) {
+			slot = freeslots.back();
+			freeslots.pop_back();
+		} else {
+			slot = entries.size();
+			entries.push_back(entry());
+		}
+
+		// New bodies start unreferenced, a body read once is the first
+		// to go when the hand comes by.
+		entry &e = entries[slot];
+		e.messageid = messageid;
+		e.data = data;
+		e.referenced = false;
+		e.used = true;
+		slots[messageid] = slot;
+		bytes += data.length();
+	}
+
+	/**
+	 * Remove a body.
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id, with the < and >.
+	 */
+	void articlecache::erase(const std::string &messageid) {
+		std::lock_guard<std::mutex> guard(lock);
+		std::unordered_map<std::string, unsigned long>::const_iterator it = slots.find(messageid);
+		if (it != slots.end())
+			remove(it->second);
+	}
+
+	/**
+	 * Remove every body, the counters are kept.
+	 *
+	 * @public
+	 */
+	void articlecache::clear() {
+		std::lock_guard<std::mutex> guard(lock);
+		entries.clear();
+		freeslots.clear();
+		slots.clear();
+		hand = 0;
+		bytes = 0;
+	}
+
+	/**
+	 * Change the byte budget, evicting bodies if needed.
+	 *
+	 * @public
+	 *
+	 * @param budget = Most bytes of bodies to keep.
+	 */
+	void articlecache::setbudget(const unsigned long &budget) {
+		std::lock_guard<std::mutex> guard(lock);
+		limit = budget;
+		evict(0);
+	}
+
+	/**
+	 * The byte budget.
+	 *
+	 * @public
+	 */
+	unsigned long articlecache::budget() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return limit;
+	}
+
+	/**
+	 * Bytes of bodies cached.
+	 *
+	 * @public
+	 */
+	unsigned long articlecache::size() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return bytes;
+	}
+
+	/**
+	 * Amount of bodies cached.
+	 *
+	 * @public
+	 */
+	unsigned long articlecache::count() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return slots.size();
+	}
+
+	/**
+	 * Amount of lookups that found the body.
+	 *
+	 * @public
+	 */
+	unsigned long articlecache::hits() const {
+		return found;
+	}
+
+	/**
+	 * Amount of lookups that did not find the body.
+	 *
+	 * @public
+	 */
+	unsigned long articlecache::misses() const {
+		return notfound;
+	}
+
+	/**
+	 * Amount of bodies evicted to make room.
+	 *
+	 * @public
+	 */
+	unsigned long articlecache::evictions() const {
+		return evicted;
+	}
+
+	/**
+	 * Empty a slot.
+	 *
+	 * @private
+	 *
+	 * @param slot = The slot, must be used.
+	 */
+	void articlecache::remove(const unsigned long &slot) {
+		// slot can point into the map entry erased below.
+		const unsigned long position = slot;
+		entry &e = entries[position];
+		slots.erase(e.messageid);
+		bytes -= e.data.length();
+		// Give the memory back, not just the length.
+		std::string().swap(e.data);
+		std::string().swap(e.messageid);
+		e.used = false;
+		freeslots.push_back(position);
+	}
+
+	/**
+	 * Evict bodies until there is room for more bytes.
+	 *
+	 * @private
+	 *
+	 * @param needed = Bytes to make room for.
+	 */
+	void articlecache::evict(const unsigned long &needed) {
+		while (bytes > 0 && bytes + needed > limit) {
+			if (hand >= entries.size())
+				hand = 0;
+			entry &e = entries[hand];
+			if (e.used) {
+				if (e.referenced)
+					e.referenced = false;
+				else {
+					remove(hand);
+					evicted++;
+				}
+			}
+			hand++;
+		}
+	}
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cppnntp
+{
+	/**
+	 * In memory cache of article bodies keyed by message-id, bounded
+	 * by a byte budget.
+	 *
+	 * @note Eviction is CLOCK (second chance): a hit marks the entry,
+	 * the hand skips (and unmarks) marked entries, so recently used
+	 * bodies stay while the scan costs nothing on a hit.
+	 * Thread safe, get and put copy the data.
+	 */
+	class articlecache
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param budget = Most bytes of bodies to keep.
+		 */
+		articlecache(const unsigned long &budget = 268435456);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~articlecache();
+
+		/**
+		 * Look up a body.
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id, with the < and >.
+		 * @param      data = Where the body is stored.
+		 * @return     bool = Was it cached?
+		 */
+		bool get(const std::string &messageid, std::string &data);
+
+		/**
+		 * Add or replace a body, evicting others until it fits.
+		 *
+		 * @note Bodies larger than the budget are not cached.
+		 * @public
+		 *
+		 * @param messageid = The message-id, with the < and >.
+		 * @param      data = The body.
+		 */
+		void put(const std::string &messageid, const std::string &data);
+
+		/**
+		 * Remove a body.
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id, with the < and >.
+		 */
+		void erase(const std::string &messageid);
+
+		/**
+		 * Remove every body, the counters are kept.
+		 *
+		 * @public
+		 */
+		void clear();
+
+		/**
+		 * Change the byte budget, evicting bodies if needed.
+		 *
+		 * @public
+		 *
+		 * @param budget = Most bytes of bodies to keep.
+		 */
+		void setbudget(const unsigned long &budget);
+
+		/**
+		 * The byte budget.
+		 *
+		 * @public
+		 */
+		unsigned long budget() const;
+
+		/**
+		 * Bytes of bodies cached.
+		 *
+		 * @public
+		 */
+		unsigned long size() const;
+
+		/**
+		 * Amount of bodies cached.
+		 *
+		 * @public
+		 */
+		unsigned long count() const;
+
+		/**
+		 * Amount of lookups that found the body.
+		 *
+		 * @public
+		 */
+		unsigned long hits() const;
+
+		/**
+		 * Amount of lookups that did not find the body.
+		 *
+		 * @public
+		 */
+		unsigned long misses() const;
+
+		/**
+		 * Amount of bodies evicted to make room.
+		 *
+		 * @public
+		 */
+		unsigned long evictions() const;
+
+	private:
+		/**
+		 * A cached body.
+		 *
+		 * @private
+		 */
+		struct entry
+		{
+			std::string messageid;
+			std::string data;
+
+			/**
+			 * Used since the hand last passed?
+			 */
+			bool referenced;
+
+			/**
+			 * Does the slot hold a body?
+			 */
+			bool used;
+		};
+
+		/**
+		 * The slots, the hand walks over them.
+		 *
+		 * @private
+		 */
+		std::vector<entry> entries;
+
+		/**
+		 * Empty slots.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned long> freeslots;
+
+		/**
+		 * Message-id to slot.
+		 *
+		 * @private
+		 */
+		std::unordered_map<std::string, unsigned long> slots;
+
+		/**
+		 * Position of the clock hand.
+		 *
+		 * @private
+		 */
+		unsigned long hand = 0;
+
+		/**
+		 * Byte budget and bytes cached.
+		 *
+		 * @private
+		 */
+		unsigned long limit;
+		unsigned long bytes = 0;
+
+		/**
+		 * Counters.
+		 *
+		 * @private
+		 */
+		std::atomic<unsigned long> found;
+		std::atomic<unsigned long> notfound;
+		std::atomic<unsigned long> evicted;
+
+		/**
+		 * Protects everything but the counters.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+
+		/**
+		 * Empty a slot.
+		 *
+		 * @private
+		 *
+		 * @param slot = The slot, must be used.
+		 */
+		void remove(const unsigned long &slot);
+
+		/**
+		 * Evict bodies until there is room for more bytes.
+		 *
+		 * @private
+		 *
+		 * @param needed = Bytes to make room for.
+		 */
+		void evict(const unsigned long &needed);
+	};
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstring>
+#include "bufferchain.hpp"
+namespace cppnntp {
+	const unsigned long bufferchain::BLOCK;
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	bufferchain::bufferchain() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	bufferchain::~bufferchain() {}
+
+	/**
+	 * Add bytes to the end.
+	 *
+	 * @public
+	 *
+	 * @param   data = The bytes.
+	 * @param length = Amount of bytes.
+	 */
+	void bufferchain::append(const char *data, const unsigned long &length) {
+		unsigned long done = 0;
+		while (done < length) {
+			unsigned long room;
+			char *space = tail(room);
+			const unsigned long count = std::min(room, length - done);
+			std::memcpy(space, data + done, count);
+			commit(count);
+			done += count;
+		}
+	}
+
+	/**
+	 * Free space at the end of the last block, a block is added
+	 * when it is full. Call commit once bytes are written in it.
+	 *
+	 * @public
+	 *
+	 * @param room = Where the size of the space is stored.
+	 * @return The space.
+	 */
+	char *bufferchain::tail(unsigned long &room) {
+		const unsigned long block = length / BLOCK;
+		if (block == blocks.size())
+			blocks.push_back(std::unique_ptr<char[]>(new char[BLOCK]));
+		room = BLOCK - length % BLOCK;
+		return blocks[block].get() + length % BLOCK;
+	}
+
+	/**
+	 * Bytes were written in the space given by tail.
+	 *
+	 * @public
+	 *
+	 * @param bytes = Amount of bytes, at most the room.
+	 */
+	void bufferchain::commit(const unsigned long &bytes) {
+		length += bytes;
+	}
+
+	/**
+	 * Empty the chain, keep the blocks.
+	 *
+	 * @public
+	 */
+	void bufferchain::clear() {
+		length = 0;
+	}
+
+	/**
+	 * Amount of blocks holding bytes.
+	 *
+	 * @public
+	 */
+	unsigned long bufferchain::chunks() const {
+		return (length + BLOCK - 1) / BLOCK;
+	}
+
+	/**
+	 * The bytes of a block.
+	 *
+	 * @public
+	 *
+	 * @param  index = The block, less than chunks.
+	 * @param length = Where the amount of bytes in it is stored.
+	 * @return The bytes.
+	 */
+	const char *bufferchain::chunk(const unsigned long &index, unsigned long &length) const {
+		length = std::min(BLOCK, this->length - index * BLOCK);
+		return blocks[index].get();
+	}
+
+	/**
+	 * Get the line starting at a position, without its CRLF.
+	 *
+	 * @public
+	 *
+	 * @param position = Where the line starts, moved past its LF.
+	 * @param     data = Where the line is stored, it points in a
+	 * block unless the line crosses 2 blocks, then in scratch.
+	 * @param   length = Where the length of the line is stored.
+	 * @param  scratch = Holds lines that cross blocks.
+	 * @return    bool = Was there a whole line?
+	 */
+	bool bufferchain::line(unsigned long &position, const char *&data, unsigned long &length,
+			std::string &scratch) const {
+		if (position >= this->length)
+			return false;
+
+		// Most lines are within 1 block.
+		const unsigned long offset = position % BLOCK;
+		const char *start = blocks[position / BLOCK].get() + offset;
+		const unsigned long available = std::min(BLOCK - offset, this->length - position);
+		const char *eol = static_cast<const char *>(std::memchr(start, '\n', available));
+		if (eol != NULL) {
+			data = start;
+			length = eol - start;
+		} else {
+			scratch.assign(start, available);
+			unsigned long next = position + available;
+			while (true) {
+				if (next >= this->length)
+					return false;
+				const char *block = blocks[next / BLOCK].get();
+				const unsigned long count = std::min(BLOCK, this->length - next);
+				eol = static_cast<const char *>(std::memchr(block, '\n', count));
+				if (eol != NULL) {
+					scratch.append(block, eol - block);
+					break;
+				}
+				scratch.append(block, count);
+				next += count;
+			}
+			data = scratch.data();
+			length = scratch.length();
+		}
+
+		position += length + 1;
+		if (length > 0 && data[length - 1] == '\r')
+			length--;
+		return true;
+	}
+
+	/**
+	 * Does the chain end with some bytes?
+	 *
+	 * @public
+	 *
+	 * @param suffix = The bytes.
+	 * @param length = Amount of bytes.
+	 */
+	bool bufferchain::endswith(const char *suffix, const unsigned long &length) const {
+		if (length > this->length)
+			return false;
+		const unsigned long start = this->length - length;
+		for (unsigned long i = 0; i < length; i++) {
+			if ((*this)[start + i] != suffix[i])
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Copy bytes to a string.
+	 *
+	 * @public
+	 *
+	 * @param position = The first byte.
+	 * @param   length = Most bytes copied.
+	 * @param      out = Where they are added.
+	 */
+	void bufferchain::copy(const unsigned long &position, const unsigned long &length, std::string &out) const {
+		unsigned long pos = position;
+		const unsigned long last = std::min(this->length, position + length);
+		while (pos < last) {
+			const unsigned long count = std::min(BLOCK - pos % BLOCK, last - pos);
+			out.append(blocks[pos / BLOCK].get() + pos % BLOCK, count);
+			pos += count;
+		}
+	}
+
+	/**
+	 * The whole chain in 1 string.
+	 *
+	 * @public
+	 */
+	std::string bufferchain::flatten() const {
+		std::string out;
+		out.reserve(length);
+		copy(0, length, out);
+		return out;
+	}
+}
@@ -0,0 +1,240 @@
+#pragma once
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cppnntp
+{
+	/**
+	 * A response stored as a chain of fixed size blocks, so a big
+	 * response grows without being moved.
+	 *
+	 * @note The socket reads straight into the free space of the last
+	 * block (see tail and commit). Parsers go over the response line by
+	 * line with line, only a line that crosses 2 blocks is copied. The
+	 * blocks can be read 1 by 1 like an iovec list (see chunk), flatten
+	 * makes 1 string for code that needs it. clear keeps the blocks,
+	 * so a chain kept between responses does not allocate.
+	 */
+	class bufferchain
+	{
+	public:
+		/**
+		 * Size of a block.
+		 *
+		 * @public
+		 */
+		static const unsigned long BLOCK = 65536;
+
+		/**
+		 * Iterates over the bytes, across the blocks.
+		 */
+		class const_iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef char value_type;
+			typedef long difference_type;
+			typedef const char *pointer;
+			typedef const char &reference;
+
+			const_iterator(const bufferchain *chain, const unsigned long &position)
+				: chain(chain), position(position) {}
+
+			const char &operator*() const {
+				return chain->blocks[position / BLOCK][position % BLOCK];
+			}
+
+			const_iterator &operator++() {
+				position++;
+				return *this;
+			}
+
+			const_iterator operator++(int) {
+				const_iterator copy = *this;
+				position++;
+				return copy;
+			}
+
+			bool operator==(const const_iterator &other) const {
+				return position == other.position;
+			}
+
+			bool operator!=(const const_iterator &other) const {
+				return position != other.position;
+			}
+
+			/**
+			 * Position in the chain.
+			 */
+			unsigned long offset() const {
+				return position;
+			}
+
+		private:
+			const bufferchain *chain;
+			unsigned long position;
+		};
+
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		bufferchain();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~bufferchain();
+
+		/**
+		 * Add bytes to the end.
+		 *
+		 * @public
+		 *
+		 * @param   data = The bytes.
+		 * @param length = Amount of bytes.
+		 */
+		void append(const char *data, const unsigned long &length);
+
+		/**
+		 * Free space at the end of the last block, a block is added
+		 * when it is full. Call commit once bytes are written in it.
+		 *
+		 * @public
+		 *
+		 * @param room = Where the size of the space is stored.
+		 * @return The space.
+		 */
+		char *tail(unsigned long &room);
+
+		/**
+		 * Bytes were written in the space given by tail.
+		 *
+		 * @public
+		 *
+		 * @param bytes = Amount of bytes, at most the room.
+		 */
+		void commit(const unsigned long &bytes);
+
+		/**
+		 * Empty the chain, keep the blocks.
+		 *
+		 * @public
+		 */
+		void clear();
+
+		/**
+		 * Amount of bytes.
+		 *
+		 * @public
+		 */
+		unsigned long size() const {
+			return length;
+		}
+
+		/**
+		 * Get a byte.
+		 *
+		 * @public
+		 *
+		 * @param position = Its position, less than size.
+		 */
+		char operator[](const unsigned long &position) const {
+			return blocks[position / BLOCK][position % BLOCK];
+		}
+
+		/**
+		 * Iterators to the first byte and past the last one.
+		 *
+		 * @public
+		 */
+		const_iterator begin() const {
+			return const_iterator(this, 0);
+		}
+
+		const_iterator end() const {
+			return const_iterator(this, length);
+		}
+
+		/**
+		 * Amount of blocks holding bytes.
+		 *
+		 * @public
+		 */
+		unsigned long chunks() const;
+
+		/**
+		 * The bytes of a block.
+		 *
+		 * @public
+		 *
+		 * @param  index = The block, less than chunks.
+		 * @param length = Where the amount of bytes in it is stored.
+		 * @return The bytes.
+		 */
+		const char *chunk(const unsigned long &index, unsigned long &length) const;
+
+		/**
+		 * Get the line starting at a position, without its CRLF.
+		 *
+		 * @public
+		 *
+		 * @param position = Where the line starts, moved past its LF.
+		 * @param     data = Where the line is stored, it points in a
+		 * block unless the line crosses 2 blocks, then in scratch.
+		 * @param   length = Where the length of the line is stored.
+		 * @param  scratch = Holds lines that cross blocks.
+		 * @return    bool = Was there a whole line?
+		 */
+		bool line(unsigned long &position, const char *&data, unsigned long &length,
+				std::string &scratch) const;
+
+		/**
+		 * Does the chain end with some bytes?
+		 *
+		 * @public
+		 *
+		 * @param suffix = The bytes.
+		 * @param length = Amount of bytes.
+		 */
+		bool endswith(const char *suffix, const unsigned long &length) const;
+
+		/**
+		 * Copy bytes to a string.
+		 *
+		 * @public
+		 *
+		 * @param position = The first byte.
+		 * @param   length = Most bytes copied.
+		 * @param      out = Where they are added.
+		 */
+		void copy(const unsigned long &position, const unsigned long &length, std::string &out) const;
+
+		/**
+		 * The whole chain in 1 string.
+		 *
+		 * @public
+		 */
+		std::string flatten() const;
+
+	private:
+		/**
+		 * The blocks, the ones past the used part are kept for reuse.
+		 *
+		 * @private
+		 */
+		std::vector<std::unique_ptr<char[]> > blocks;
+
+		/**
+		 * Amount of bytes.
+		 *
+		 * @private
+		 */
+		unsigned long length = 0;
+	};
+}
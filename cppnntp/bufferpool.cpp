@@ -0,0 +1,251 @@
+#include <sys/mman.h>
+#include "bufferpool.hpp"
+namespace cppnntp {
+	/**
+	 * Size of a huge page.
+	 */
+	static const unsigned long HUGEPAGE = 2097152;
+
+	const unsigned long bufferpool::MINIMUM;
+	const unsigned long bufferpool::MAXIMUM;
+
+	/**
+	 * Constructor, no block.
+	 *
+	 * @public
+	 */
+	bufferpool::buffer::buffer() : pool(NULL), block(NULL), size(0), used(0) {}
+
+	/**
+	 * Move constructor.
+	 *
+	 * @public
+	 */
+	bufferpool::buffer::buffer(buffer &&other)
+		: pool(other.pool), block(other.block), size(other.size), used(other.used) {
+		other.pool = NULL;
+		other.block = NULL;
+		other.size = other.used = 0;
+	}
+
+	/**
+	 * Move assignment, the block this held is given back.
+	 *
+	 * @public
+	 */
+	bufferpool::buffer &bufferpool::buffer::operator=(buffer &&other) {
+		if (this != &other) {
+			release();
+			pool = other.pool;
+			block = other.block;
+			size = other.size;
+			used = other.used;
+			other.pool = NULL;
+			other.block = NULL;
+			other.size = other.used = 0;
+		}
+		return *this;
+	}
+
+	/**
+	 * Destructor, gives the block back.
+	 *
+	 * @public
+	 */
+	bufferpool::buffer::~buffer() {
+		release();
+	}
+
+	/**
+	 * The block, NULL when there is none.
+	 *
+	 * @public
+	 */
+	char *bufferpool::buffer::data() const {
+		return block;
+	}
+
+	/**
+	 * Size of the block.
+	 *
+	 * @public
+	 */
+	unsigned long bufferpool::buffer::capacity() const {
+		return size;
+	}
+
+	/**
+	 * Bytes used in the block.
+	 *
+	 * @public
+	 */
+	unsigned long bufferpool::buffer::length() const {
+		return used;
+	}
+
+	/**
+	 * Set the bytes used, at most the capacity.
+	 *
+	 * @public
+	 *
+	 * @param length = Bytes used.
+	 */
+	void bufferpool::buffer::setlength(const unsigned long &length) {
+		used = length < size ? length : size;
+	}
+
+	/**
+	 * Give the block back.
+	 *
+	 * @public
+	 */
+	void bufferpool::buffer::release() {
+		if (block == NULL)
+			return;
+		if (pool != NULL)
+			pool->put(block, size);
+		else
+			::munmap(block, size);
+		pool = NULL;
+		block = NULL;
+		size = used = 0;
+	}
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param hugepages = Back the blocks of 2MB and more with
+	 * huge pages?
+	 * @param      kept = Most free blocks kept per size class.
+	 */
+	bufferpool::bufferpool(const bool &hugepages, const unsigned long &kept)
+		: hugepages(hugepages), kept(kept), lists(sizeclass(MAXIMUM) + 1) {}
+
+	/**
+	 * Destructor, unmaps the free blocks.
+	 *
+	 * @note Buffers still out must be destroyed before the pool.
+	 * @public
+	 */
+	bufferpool::~bufferpool() {
+		for (unsigned long c = 0; c < lists.size(); c++) {
+			for (unsigned long i = 0; i < lists[c].size(); i++)
+				::munmap(lists[c][i], MINIMUM << c);
+		}
+	}
+
+	/**
+	 * Get a buffer.
+	 *
+	 * @public
+	 *
+	 * @param bytes = Least capacity.
+	 * @return The buffer, without a block if mmap failed.
+	 */
+	bufferpool::buffer bufferpool::get(const unsigned long &bytes) {
+		buffer b;
+		if (bytes > MAXIMUM) {
+			// Not kept, mapped to the page.
+			b.size = (bytes + 4095) & ~4095UL;
+			b.block = map(b.size);
+			if (b.block == NULL)
+				b.size = 0;
+			return b;
+		}
+
+		const unsigned long c = sizeclass(bytes);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (!lists[c].empty()) {
+				b.block = lists[c].back();
+				lists[c].pop_back();
+				hits++;
+			} else
+				misses++;
+		}
+		if (b.block == NULL)
+			b.block = map(MINIMUM << c);
+		if (b.block != NULL) {
+			b.pool = this;
+			b.size = MINIMUM << c;
+		}
+		return b;
+	}
+
+	/**
+	 * Amount of buffers given from the free lists, and mapped.
+	 *
+	 * @public
+	 */
+	unsigned long bufferpool::reused() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return hits;
+	}
+
+	unsigned long bufferpool::mapped() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return misses;
+	}
+
+	/**
+	 * Take a block back.
+	 *
+	 * @private
+	 *
+	 * @param block = The block.
+	 * @param  size = Its size.
+	 */
+	void bufferpool::put(char *block, const unsigned long &size) {
+		const unsigned long c = sizeclass(size);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (lists[c].size() < kept) {
+				lists[c].push_back(block);
+				return;
+			}
+		}
+		::munmap(block, size);
+	}
+
+	/**
+	 * Map a block.
+	 *
+	 * @private
+	 *
+	 * @param size = Its size.
+	 * @return The block, NULL on failure.
+	 */
+	char *bufferpool::map(const unsigned long &size) const {
+		void *block = MAP_FAILED;
+		const bool huge = hugepages && size >= HUGEPAGE && size % HUGEPAGE == 0;
+#ifdef MAP_HUGETLB
+		// Only works with huge pages reserved (vm.nr_hugepages).
+		if (huge)
+			block = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+		if (block == MAP_FAILED) {
+			block = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (block == MAP_FAILED)
+				return NULL;
+#ifdef MADV_HUGEPAGE
+			if (huge)
+				::madvise(block, size, MADV_HUGEPAGE);
+#endif
+		}
+		return static_cast<char *>(block);
+	}
+
+	/**
+	 * Size class of a size.
+	 *
+	 * @private
+	 */
+	unsigned long bufferpool::sizeclass(const unsigned long &size) {
+		unsigned long c = 0;
+		while ((MINIMUM << c) < size)
+			c++;
+		return c;
+	}
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+namespace cppnntp
+{
+	/**
+	 * Reusable buffers for decoded segments, so each segment does not
+	 * allocate (and fault in) a new one.
+	 *
+	 * @note Buffers come in size classes, powers of 2 from MINIMUM to
+	 * MAXIMUM, each class keeps a free list of blocks given back.
+	 * Blocks are mapped with mmap, with huge pages the blocks of 2MB
+	 * and more use MAP_HUGETLB when the system has some reserved and
+	 * transparent huge pages (MADV_HUGEPAGE) when not. Bigger buffers
+	 * are not kept.
+	 * Thread safe.
+	 */
+	class bufferpool
+	{
+	public:
+		/**
+		 * A block from the pool, given back when destroyed.
+		 *
+		 * @note Can be moved, not copied.
+		 */
+		class buffer
+		{
+		public:
+			/**
+			 * Constructor, no block.
+			 *
+			 * @public
+			 */
+			buffer();
+
+			/**
+			 * Move constructor.
+			 *
+			 * @public
+			 */
+			buffer(buffer &&other);
+
+			/**
+			 * Move assignment, the block this held is given back.
+			 *
+			 * @public
+			 */
+			buffer &operator=(buffer &&other);
+
+			/**
+			 * Destructor, gives the block back.
+			 *
+			 * @public
+			 */
+			~buffer();
+
+			/**
+			 * The block, NULL when there is none.
+			 *
+			 * @public
+			 */
+			char *data() const;
+
+			/**
+			 * Size of the block.
+			 *
+			 * @public
+			 */
+			unsigned long capacity() const;
+
+			/**
+			 * Bytes used in the block.
+			 *
+			 * @public
+			 */
+			unsigned long length() const;
+
+			/**
+			 * Set the bytes used, at most the capacity.
+			 *
+			 * @public
+			 *
+			 * @param length = Bytes used.
+			 */
+			void setlength(const unsigned long &length);
+
+			/**
+			 * Give the block back.
+			 *
+			 * @public
+			 */
+			void release();
+
+		private:
+			friend class bufferpool;
+
+			buffer(const buffer &);
+			buffer &operator=(const buffer &);
+
+			/**
+			 * The pool, NULL when the block is not kept.
+			 *
+			 * @private
+			 */
+			bufferpool *pool;
+
+			/**
+			 * The block, its size and the bytes used.
+			 *
+			 * @private
+			 */
+			char *block;
+			unsigned long size;
+			unsigned long used;
+		};
+
+		/**
+		 * Smallest and biggest size class.
+		 *
+		 * @public
+		 */
+		static const unsigned long MINIMUM = 65536;
+		static const unsigned long MAXIMUM = 67108864;
+
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param hugepages = Back the blocks of 2MB and more with
+		 * huge pages?
+		 * @param      kept = Most free blocks kept per size class.
+		 */
+		bufferpool(const bool &hugepages = false, const unsigned long &kept = 64);
+
+		/**
+		 * Destructor, unmaps the free blocks.
+		 *
+		 * @note Buffers still out must be destroyed before the pool.
+		 * @public
+		 */
+		~bufferpool();
+
+		/**
+		 * Get a buffer.
+		 *
+		 * @public
+		 *
+		 * @param bytes = Least capacity.
+		 * @return The buffer, without a block if mmap failed.
+		 */
+		buffer get(const unsigned long &bytes);
+
+		/**
+		 * Amount of buffers given from the free lists, and mapped.
+		 *
+		 * @public
+		 */
+		unsigned long reused() const;
+		unsigned long mapped() const;
+
+	private:
+		/**
+		 * Back the big blocks with huge pages?
+		 *
+		 * @private
+		 */
+		bool hugepages;
+
+		/**
+		 * Most free blocks kept per size class.
+		 *
+		 * @private
+		 */
+		unsigned long kept;
+
+		/**
+		 * Free blocks of each size class.
+		 *
+		 * @private
+		 */
+		std::vector<std::vector<char *> > lists;
+
+		/**
+		 * Counters.
+		 *
+		 * @private
+		 */
+		unsigned long hits = 0;
+		unsigned long misses = 0;
+
+		/**
+		 * Protects the above.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+
+		/**
+		 * Take a block back.
+		 *
+		 * @private
+		 *
+		 * @param block = The block.
+		 * @param  size = Its size.
+		 */
+		void put(char *block, const unsigned long &size);
+
+		/**
+		 * Map a block.
+		 *
+		 * @private
+		 *
+		 * @param size = Its size.
+		 * @return The block, NULL on failure.
+		 */
+		char *map(const unsigned long &size) const;
+
+		/**
+		 * Size class of a size.
+		 *
+		 * @private
+		 */
+		static unsigned long sizeclass(const unsigned long &size);
+	};
+}
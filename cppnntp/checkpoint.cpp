@@ -0,0 +1,278 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <zlib.h>
+#include "checkpoint.hpp"
+#include "msgidindex.hpp"
+namespace cppnntp {
+	/**
+	 * First line of a journal.
+	 */
+	static const std::string MAGIC = "cppnntp-checkpoint 1\n";
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param batch = Records kept before they are written and synced.
+	 */
+	checkpoint::checkpoint(const unsigned long &batch) : batch(batch ? batch : 1) {}
+
+	/**
+	 * Destructor, writes the pending records.
+	 *
+	 * @public
+	 */
+	checkpoint::~checkpoint() {
+		flush();
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	/**
+	 * Read a journal and append to it from now on, it is created
+	 * if it does not exist.
+	 *
+	 * @public
+	 *
+	 * @param path = Path/file of the journal.
+	 * @return bool = Did it work?
+	 */
+	bool checkpoint::open(const std::string &path) {
+		std::lock_guard<std::mutex> files(filelock);
+		std::vector<entry> read;
+		unsigned long valid = 0;
+		{
+			std::ifstream file(path.c_str(), std::ios::binary);
+			std::string magic(MAGIC.length(), '\0');
+			if (file.is_open() && file.read(&magic[0], magic.length())) {
+				if (magic != MAGIC)
+					return false;
+				valid = MAGIC.length();
+
+				// Up to the first torn or damaged record.
+				entry e;
+				while (file.read(reinterpret_cast<char *>(&e), sizeof(entry)) && e.checksum == checksum(e)) {
+					read.push_back(e);
+					valid += sizeof(entry);
+				}
+			}
+		}
+
+		const int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+		if (descriptor < 0)
+			return false;
+		// The records are appended after the last good one.
+		bool ok = ::ftruncate(descriptor, valid) == 0 && ::lseek(descriptor, valid, SEEK_SET) >= 0;
+		if (ok && valid == 0)
+			ok = ::write(descriptor, MAGIC.data(), MAGIC.length()) == static_cast<ssize_t>(MAGIC.length())
+				&& ::fdatasync(descriptor) == 0;
+		if (!ok) {
+			::close(descriptor);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (fd >= 0)
+			::close(fd);
+		fd = descriptor;
+		this->path = path;
+		entries.swap(read);
+		pending.clear();
+		return true;
+	}
+
+	/**
+	 * A segment was written.
+	 *
+	 * @public
+	 *
+	 * @param     job = Id of the job (see jobid).
+	 * @param    file = Position of the file in the job.
+	 * @param segment = Position of the segment in the job.
+	 * @param  offset = Where the segment is in the file.
+	 * @param  length = Length of the decoded segment.
+	 * @param     crc = CRC32 of the decoded segment.
+	 */
+	void checkpoint::record(const uint64_t &job, const unsigned int &file, const unsigned long &segment,
+			const unsigned long &offset, const unsigned long &length, const uint32_t &crc) {
+		entry e;
+		e.job = job;
+		e.offset = offset;
+		e.file = file;
+		e.segment = segment;
+		e.length = length;
+		e.crc = crc;
+		e.padding = 0;
+		e.checksum = checksum(e);
+
+		std::vector<entry> full;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			entries.push_back(e);
+			if (fd < 0)
+				return;
+			pending.push_back(e);
+			if (pending.size() < batch)
+				return;
+			full.swap(pending);
+		}
+		append(full);
+	}
+
+	/**
+	 * Write and sync the pending records.
+	 *
+	 * @public
+	 *
+	 * @return bool = Did it work?
+	 */
+	bool checkpoint::flush() {
+		std::vector<entry> records;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			records.swap(pending);
+		}
+		return records.empty() || append(records);
+	}
+
+	/**
+	 * Segments of a job that were written.
+	 *
+	 * @public
+	 *
+	 * @param     job = Id of the job.
+	 * @param segments = Amount of segments of the job.
+	 * @return For each segment, was it written?
+	 */
+	std::vector<bool> checkpoint::written(const uint64_t &job, const unsigned long &segments) const {
+		std::vector<bool> done(segments, false);
+		std::lock_guard<std::mutex> guard(lock);
+		for (unsigned long i = 0; i < entries.size(); i++) {
+			if (entries[i].job == job && entries[i].segment < segments)
+				done[entries[i].segment] = true;
+		}
+		return done;
+	}
+
+	/**
+	 * Drop the records of a job, once it is done.
+	 *
+	 * @note The journal is written to a temporary file, then renamed.
+	 * @public
+	 *
+	 * @param  job = Id of the job.
+	 * @return bool = Did it work?
+	 */
+	bool checkpoint::forget(const uint64_t &job) {
+		std::lock_guard<std::mutex> files(filelock);
+		std::lock_guard<std::mutex> guard(lock);
+		std::vector<entry> kept;
+		for (unsigned long i = 0; i < entries.size(); i++) {
+			if (entries[i].job != job)
+				kept.push_back(entries[i]);
+		}
+		if (fd < 0) {
+			entries.swap(kept);
+			return true;
+		}
+
+		// The pending records are in entries, they are written too.
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return false;
+			file << MAGIC;
+			if (!kept.empty())
+				file.write(reinterpret_cast<const char *>(kept.data()), kept.size() * sizeof(entry));
+			file.flush();
+			if (!file.good())
+				return false;
+		}
+		const int descriptor = ::open(temporary.c_str(), O_WRONLY | O_APPEND);
+		if (descriptor < 0)
+			return false;
+		if (::fdatasync(descriptor) != 0 || std::rename(temporary.c_str(), path.c_str()) != 0) {
+			::close(descriptor);
+			return false;
+		}
+		::close(fd);
+		fd = descriptor;
+		entries.swap(kept);
+		pending.clear();
+		return true;
+	}
+
+	/**
+	 * Amount of records.
+	 *
+	 * @public
+	 */
+	unsigned long checkpoint::size() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return entries.size();
+	}
+
+	/**
+	 * Id of a job, from the message-ids of its segments.
+	 *
+	 * @public
+	 *
+	 * @param job = The job.
+	 * @return The id.
+	 */
+	uint64_t checkpoint::jobid(const nzbjob &job) {
+		uint64_t id = job.segments();
+		for (unsigned long i = 0; i < job.segments(); i++) {
+			const uint64_t hash = msgidindex::hash("<" + job.messageid(job.segment(i)).str() + ">");
+			id ^= hash + 0x9E3779B97F4A7C15ULL + (id << 6) + (id >> 2);
+		}
+		return id;
+	}
+
+	/**
+	 * Write records to the journal and sync it.
+	 *
+	 * @private
+	 *
+	 * @param records = The records.
+	 * @return   bool = Did it work?
+	 */
+	bool checkpoint::append(const std::vector<entry> &records) {
+		std::lock_guard<std::mutex> files(filelock);
+		if (fd < 0)
+			return false;
+
+		// A failed write is cut off, the records after it stay readable.
+		const off_t start = ::lseek(fd, 0, SEEK_END);
+		const char *data = reinterpret_cast<const char *>(records.data());
+		const unsigned long length = records.size() * sizeof(entry);
+		unsigned long done = 0;
+		while (done < length) {
+			const ssize_t count = ::write(fd, data + done, length - done);
+			if (count < 0) {
+				if (errno == EINTR)
+					continue;
+				if (start >= 0 && ::ftruncate(fd, start) == 0)
+					::lseek(fd, start, SEEK_SET);
+				return false;
+			}
+			done += count;
+		}
+		return ::fdatasync(fd) == 0;
+	}
+
+	/**
+	 * CRC32 of a record, without its checksum.
+	 *
+	 * @private
+	 */
+	uint32_t checkpoint::checksum(const entry &e) {
+		return crc32(0, reinterpret_cast<const Bytef *>(&e), offsetof(entry, checksum));
+	}
+}
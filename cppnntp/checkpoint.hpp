@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "nzbjob.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Append only journal of the segments written to the files, so a
+	 * job can resume after a restart without downloading them again.
+	 *
+	 * @note Records are fixed size and carry their own CRC32, a record
+	 * torn by a crash is cut off when the journal is opened. Records
+	 * are written and fdatasync'ed in batches, a crash loses at most the
+	 * last batch. A record is only added once the segment is in the file
+	 * (the page cache), data lost by a power failure is caught by the
+	 * PAR2 check (see par2verifier).
+	 * Thread safe.
+	 */
+	class checkpoint
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param batch = Records kept before they are written and synced.
+		 */
+		checkpoint(const unsigned long &batch = 64);
+
+		/**
+		 * Destructor, writes the pending records.
+		 *
+		 * @public
+		 */
+		~checkpoint();
+
+		/**
+		 * Read a journal and append to it from now on, it is created
+		 * if it does not exist.
+		 *
+		 * @public
+		 *
+		 * @param path = Path/file of the journal.
+		 * @return bool = Did it work?
+		 */
+		bool open(const std::string &path);
+
+		/**
+		 * A segment was written.
+		 *
+		 * @public
+		 *
+		 * @param     job = Id of the job (see jobid).
+		 * @param    file = Position of the file in the job.
+		 * @param segment = Position of the segment in the job.
+		 * @param  offset = Where the segment is in the file.
+		 * @param  length = Length of the decoded segment.
+		 * @param     crc = CRC32 of the decoded segment.
+		 */
+		void record(const uint64_t &job, const unsigned int &file, const unsigned long &segment,
+				const unsigned long &offset, const unsigned long &length, const uint32_t &crc);
+
+		/**
+		 * Write and sync the pending records.
+		 *
+		 * @public
+		 *
+		 * @return bool = Did it work?
+		 */
+		bool flush();
+
+		/**
+		 * Segments of a job that were written.
+		 *
+		 * @public
+		 *
+		 * @param     job = Id of the job.
+		 * @param segments = Amount of segments of the job.
+		 * @return For each segment, was it written?
+		 */
+		std::vector<bool> written(const uint64_t &job, const unsigned long &segments) const;
+
+		/**
+		 * Drop the records of a job, once it is done.
+		 *
+		 * @note The journal is written to a temporary file, then renamed.
+		 * @public
+		 *
+		 * @param  job = Id of the job.
+		 * @return bool = Did it work?
+		 */
+		bool forget(const uint64_t &job);
+
+		/**
+		 * Amount of records.
+		 *
+		 * @public
+		 */
+		unsigned long size() const;
+
+		/**
+		 * Id of a job, from the message-ids of its segments.
+		 *
+		 * @public
+		 *
+		 * @param job = The job.
+		 * @return The id.
+		 */
+		static uint64_t jobid(const nzbjob &job);
+
+	private:
+		/**
+		 * A record as written to the journal.
+		 *
+		 * @private
+		 */
+		struct entry
+		{
+			uint64_t job;
+			uint64_t offset;
+			uint32_t file;
+			uint32_t segment;
+			uint32_t length;
+			uint32_t crc;
+			uint32_t padding;
+
+			/**
+			 * CRC32 of the fields above.
+			 */
+			uint32_t checksum;
+		};
+
+		/**
+		 * Records kept before they are written.
+		 *
+		 * @private
+		 */
+		unsigned long batch;
+
+		/**
+		 * Path/file of the journal and its descriptor, -1 when closed.
+		 *
+		 * @private
+		 */
+		std::string path;
+		int fd = -1;
+
+		/**
+		 * Every record, and the records not written yet.
+		 *
+		 * @private
+		 */
+		std::vector<entry> entries;
+		std::vector<entry> pending;
+
+		/**
+		 * Protects the above, and the writes to the journal, so
+		 * records can be added while a batch is synced.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+		std::mutex filelock;
+
+		/**
+		 * Write records to the journal and sync it.
+		 *
+		 * @private
+		 *
+		 * @param records = The records.
+		 * @return   bool = Did it work?
+		 */
+		bool append(const std::vector<entry> &records);
+
+		/**
+		 * CRC32 of a record, without its checksum.
+		 *
+		 * @private
+		 */
+		static uint32_t checksum(const entry &e);
+	};
+}
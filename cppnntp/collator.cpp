@@ -0,0 +1,395 @@
+#include <algorithm>
+#include "collator.hpp"
+#include "msgidindex.hpp"
+namespace cppnntp {
+	/**
+	 * Most parts (or files) a marker can give, a bin keeps a bit per
+	 * part so a spam subject like (1/999999999) must not be believed.
+	 */
+	static const unsigned long MAXPARTS = 100000;
+
+	/**
+	 * Find the last "open n/m close" in a string.
+	 *
+	 * @param      str = The string.
+	 * @param   length = Length of the string.
+	 * @param     open = Opening char, ( or [
+	 * @param    close = Closing char, ) or ]
+	 * @param     part = Where n is stored.
+	 * @param    total = Where m is stored.
+	 * @param   offset = Where the position of the marker is stored.
+	 * @param mlength = Where the length of the marker is stored.
+	 * @return    bool = Was it found?
+	 */
+	static bool findmarker(const char *str, const unsigned long &length,
+			const char &open, const char &close, unsigned int &part,
+			unsigned int &total, unsigned long &offset, unsigned long &mlength) {
+		for (unsigned long i = length; i-- > 0;) {
+			if (str[i] != open)
+				continue;
+
+			unsigned long pos = i + 1;
+			unsigned long n = 0, m = 0, digits = 0;
+			while (pos < length && str[pos] >= '0' && str[pos] <= '9' && digits++ < 9)
+				n = n * 10 + (str[pos++] - '0');
+			if (digits == 0 || pos >= length || str[pos++] != '/')
+				continue;
+
+			digits = 0;
+			while (pos < length && str[pos] >= '0' && str[pos] <= '9' && digits++ < 9)
+				m = m * 10 + (str[pos++] - '0');
+			if (digits == 0 || pos >= length || str[pos++] != close)
+				continue;
+
+			// (0/5) is usually an nfo or a description, not a part.
+			if (n == 0 || m == 0 || n > m || m > MAXPARTS)
+				continue;
+
+			part = n;
+			total = m;
+			offset = i;
+			mlength = pos - i;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	collator::collator() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	collator::~collator() {}
+
+	/**
+	 * Find the part marker in a subject.
+	 *
+	 * @note Markers of more than 100000 parts are not believed.
+	 * @public
+	 * @example "file.rar" yEnc (3/50) gives 3, 50, and the
+	 * position and length of "(3/50)".
+	 *
+	 * @param subject = The subject.
+	 * @param    part = Where the part number is stored.
+	 * @param   total = Where the amount of parts is stored.
+	 * @param  offset = Where the position of the marker is stored.
+	 * @param  length = Where the length of the marker is stored
+	 * (0 when the 1/1 yEnc rule was used).
+	 * @return   bool = Was a marker found?
+	 */
+	bool collator::partmarker(const field &subject, unsigned int &part,
+			unsigned int &total, unsigned long &offset, unsigned long &length) {
+		if (findmarker(subject.data, subject.length, '(', ')', part, total, offset, length))
+			return true;
+
+		if (findmarker(subject.data, subject.length, '[', ']', part, total, offset, length))
+			return true;
+
+		// A single article yEnc post.
+		for (unsigned long i = 0; i + 4 <= subject.length; i++) {
+			if (subject.data[i] == 'y' && subject.data[i + 1] == 'E'
+					&& subject.data[i + 2] == 'n' && subject.data[i + 3] == 'c') {
+				part = total = 1;
+				offset = subject.length;
+				length = 0;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Parse a RFC5322 date (example: Mon, 1 Jan 2024 10:00:00 +0100).
+	 *
+	 * @public
+	 *
+	 * @param date = The date header.
+	 * @return Unix time, 0 if the date could not be parsed.
+	 */
+	unsigned long collator::parsedate(const field &date) {
+		const char *pos = date.data;
+		const char *end = pos + date.length;
+
+		// Read a number, at most digits long.
+		auto number = [&pos, end](long &value, const unsigned short &digits) {
+			unsigned short found = 0;
+			value = 0;
+			while (pos < end && found < digits && *pos >= '0' && *pos <= '9') {
+				value = value * 10 + (*pos++ - '0');
+				found++;
+			}
+			return found > 0;
+		};
+		auto spaces = [&pos, end]() {
+			while (pos < end && (*pos == ' ' || *pos == '\t'))
+				pos++;
+		};
+
+		spaces();
+		// Optional day of the week.
+		const char *comma = pos;
+		while (comma < end && ((*comma >= 'A' && *comma <= 'Z') || (*comma >= 'a' && *comma <= 'z')))
+			comma++;
+		if (comma < end && *comma == ',') {
+			pos = comma + 1;
+			spaces();
+		}
+
+		long day, year, hour, minute, second = 0;
+		if (!number(day, 2))
+			return 0;
+		spaces();
+
+		if (end - pos < 3)
+			return 0;
+		static const char months[] = "janfebmaraprmayjunjulaugsepoctnovdec";
+		long month = 0;
+		for (; month < 12; month++) {
+			bool same = true;
+			for (unsigned short i = 0; i < 3 && same; i++)
+				same = (pos[i] | 0x20) == months[month * 3 + i];
+			if (same)
+				break;
+		}
+		if (month == 12)
+			return 0;
+		pos += 3;
+		spaces();
+
+		const char *yearstart = pos;
+		if (!number(year, 4))
+			return 0;
+		// Obsolete 2 digit years.
+		if (pos - yearstart == 2)
+			year += year < 50 ? 2000 : 1900;
+		spaces();
+
+		if (!number(hour, 2) || pos >= end || *pos++ != ':' || !number(minute, 2))
+			return 0;
+		if (pos < end && *pos == ':') {
+			pos++;
+			if (!number(second, 2))
+				return 0;
+		}
+		spaces();
+
+		// Zone, +hhmm or -hhmm, names (GMT, UTC...) are taken as UTC.
+		long zone = 0;
+		if (pos < end && (*pos == '+' || *pos == '-')) {
+			const bool negative = *pos++ == '-';
+			long hhmm;
+			if (number(hhmm, 4))
+				zone = (hhmm / 100 * 60 + hhmm % 100) * 60 * (negative ? -1 : 1);
+		}
+
+		// Days since 1970-01-01 (Howard Hinnant's days_from_civil).
+		const long y = year - (month < 2);
+		const long era = (y >= 0 ? y : y - 399) / 400;
+		const long yoe = y - era * 400;
+		const long m = month + 1;
+		const long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+		const long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		const long days = era * 146097 + doe - 719468;
+
+		const long time = days * 86400 + hour * 3600 + minute * 60 + second - zone;
+		return time > 0 ? time : 0;
+	}
+
+	/**
+	 * Add an overview row.
+	 *
+	 * @public
+	 *
+	 * @param       row = The row.
+	 * @param groupname = The group the row came from.
+	 * @return     bool = Was it part of a binary?
+	 */
+	bool collator::add(const overviewrow &row, const std::string &groupname) {
+		setgroup(groupname);
+		return addrow(row);
+	}
+
+	/**
+	 * Add every row of a list.
+	 *
+	 * @public
+	 *
+	 * @param      rows = The rows.
+	 * @param groupname = The group the rows came from.
+	 * @return The amount of rows that were part of a binary.
+	 */
+	unsigned long collator::add(const overview &rows, const std::string &groupname) {
+		setgroup(groupname);
+		unsigned long added = 0;
+		for (unsigned long i = 0; i < rows.size(); i++) {
+			if (addrow(rows.row(i)))
+				added++;
+		}
+		return added;
+	}
+
+	/**
+	 * Add the rows of an overview database.
+	 *
+	 * @public
+	 *
+	 * @param    db = The database.
+	 * @param first = Position of the first row to add (use
+	 * db.begin() for every row).
+	 * @return The amount of rows that were part of a binary.
+	 */
+	unsigned long collator::add(overviewdb &db, const unsigned long &first) {
+		setgroup(db.group());
+		unsigned long added = 0;
+		for (unsigned long i = std::max(first, db.begin()); i < db.size(); i++) {
+			if (addrow(db.row(i)))
+				added++;
+		}
+		return added;
+	}
+
+	/**
+	 * Get the name of a group id.
+	 *
+	 * @public
+	 *
+	 * @param id = A group id from binary::groups.
+	 * @return The name.
+	 */
+	const std::string &collator::groupname(const unsigned short &id) const {
+		return groups.at(id);
+	}
+
+	/**
+	 * Remove every binary.
+	 *
+	 * @public
+	 */
+	void collator::clear() {
+		binaries.clear();
+		keys.clear();
+		messageids.clear();
+	}
+
+	/**
+	 * Set the group of the rows being added.
+	 *
+	 * @private
+	 *
+	 * @param groupname = The name of the group.
+	 */
+	void collator::setgroup(const std::string &groupname) {
+		if (currentgroup < groups.size() && groups[currentgroup] == groupname)
+			return;
+
+		for (unsigned short i = 0; i < groups.size(); i++) {
+			if (groups[i] == groupname) {
+				currentgroup = i;
+				return;
+			}
+		}
+		groups.push_back(groupname);
+		currentgroup = groups.size() - 1;
+	}
+
+	/**
+	 * Add a row, the group must already be set.
+	 *
+	 * @private
+	 *
+	 * @param row = The row.
+	 * @return bool = Was it part of a binary?
+	 */
+	bool collator::addrow(const overviewrow &row) {
+		unsigned int part, total;
+		unsigned long offset, length;
+		if (!partmarker(row.subject, part, total, offset, length))
+			return false;
+
+		// The key is the subject without the marker, the poster and the
+		// amount of parts, separated by NULs.
+		unsigned long prefix = offset;
+		while (prefix > 0 && row.subject.data[prefix - 1] == ' ')
+			prefix--;
+		unsigned long suffix = offset + length;
+		while (suffix < row.subject.length && row.subject.data[suffix] == ' ')
+			suffix++;
+
+		key.assign(row.subject.data, prefix);
+		if (suffix < row.subject.length) {
+			key += ' ';
+			key.append(row.subject.data + suffix, row.subject.length - suffix);
+		}
+		const unsigned long namelength = key.length();
+		key += '\0';
+		key.append(row.from.data, row.from.length);
+		key += '\0';
+		key.append(reinterpret_cast<const char *>(&total), sizeof(total));
+
+		field keyfield = { key.data(), key.length() };
+		uint64_t hash = msgidindex::hash(keyfield);
+
+		binary *bin = NULL;
+		std::unordered_map<uint64_t, unsigned int>::const_iterator it;
+		while ((it = keys.find(hash)) != keys.end()) {
+			binary &candidate = binaries[it->second];
+			if (candidate.total == total && candidate.name.length() == namelength
+					&& key.compare(0, namelength, candidate.name) == 0
+					&& candidate.poster.compare(0, std::string::npos,
+						row.from.data, row.from.length) == 0) {
+				bin = &candidate;
+				break;
+			}
+			// Hash collision, try the next hash.
+			hash++;
+		}
+
+		if (bin == NULL) {
+			keys[hash] = binaries.size();
+			binaries.push_back(binary());
+			bin = &binaries.back();
+			bin->name.assign(key, 0, namelength);
+			bin->poster.assign(row.from.data, row.from.length);
+			bin->date = parsedate(row.date);
+			bin->total = total;
+			bin->received = 0;
+			bin->bytes = 0;
+			bin->bitmap.assign((total + 63) / 64, 0);
+
+			// A [n/m] before a (n/m) is the file's place in the release.
+			unsigned long fileoffset, filelength;
+			if (!findmarker(row.subject.data, prefix, '[', ']', bin->file, bin->files,
+					fileoffset, filelength))
+				bin->file = bin->files = 0;
+		}
+
+		bool known = false;
+		for (unsigned long i = 0; i < bin->groups.size() && !known; i++)
+			known = bin->groups[i] == currentgroup;
+		if (!known)
+			bin->groups.push_back(currentgroup);
+
+		// Reposted or crossposted part, keep the first one.
+		if (bin->has(part))
+			return true;
+
+		bin->bitmap[(part - 1) / 64] |= uint64_t(1) << ((part - 1) % 64);
+		bin->received++;
+		bin->bytes += row.bytes;
+
+		binarypart p;
+		p.number = part;
+		p.bytes = row.bytes;
+		p.messageid = messageids.append(row.messageid.data, row.messageid.length);
+		p.messageidlength = row.messageid.length;
+		bin->parts.push_back(p);
+		return true;
+	}
+}
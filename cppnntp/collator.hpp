@@ -0,0 +1,313 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.hpp"
+#include "overview.hpp"
+#include "overviewdb.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * 1 part (article) of a binary.
+	 */
+	struct binarypart
+	{
+		/**
+		 * Part number, from 1 to binary::total.
+		 */
+		unsigned int number;
+
+		/**
+		 * Size of the article in bytes.
+		 */
+		unsigned long bytes;
+
+		/**
+		 * Message-id offset and length in the collator's arena.
+		 */
+		unsigned long messageid;
+		unsigned int messageidlength;
+	};
+
+	/**
+	 * A file posted as 1 or more articles.
+	 */
+	struct binary
+	{
+		/**
+		 * The subject without the part marker.
+		 */
+		std::string name;
+
+		/**
+		 * The poster (from header).
+		 */
+		std::string poster;
+
+		/**
+		 * Unix time of the first article seen, 0 if the date
+		 * could not be parsed.
+		 */
+		unsigned long date;
+
+		/**
+		 * Position of the file in the release and files in the
+		 * release ([01/12] in the subject), 0 if unknown.
+		 */
+		unsigned int file;
+		unsigned int files;
+
+		/**
+		 * Amount of parts the binary has, and amount received.
+		 */
+		unsigned int total;
+		unsigned int received;
+
+		/**
+		 * Sum of the article sizes of the received parts.
+		 */
+		unsigned long bytes;
+
+		/**
+		 * Bit n - 1 is set when part n was received.
+		 */
+		std::vector<uint64_t> bitmap;
+
+		/**
+		 * The received parts, in the order they were seen.
+		 */
+		std::vector<binarypart> parts;
+
+		/**
+		 * Ids of the groups the parts were seen in, see
+		 * collator::groupname.
+		 */
+		std::vector<unsigned short> groups;
+
+		/**
+		 * Was a part received?
+		 *
+		 * @public
+		 *
+		 * @param part = The part number.
+		 * @return bool = Was it?
+		 */
+		bool has(const unsigned int &part) const {
+			return part >= 1 && part <= total
+				&& (bitmap[(part - 1) / 64] >> ((part - 1) % 64)) & 1;
+		}
+
+		/**
+		 * Percentage of the parts that were received.
+		 *
+		 * @public
+		 */
+		double completion() const {
+			return total ? received * 100.0 / total : 0;
+		}
+	};
+
+	/**
+	 * Groups overview rows into binaries (multi part files).
+	 *
+	 * @note The part marker is taken from the subject without regex,
+	 * in this order: the last (n/m), the last [n/m], or 1/1 for a
+	 * single article that mentions yEnc. Rows are keyed by the
+	 * subject without the part marker plus the poster.
+	 * Not thread safe.
+	 */
+	class collator
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		collator();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~collator();
+
+		/**
+		 * Find the part marker in a subject.
+		 *
+		 * @note Markers of more than 100000 parts are not believed.
+		 * @public
+		 * @example "file.rar" yEnc (3/50) gives 3, 50, and the
+		 * position and length of "(3/50)".
+		 *
+		 * @param subject = The subject.
+		 * @param    part = Where the part number is stored.
+		 * @param   total = Where the amount of parts is stored.
+		 * @param  offset = Where the position of the marker is stored.
+		 * @param  length = Where the length of the marker is stored
+		 * (0 when the 1/1 yEnc rule was used).
+		 * @return   bool = Was a marker found?
+		 */
+		static bool partmarker(const field &subject, unsigned int &part,
+				unsigned int &total, unsigned long &offset, unsigned long &length);
+
+		/**
+		 * Parse a RFC5322 date (example: Mon, 1 Jan 2024 10:00:00 +0100).
+		 *
+		 * @public
+		 *
+		 * @param date = The date header.
+		 * @return Unix time, 0 if the date could not be parsed.
+		 */
+		static unsigned long parsedate(const field &date);
+
+		/**
+		 * Add an overview row.
+		 *
+		 * @public
+		 *
+		 * @param       row = The row.
+		 * @param groupname = The group the row came from.
+		 * @return     bool = Was it part of a binary?
+		 */
+		bool add(const overviewrow &row, const std::string &groupname);
+
+		/**
+		 * Add every row of a list.
+		 *
+		 * @public
+		 *
+		 * @param      rows = The rows.
+		 * @param groupname = The group the rows came from.
+		 * @return The amount of rows that were part of a binary.
+		 */
+		unsigned long add(const overview &rows, const std::string &groupname);
+
+		/**
+		 * Add the rows of an overview database.
+		 *
+		 * @public
+		 *
+		 * @param    db = The database.
+		 * @param first = Position of the first row to add (use
+		 * db.begin() for every row).
+		 * @return The amount of rows that were part of a binary.
+		 */
+		unsigned long add(overviewdb &db, const unsigned long &first);
+
+		/**
+		 * Amount of binaries.
+		 *
+		 * @public
+		 */
+		unsigned long size() const {
+			return binaries.size();
+		}
+
+		/**
+		 * Get a binary.
+		 *
+		 * @public
+		 *
+		 * @param index = Position, from 0 to size() - 1.
+		 * @return The binary.
+		 */
+		const binary &at(const unsigned long &index) const {
+			return binaries[index];
+		}
+
+		/**
+		 * Get the message-id of a part.
+		 *
+		 * @public
+		 *
+		 * @param part = The part.
+		 * @return The message-id, valid until the collator changes.
+		 */
+		field messageid(const binarypart &part) const {
+			return messageids.view(part.messageid, part.messageidlength);
+		}
+
+		/**
+		 * Get the name of a group id.
+		 *
+		 * @public
+		 *
+		 * @param id = A group id from binary::groups.
+		 * @return The name.
+		 */
+		const std::string &groupname(const unsigned short &id) const;
+
+		/**
+		 * Remove every binary.
+		 *
+		 * @public
+		 */
+		void clear();
+
+	private:
+		/**
+		 * Every binary in the order they were first seen.
+		 *
+		 * @private
+		 */
+		std::vector<binary> binaries;
+
+		/**
+		 * Position of each binary by the hash of its key.
+		 *
+		 * @private
+		 */
+		std::unordered_map<uint64_t, unsigned int> keys;
+
+		/**
+		 * Storage for the message-ids of the parts.
+		 *
+		 * @private
+		 */
+		arena messageids;
+
+		/**
+		 * Group names by id.
+		 *
+		 * @private
+		 */
+		std::vector<std::string> groups;
+
+		/**
+		 * Group the rows being added come from.
+		 *
+		 * @private
+		 */
+		unsigned short currentgroup = 0;
+
+		/**
+		 * Reused buffer for building keys.
+		 *
+		 * @private
+		 */
+		std::string key;
+
+		/**
+		 * Set the group of the rows being added.
+		 *
+		 * @private
+		 *
+		 * @param groupname = The name of the group.
+		 */
+		void setgroup(const std::string &groupname);
+
+		/**
+		 * Add a row, the group must already be set.
+		 *
+		 * @private
+		 *
+		 * @param row = The row.
+		 * @return bool = Was it part of a binary?
+		 */
+		bool addrow(const overviewrow &row);
+	};
+}
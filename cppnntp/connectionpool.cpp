@@ -0,0 +1,144 @@
+#include "connectionpool.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param server = The server settings.
+	 */
+	connectionpool::connectionpool(const serverinfo &server) : info(server) {
+		if (info.connections == 0)
+			info.connections = 1;
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @note Disconnects every connection.
+	 * @public
+	 */
+	connectionpool::~connectionpool() {}
+
+	/**
+	 * Take a connection from the pool, wait if they are all in use.
+	 *
+	 * @public
+	 *
+	 * @return The connection, NULL if we could not connect or login.
+	 */
+	nntp *connectionpool::acquire() {
+		nntp *connection = NULL;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (idle.empty() && connections.size() >= info.connections)
+				available.wait(guard);
+
+			if (!idle.empty()) {
+				connection = idle.back();
+				idle.pop_back();
+			}
+			else {
+				connections.push_back(std::unique_ptr<nntp>(new nntp(false)));
+				connection = connections.back().get();
+			}
+			connection->setlimiters(global, &limit);
+		}
+
+		// Connecting is slow, do it outside the lock.
+		if (!open(connection)) {
+			release(connection, true);
+			return NULL;
+		}
+		return connection;
+	}
+
+	/**
+	 * Give a connection back to the pool.
+	 *
+	 * @public
+	 *
+	 * @param connection = The connection from acquire.
+	 * @param     broken = Did the connection fail? If so it is
+	 * disconnected and opened again by the next acquire.
+	 */
+	void connectionpool::release(nntp *connection, const bool &broken) {
+		if (broken) {
+			try {
+				connection->disconnect();
+			} catch (const std::exception &) {
+				// The socket is closed either way.
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		idle.push_back(connection);
+		available.notify_one();
+	}
+
+	/**
+	 * Maximum amount of connections in the pool.
+	 *
+	 * @public
+	 */
+	unsigned short connectionpool::size() const {
+		return info.connections;
+	}
+
+	/**
+	 * The server settings.
+	 *
+	 * @public
+	 */
+	const serverinfo &connectionpool::server() const {
+		return info;
+	}
+
+	/**
+	 * Bandwidth limit of this server, change it with setrate
+	 * at any time.
+	 *
+	 * @public
+	 */
+	ratelimiter &connectionpool::limiter() {
+		return limit;
+	}
+
+	/**
+	 * Set a bandwidth limit shared with other servers, applied
+	 * on top of the limit of this server.
+	 *
+	 * @note Takes effect on the next acquire of each connection.
+	 * @public
+	 *
+	 * @param global = The limit, NULL for none.
+	 */
+	void connectionpool::setlimiter(ratelimiter *global) {
+		std::lock_guard<std::mutex> guard(lock);
+		this->global = global;
+	}
+
+	/**
+	 * Connect and login a connection.
+	 *
+	 * @private
+	 *
+	 * @param connection = The connection.
+	 * @return      bool = Did it work?
+	 */
+	bool connectionpool::open(nntp *connection) {
+		if (connection->is_connected())
+			return true;
+
+		try {
+			if (!connection->connect(info.hostname, info.port, info.ssl))
+				return false;
+
+			if (info.username != "" && !connection->login(info.username, info.password))
+				return false;
+		} catch (const std::exception &) {
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "nntp.hpp"
+#include "ratelimiter.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Settings for 1 NNTP server.
+	 */
+	struct serverinfo
+	{
+		std::string hostname;
+		std::string port;
+		bool ssl;
+		std::string username;
+		std::string password;
+
+		/**
+		 * Maximum amount of connections the provider allows.
+		 */
+		unsigned short connections;
+	};
+
+	/**
+	 * A fixed size pool of logged in connections to 1 server.
+	 *
+	 * @note Connections are opened the first time they are needed,
+	 * cli output is turned off on every connection.
+	 */
+	class connectionpool
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param server = The server settings.
+		 */
+		connectionpool(const serverinfo &server);
+
+		/**
+		 * Destructor.
+		 *
+		 * @note Disconnects every connection.
+		 * @public
+		 */
+		~connectionpool();
+
+		/**
+		 * Take a connection from the pool, wait if they are all in use.
+		 *
+		 * @public
+		 *
+		 * @return The connection, NULL if we could not connect or login.
+		 */
+		nntp *acquire();
+
+		/**
+		 * Give a connection back to the pool.
+		 *
+		 * @public
+		 *
+		 * @param connection = The connection from acquire.
+		 * @param     broken = Did the connection fail? If so it is
+		 * disconnected and opened again by the next acquire.
+		 */
+		void release(nntp *connection, const bool &broken = false);
+
+		/**
+		 * Maximum amount of connections in the pool.
+		 *
+		 * @public
+		 */
+		unsigned short size() const;
+
+		/**
+		 * The server settings.
+		 *
+		 * @public
+		 */
+		const serverinfo &server() const;
+
+		/**
+		 * Bandwidth limit of this server, change it with setrate
+		 * at any time.
+		 *
+		 * @public
+		 */
+		ratelimiter &limiter();
+
+		/**
+		 * Set a bandwidth limit shared with other servers, applied
+		 * on top of the limit of this server.
+		 *
+		 * @note Takes effect on the next acquire of each connection.
+		 * @public
+		 *
+		 * @param global = The limit, NULL for none.
+		 */
+		void setlimiter(ratelimiter *global);
+
+	private:
+		/**
+		 * The server settings.
+		 *
+		 * @private
+		 */
+		serverinfo info;
+
+		/**
+		 * Every connection ever created by the pool.
+		 *
+		 * @private
+		 */
+		std::vector<std::unique_ptr<nntp> > connections;
+
+		/**
+		 * Connections not handed out.
+		 *
+		 * @private
+		 */
+		std::vector<nntp *> idle;
+
+		/**
+		 * Protects connections and idle.
+		 *
+		 * @private
+		 */
+		std::mutex lock;
+
+		/**
+		 * Bandwidth limits of this server and shared with other
+		 * servers.
+		 *
+		 * @private
+		 */
+		ratelimiter limit;
+		ratelimiter *global = NULL;
+
+		/**
+		 * Signalled when a connection is released.
+		 *
+		 * @private
+		 */
+		std::condition_variable available;
+
+		/**
+		 * Connect and login a connection.
+		 *
+		 * @private
+		 *
+		 * @param connection = The connection.
+		 * @return      bool = Did it work?
+		 */
+		bool open(nntp *connection);
+	};
+}
@@ -0,0 +1,217 @@
+#include <utility>
+#include "diskwriter.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param assembler = Writes the segments to the files.
+	 * @param      done = Called after each write with the tag
+	 * given to push and whether the write worked.
+	 * @param   threads = Amount of writer threads.
+	 * @param  maxbytes = Most bytes queued before push waits.
+	 */
+	diskwriter::diskwriter(fileassembler &assembler,
+			const std::function<void(const unsigned long &, const bool &)> &done,
+			const unsigned short &threads, const unsigned long &maxbytes)
+		: assembler(assembler), done(done), maxbytes(maxbytes) {
+		const unsigned short count = threads ? threads : 1;
+		for (unsigned short i = 0; i < count; i++)
+			this->threads.push_back(std::thread(&diskwriter::writer, this));
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @note Writes what is queued, then stops the threads.
+	 * @public
+	 */
+	diskwriter::~diskwriter() {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+			notempty.notify_all();
+		}
+		for (unsigned long i = 0; i < threads.size(); i++)
+			threads[i].join();
+	}
+
+	/**
+	 * Queue a segment, wait if the queue is full.
+	 *
+	 * @public
+	 *
+	 * @param      tag = Passed to the done function.
+	 * @param     file = Position of the file in the job.
+	 * @param     name = Name of the file.
+	 * @param     size = Size of the whole file if known (0 if not).
+	 * @param   offset = Where the segment goes in the file.
+	 * @param     data = The decoded segment, it is taken (left empty).
+	 * @param reserved = (Optional) Memory reserved for the segment
+	 * (see memorybudget), it is taken and given back once written.
+	 */
+	void diskwriter::push(const unsigned long &tag, const unsigned int &file, const std::string &name,
+			const unsigned long &size, const unsigned long &offset, std::string &data,
+			memorybudget::reservation *reserved) {
+		item i;
+		i.tag = tag;
+		i.file = file;
+		i.name = name;
+		i.size = size;
+		i.offset = offset;
+		i.data.swap(data);
+		i.length = i.data.length();
+		if (reserved != NULL)
+			i.reserved = std::move(*reserved);
+		enqueue(i);
+	}
+
+	/**
+	 * Queue a segment held in a pooled buffer, wait if the queue
+	 * is full. The buffer goes back to its pool once written.
+	 *
+	 * @public
+	 *
+	 * @param      tag = Passed to the done function.
+	 * @param     file = Position of the file in the job.
+	 * @param     name = Name of the file.
+	 * @param     size = Size of the whole file if known (0 if not).
+	 * @param   offset = Where the segment goes in the file.
+	 * @param     data = The decoded segment, it is taken.
+	 * @param reserved = (Optional) Memory reserved for the segment
+	 * (see memorybudget), it is taken and given back once written.
+	 */
+	void diskwriter::push(const unsigned long &tag, const unsigned int &file, const std::string &name,
+			const unsigned long &size, const unsigned long &offset, bufferpool::buffer &data,
+			memorybudget::reservation *reserved) {
+		item i;
+		i.tag = tag;
+		i.file = file;
+		i.name = name;
+		i.size = size;
+		i.offset = offset;
+		i.block = std::move(data);
+		i.length = i.block.length();
+		if (reserved != NULL)
+			i.reserved = std::move(*reserved);
+		enqueue(i);
+	}
+
+	/**
+	 * Wait until every queued segment was written.
+	 *
+	 * @public
+	 */
+	void diskwriter::wait() {
+		std::unique_lock<std::mutex> guard(lock);
+		notfull.wait(guard, [this]() {
+			return items.empty() && busy == 0;
+		});
+	}
+
+	/**
+	 * Bytes queued and not written yet.
+	 *
+	 * @public
+	 */
+	unsigned long diskwriter::queued() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return bytes;
+	}
+
+	/**
+	 * Amount of times push had to wait for room.
+	 *
+	 * @public
+	 */
+	unsigned long diskwriter::stalls() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return waits;
+	}
+
+	/**
+	 * Add a segment to the queue, wait if it is full.
+	 *
+	 * @private
+	 *
+	 * @param i = The segment, it is taken.
+	 */
+	void diskwriter::enqueue(item &i) {
+		std::unique_lock<std::mutex> guard(lock);
+		// A segment larger than the whole queue still goes in alone.
+		if (bytes > 0 && bytes + i.length > maxbytes) {
+			waits++;
+			notfull.wait(guard, [this, &i]() {
+				return bytes == 0 || bytes + i.length <= maxbytes;
+			});
+		}
+
+		bytes += i.length;
+		items.push_back(std::move(i));
+		notempty.notify_one();
+	}
+
+	/**
+	 * Write queued segments until stopped.
+	 *
+	 * @private
+	 */
+	void diskwriter::writer() {
+		// With io_uring a batch is 1 submission, pwrite writes 1 at a
+		// time so the threads share the queue.
+		const unsigned long most = assembler.uring() ? 32 : 1;
+		std::vector<item> current;
+		std::vector<fileassembler::segment> batch;
+		while (true) {
+			current.clear();
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				notempty.wait(guard, [this]() {
+					return stopping || !items.empty();
+				});
+				if (items.empty())
+					return;
+				while (!items.empty() && current.size() < most) {
+					current.push_back(std::move(items.front()));
+					items.pop_front();
+				}
+				busy += current.size();
+			}
+
+			batch.resize(current.size());
+			unsigned long length = 0;
+			for (unsigned long i = 0; i < current.size(); i++) {
+				fileassembler::segment &s = batch[i];
+				s.file = current[i].file;
+				s.name = &current[i].name;
+				s.size = current[i].size;
+				s.offset = current[i].offset;
+				s.data = current[i].block.data() != NULL ? current[i].block.data() : current[i].data.data();
+				s.length = current[i].length;
+				length += s.length;
+			}
+			assembler.write(batch);
+			for (unsigned long i = 0; i < current.size(); i++) {
+				current[i].block.release();
+				current[i].reserved.release();
+			}
+
+			// Room is made before done runs, it may push more.
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				bytes -= length;
+				notfull.notify_all();
+			}
+			if (done) {
+				for (unsigned long i = 0; i < current.size(); i++)
+					done(current[i].tag, batch[i].ok);
+			}
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				busy -= current.size();
+				notfull.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,207 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bufferpool.hpp"
+#include "fileassembler.hpp"
+#include "memorybudget.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Writes decoded segments on its own threads, so the network
+	 * threads never wait for the disk.
+	 *
+	 * @note Segments are queued with push, which takes their buffer
+	 * without copying. The queue is bounded in bytes: push waits while
+	 * it is full (backpressure), so a slow disk slows the downloads
+	 * instead of filling the memory. The result of each write is
+	 * passed to the done function, on a writer thread.
+	 * When the assembler writes with io_uring, each thread takes up
+	 * to 32 segments at once and writes them as 1 batch.
+	 */
+	class diskwriter
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param assembler = Writes the segments to the files.
+		 * @param      done = Called after each write with the tag
+		 * given to push and whether the write worked.
+		 * @param   threads = Amount of writer threads.
+		 * @param  maxbytes = Most bytes queued before push waits.
+		 */
+		diskwriter(fileassembler &assembler,
+				const std::function<void(const unsigned long &, const bool &)> &done,
+				const unsigned short &threads = 2, const unsigned long &maxbytes = 67108864);
+
+		/**
+		 * Destructor.
+		 *
+		 * @note Writes what is queued, then stops the threads.
+		 * @public
+		 */
+		~diskwriter();
+
+		/**
+		 * Queue a segment, wait if the queue is full.
+		 *
+		 * @public
+		 *
+		 * @param      tag = Passed to the done function.
+		 * @param     file = Position of the file in the job.
+		 * @param     name = Name of the file.
+		 * @param     size = Size of the whole file if known (0 if not).
+		 * @param   offset = Where the segment goes in the file.
+		 * @param     data = The decoded segment, it is taken (left empty).
+		 * @param reserved = (Optional) Memory reserved for the segment
+		 * (see memorybudget), it is taken and given back once written.
+		 */
+		void push(const unsigned long &tag, const unsigned int &file, const std::string &name,
+				const unsigned long &size, const unsigned long &offset, std::string &data,
+				memorybudget::reservation *reserved = NULL);
+
+		/**
+		 * Queue a segment held in a pooled buffer, wait if the queue
+		 * is full. The buffer goes back to its pool once written.
+		 *
+		 * @public
+		 *
+		 * @param      tag = Passed to the done function.
+		 * @param     file = Position of the file in the job.
+		 * @param     name = Name of the file.
+		 * @param     size = Size of the whole file if known (0 if not).
+		 * @param   offset = Where the segment goes in the file.
+		 * @param     data = The decoded segment, it is taken.
+		 * @param reserved = (Optional) Memory reserved for the segment
+		 * (see memorybudget), it is taken and given back once written.
+		 */
+		void push(const unsigned long &tag, const unsigned int &file, const std::string &name,
+				const unsigned long &size, const unsigned long &offset, bufferpool::buffer &data,
+				memorybudget::reservation *reserved = NULL);
+
+		/**
+		 * Wait until every queued segment was written.
+		 *
+		 * @public
+		 */
+		void wait();
+
+		/**
+		 * Bytes queued and not written yet.
+		 *
+		 * @public
+		 */
+		unsigned long queued() const;
+
+		/**
+		 * Amount of times push had to wait for room.
+		 *
+		 * @public
+		 */
+		unsigned long stalls() const;
+
+	private:
+		/**
+		 * A queued segment.
+		 *
+		 * @private
+		 */
+		struct item
+		{
+			unsigned long tag;
+			unsigned int file;
+			std::string name;
+			unsigned long size;
+			unsigned long offset;
+			std::string data;
+			bufferpool::buffer block;
+			unsigned long length;
+			memorybudget::reservation reserved;
+		};
+
+		/**
+		 * Writes the segments.
+		 *
+		 * @private
+		 */
+		fileassembler &assembler;
+
+		/**
+		 * Called after each write.
+		 *
+		 * @private
+		 */
+		std::function<void(const unsigned long &, const bool &)> done;
+
+		/**
+		 * Most bytes queued.
+		 *
+		 * @private
+		 */
+		unsigned long maxbytes;
+
+		/**
+		 * The queue, bytes in it, items being written.
+		 *
+		 * @private
+		 */
+		std::deque<item> items;
+		unsigned long bytes = 0;
+		unsigned long busy = 0;
+
+		/**
+		 * Times push waited.
+		 *
+		 * @private
+		 */
+		unsigned long waits = 0;
+
+		/**
+		 * Set to stop the threads.
+		 *
+		 * @private
+		 */
+		bool stopping = false;
+
+		/**
+		 * Protects the queue, notempty wakes the writers, notfull wakes
+		 * push and wait.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+		std::condition_variable notempty;
+		std::condition_variable notfull;
+
+		/**
+		 * The writer threads.
+		 *
+		 * @private
+		 */
+		std::vector<std::thread> threads;
+
+		/**
+		 * Add a segment to the queue, wait if it is full.
+		 *
+		 * @private
+		 *
+		 * @param i = The segment, it is taken.
+		 */
+		void enqueue(item &i);
+
+		/**
+		 * Write queued segments until stopped.
+		 *
+		 * @private
+		 */
+		void writer();
+	};
+}
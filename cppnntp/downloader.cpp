@@ -0,0 +1,653 @@
+#include <deque>
+#include <thread>
+#include <zlib.h>
+#include "downloader.hpp"
+#include "msgidindex.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param      pool = The connections to use.
+	 * @param directory = Where the files are written.
+	 * @param     depth = Most BODY commands in flight per connection,
+	 * each connection adapts it to its latency and throughput.
+	 * @param   retries = How many times a segment is tried on a
+	 * new connection before it is given up on.
+	 */
+	downloader::downloader(connectionpool &pool, const std::string &directory,
+			const unsigned short &depth, const unsigned short &retries)
+		: downloader(std::vector<connectionpool *>(1, &pool), directory, depth, retries) {
+	}
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param     pools = The connections of each server, in order
+	 * of preference.
+	 * @param directory = Where the files are written.
+	 * @param     depth = Most BODY commands in flight per connection,
+	 * each connection adapts it to its latency and throughput.
+	 * @param   retries = How many times a segment is tried on a
+	 * new connection before it is given up on.
+	 */
+	downloader::downloader(const std::vector<connectionpool *> &pools, const std::string &directory,
+			const unsigned short &depth, const unsigned short &retries)
+		: pools(pools), assembler(directory),
+		  writer(assembler, [this](const unsigned long &segment, const bool &ok) { finish(segment, ok); }),
+		  depth(depth ? depth : 1),
+		  retries(retries ? retries : 1), bytes(0), downloaded(0), missing(0), corrupt(0) {
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	downloader::~downloader() {}
+
+	/**
+	 * Set a function called when every segment of a file was
+	 * handled (downloaded or failed).
+	 *
+	 * @note Called from the download and writer threads.
+	 * @public
+	 *
+	 * @param callback = The function, it gets the file position.
+	 */
+	void downloader::onfile(const std::function<void(const unsigned int &)> &callback) {
+		this->callback = callback;
+	}
+
+	/**
+	 * Set a cache of BODY responses, consulted before a segment
+	 * is asked for and filled with every segment downloaded.
+	 *
+	 * @public
+	 *
+	 * @param cache = The cache, NULL for none.
+	 */
+	void downloader::setcache(articlecache *cache) {
+		this->cache = cache;
+	}
+
+	/**
+	 * Set a cache of the servers missing each article, servers in
+	 * it are not asked for those articles, 430 responses are
+	 * added to it.
+	 *
+	 * @public
+	 *
+	 * @param cache = The cache, NULL for none.
+	 */
+	void downloader::setnegativecache(negativecache *cache) {
+		negative = cache;
+	}
+
+	/**
+	 * Change how the output files are written, see fileassembler.
+	 *
+	 * @public
+	 *
+	 * @param mode = The mode.
+	 */
+	void downloader::setoutputmode(const fileassembler::outputmode &mode) {
+		this->mode = mode;
+		assembler.setmode(mode);
+	}
+
+	/**
+	 * Set a PAR2 verifier, fed every segment written. The PAR2
+	 * index files of the job are added to it once downloaded.
+	 *
+	 * @public
+	 *
+	 * @param verifier = The verifier, NULL for none.
+	 */
+	void downloader::setverifier(par2verifier *verifier) {
+		this->verifier = verifier;
+	}
+
+	/**
+	 * Set a checkpoint journal: the segments of a job it has are
+	 * not downloaded again, the segments written are added to it.
+	 *
+	 * @note In DIRECT mode the segments of a file are added once
+	 * the file is closed, the blocks they share are written last.
+	 * @public
+	 *
+	 * @param journal = The journal, NULL for none.
+	 */
+	void downloader::setcheckpoint(checkpoint *journal) {
+		this->journal = journal;
+	}
+
+	/**
+	 * Set a memory budget shared by the stages of the download.
+	 *
+	 * @note The size of an article is reserved before its BODY
+	 * command is sent, the reservation follows the decoded segment
+	 * to the writer. A connection with nothing in flight waits for
+	 * room, the others stop sending commands.
+	 * @public
+	 *
+	 * @param budget = The budget, NULL for none.
+	 */
+	void downloader::setbudget(memorybudget *budget) {
+		this->budget = budget;
+	}
+
+	/**
+	 * Set a pool the segments are decoded into, the buffers go back
+	 * to it once written.
+	 *
+	 * @public
+	 *
+	 * @param buffers = The pool, NULL to decode into new strings.
+	 */
+	void downloader::setbufferpool(bufferpool *buffers) {
+		this->buffers = buffers;
+	}
+
+	/**
+	 * Download a job, returns when every segment was handled.
+	 *
+	 * @public
+	 *
+	 * @param job = The job.
+	 * @return bool = Was every segment downloaded?
+	 */
+	bool downloader::run(const nzbjob &job) {
+		std::vector<unsigned short> limits;
+		for (unsigned long i = 0; i < pools.size(); i++)
+			limits.push_back(pools[i]->size());
+
+		// Servers known to lack a segment are skipped from the start.
+		std::vector<uint64_t> known;
+		serverids.clear();
+		if (negative != NULL) {
+			for (unsigned long i = 0; i < pools.size(); i++)
+				serverids.push_back(negative->serverid(pools[i]->server().hostname));
+			known.assign(job.segments(), 0);
+			for (unsigned long s = 0; s < job.segments(); s++) {
+				const uint64_t hash = msgidindex::hash("<" + job.messageid(job.segment(s)).str() + ">");
+				for (unsigned long i = 0; i < pools.size(); i++) {
+					if (negative->missing(hash, serverids[i]))
+						known[s] |= static_cast<uint64_t>(1) << i;
+				}
+			}
+		}
+		// Segments the journal has are not downloaded again.
+		std::vector<bool> written;
+		pieces.clear();
+		if (journal != NULL) {
+			jobid = checkpoint::jobid(job);
+			written = journal->written(jobid, job.segments());
+			piece empty = {0, 0, 0, false};
+			pieces.assign(job.segments(), empty);
+		}
+		scheduler.reset(new segmentscheduler(job, limits, retries, known, written));
+		sets.clear();
+
+		this->job = &job;
+		bytes = downloaded = missing = corrupt = 0;
+		restored = 0;
+		filedone.reset(new std::atomic<unsigned int>[job.files()]);
+		for (unsigned long i = 0; i < job.files(); i++)
+			filedone[i] = 0;
+
+		if (job.segments() == 0)
+			return true;
+
+		const std::vector<unsigned long> &skipped = scheduler->skipped();
+		for (unsigned long i = 0; i < skipped.size(); i++)
+			finish(skipped[i], false);
+		for (unsigned long i = 0; i < written.size(); i++) {
+			if (written[i]) {
+				restored++;
+				finish(i, true);
+			}
+		}
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < scheduler->workers(); i++)
+			threads.push_back(std::thread(&downloader::worker, this, i));
+		for (unsigned long i = 0; i < threads.size(); i++)
+			threads[i].join();
+
+		writer.wait();
+		assembler.closeall();
+		if (journal != NULL)
+			journal->flush();
+		return scheduler->remaining() == 0 && missing == 0;
+	}
+
+	/**
+	 * Repair the files of the last job with the PAR2 sets it
+	 * downloaded, the damaged slices come from the verifier.
+	 *
+	 * @public
+	 *
+	 * @param threads = Amount of threads, 0 for 1 per CPU.
+	 * @return   bool = Is every file of every set whole?
+	 */
+	bool downloader::repair(const unsigned short &threads) {
+		if (verifier == NULL)
+			return false;
+
+		bool ok = true;
+		for (unsigned long i = 0; i < sets.size(); i++) {
+			std::map<std::string, std::vector<unsigned long> > damaged;
+			const std::vector<par2file> &files = sets[i].files();
+			for (unsigned long f = 0; f < files.size(); f++)
+				verifier->damaged(files[f].name, assembler.path(files[f].name), damaged[files[f].name]);
+
+			par2repair repairer(sets[i], [this](const std::string &name) { return assembler.path(name); }, threads);
+			if (!repairer.repair(damaged))
+				ok = false;
+		}
+		return ok;
+	}
+
+	/**
+	 * Amount of article bytes received.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::received() const {
+		return bytes;
+	}
+
+	/**
+	 * Amount of decoded bytes written to the files.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::written() const {
+		return assembler.written();
+	}
+
+	/**
+	 * Amount of segments downloaded.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::done() const {
+		return downloaded;
+	}
+
+	/**
+	 * Amount of segments that could not be downloaded.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::failed() const {
+		return missing;
+	}
+
+	/**
+	 * Amount of downloaded segments whose size or CRC32
+	 * did not match.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::damaged() const {
+		return corrupt;
+	}
+
+	/**
+	 * Amount of segments a connection took from another one.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::stolen() const {
+		return scheduler ? scheduler->stolen() : 0;
+	}
+
+	/**
+	 * Amount of segments the checkpoint journal had written
+	 * before, counted in done.
+	 *
+	 * @public
+	 */
+	unsigned long downloader::resumed() const {
+		return restored;
+	}
+
+	/**
+	 * Percentage of the segments of the job that were handled.
+	 *
+	 * @public
+	 */
+	double downloader::completion() const {
+		if (job == NULL || job->segments() == 0)
+			return 0;
+		return (downloaded + missing) * 100.0 / job->segments();
+	}
+
+	/**
+	 * Percentage of the segments of a file that were handled.
+	 *
+	 * @public
+	 *
+	 * @param file = Position of the file in the job.
+	 */
+	double downloader::completion(const unsigned int &file) const {
+		if (job == NULL || file >= job->files() || job->file(file).segments == 0)
+			return 0;
+		return filedone[file] * 100.0 / job->file(file).segments;
+	}
+
+	/**
+	 * Download segments until the job is done.
+	 *
+	 * @private
+	 *
+	 * @param id = The worker number in the scheduler.
+	 */
+	void downloader::worker(const unsigned int &id) {
+		connectionpool &pool = *pools[scheduler->server(id)];
+		nntp *connection = NULL;
+		pipelinedepth control(depth);
+		std::deque<unsigned long> inflight;
+		std::deque<memorybudget::reservation> reserved;
+		std::vector<std::string> messageids;
+		std::string raw, decoded;
+		// A segment taken when the budget was spent, sent first.
+		bool waiting = false;
+		unsigned long next = 0;
+
+		while (true) {
+			if (connection == NULL) {
+				connection = pool.acquire();
+				if (connection == NULL)
+					break;
+			}
+
+			try {
+				// Top up the pipeline once half of it came back, so
+				// commands go out in batches.
+				const unsigned short target = control.depth();
+				if (inflight.size() <= target / 2 && !control.draining()) {
+					messageids.clear();
+					unsigned long segment = next;
+					while (inflight.size() < target
+							&& (waiting || scheduler->take(id, segment, inflight.empty()))) {
+						// Only wait for room with nothing in flight, the
+						// responses in flight hold memory of their own.
+						memorybudget::reservation r;
+						waiting = !reserve(segment, inflight.empty(), r);
+						if (waiting) {
+							next = segment;
+							break;
+						}
+						const std::string messageid = "<" + job->messageid(job->segment(segment)).str() + ">";
+						if (cache != NULL && cache->get(messageid, raw)) {
+							store(segment, raw, decoded, r);
+							continue;
+						}
+						inflight.push_back(segment);
+						reserved.push_back(std::move(r));
+						messageids.push_back(messageid);
+					}
+					if (inflight.empty())
+						break;
+					if (!messageids.empty() && !connection->sendbodies(messageids))
+						throw NNTPSockException("Not connected.");
+					control.sent(messageids.size());
+				}
+
+				unsigned short code = 0;
+				const bool found = connection->readbody(raw, code);
+				control.received(connection->firstbyte(), raw.length());
+				const unsigned long segment = inflight.front();
+				if (found) {
+					inflight.pop_front();
+					memorybudget::reservation r(std::move(reserved.front()));
+					reserved.pop_front();
+					bytes += raw.length();
+					if (cache != NULL)
+						cache->put("<" + job->messageid(job->segment(segment)).str() + ">", raw);
+					store(segment, raw, decoded, r);
+				} else if (code == RESPONSECODE_NO_SUCH_ARTICLE_ID
+						|| code == RESPONSECODE_NO_SUCH_ARTICLE_NUMBER) {
+					// Another server might have it.
+					inflight.pop_front();
+					reserved.pop_front();
+					if (negative != NULL)
+						negative->add(msgidindex::hash("<" + job->messageid(job->segment(segment)).str() + ">"),
+								serverids[scheduler->server(id)]);
+					if (!scheduler->missing(id, segment))
+						finish(segment, false);
+				} else
+					throw NNTPSockException("Unexpected response " + std::to_string(code));
+			} catch (const std::exception &) {
+				// The responses in flight are lost with the connection.
+				pool.release(connection, true);
+				connection = NULL;
+				control.reset();
+				reserved.clear();
+				while (!inflight.empty()) {
+					if (!scheduler->giveback(id, inflight.front()))
+						finish(inflight.front(), false);
+					inflight.pop_front();
+				}
+			}
+		}
+
+		if (connection != NULL)
+			pool.release(connection);
+		if (waiting && !scheduler->giveback(id, next))
+			finish(next, false);
+
+		// The server is gone, hand our segments to the other servers.
+		std::vector<unsigned long> failed;
+		scheduler->retire(id, failed);
+		for (unsigned long i = 0; i < failed.size(); i++)
+			finish(failed[i], false);
+	}
+
+	/**
+	 * Decode a downloaded segment and queue it for writing, it
+	 * is marked as handled once written.
+	 *
+	 * @note Segments of mapped files are decoded straight into the
+	 * map instead (see fileassembler::region).
+	 * When it throws the segment was still marked as handled.
+	 * @private
+	 *
+	 * @param  segment = The segment.
+	 * @param      raw = The BODY response.
+	 * @param  decoded = Buffer for the decoded data without a pool, taken by
+	 * the writer.
+	 * @param reserved = Memory reserved for the segment, taken by
+	 * the writer.
+	 */
+	void downloader::store(const unsigned long &segment, const std::string &raw, std::string &decoded,
+			memorybudget::reservation &reserved) {
+		// Set once the segment was finished or given to the writer, it
+		// is not in flight anymore so a throw must not lose it.
+		bool handed = false;
+		try {
+			const nzbsegment &s = job->segment(segment);
+			const nzbfile &f = job->file(s.file);
+
+			yencinfo info;
+			const char *data = yencdecode::header(raw.data(), raw.length(), info);
+			// Without =ypart the offset is only known for single part files.
+			if (data == NULL || (info.begin == 0 && f.segments != 1)) {
+				handed = true;
+				finish(segment, false);
+				return;
+			}
+			const unsigned long offset = info.begin > 0 ? info.begin - 1 : 0;
+			const unsigned long left = raw.length() - (data - raw.data());
+
+			// A mapped file is decoded straight into its place, the writer
+			// is skipped.
+			const unsigned long length = info.begin > 0 ? info.end - info.begin + 1 : info.size;
+			char *target = info.end >= info.begin
+				? assembler.region(s.file, job->filename(f), info.size, offset, length) : NULL;
+			if (target != NULL) {
+				unsigned long written = 0;
+				const bool ok = yencdecode::body(data, left, target, length, written, info);
+				if (ok) {
+					assembler.filled(written);
+					if (!info.valid)
+						corrupt++;
+					if (verifier != NULL)
+						verifier->add(job->filename(f), offset, target, written);
+					remember(segment, offset, target, written, info);
+				}
+				handed = true;
+				finish(segment, ok);
+				return;
+			}
+
+			// A pooled buffer goes back to the pool once written, a
+			// string is freed.
+			bufferpool::buffer block;
+			if (buffers != NULL)
+				block = buffers->get(left);
+			char *out = block.data();
+			if (out == NULL) {
+				decoded.resize(left);
+				out = &decoded[0];
+			}
+			unsigned long written = 0;
+			if (!yencdecode::body(data, left, out, left, written, info)) {
+				handed = true;
+				finish(segment, false);
+				return;
+			}
+
+			if (!info.valid)
+				corrupt++;
+			if (verifier != NULL)
+				verifier->add(job->filename(f), offset, out, written);
+			remember(segment, offset, out, written, info);
+			// The writer holds the decoded buffer, not the article.
+			if (block.data() != NULL) {
+				block.setlength(written);
+				reserved.resize(block.capacity());
+				writer.push(segment, s.file, job->filename(f), info.size, offset, block, &reserved);
+				handed = true;
+			} else {
+				decoded.resize(written);
+				reserved.resize(decoded.capacity());
+				writer.push(segment, s.file, job->filename(f), info.size, offset, decoded, &reserved);
+				handed = true;
+			}
+		} catch (...) {
+			if (!handed)
+				finish(segment, false);
+			throw;
+		}
+	}
+
+	/**
+	 * Reserve memory for the article of a segment.
+	 *
+	 * @private
+	 *
+	 * @param  segment = The segment.
+	 * @param     wait = Wait for room?
+	 * @param reserved = Where the reservation is stored.
+	 * @return    bool = Was there room (always true without a budget)?
+	 */
+	bool downloader::reserve(const unsigned long &segment, const bool &wait, memorybudget::reservation &reserved) {
+		if (budget == NULL)
+			return true;
+		const unsigned long bytes = job->segment(segment).bytes;
+		if (!wait)
+			return budget->tryreserve(bytes, reserved);
+		reserved = budget->reserve(bytes);
+		return true;
+	}
+
+	/**
+	 * Mark a segment as handled.
+	 *
+	 * @private
+	 *
+	 * @param segment = The segment.
+	 * @param      ok = Was it downloaded?
+	 */
+	void downloader::finish(const unsigned long &segment, const bool &ok) {
+		if (ok)
+			downloaded++;
+		else
+			missing++;
+
+		// The scheduler is told even when the file callback throws,
+		// or the workers would wait for this segment forever.
+		try {
+			const unsigned int file = job->segment(segment).file;
+			if (ok && journal != NULL && mode != fileassembler::DIRECT && pieces[segment].stored) {
+				const piece &p = pieces[segment];
+				journal->record(jobid, file, segment, p.offset, p.length, p.crc);
+			}
+			if (++filedone[file] == job->file(file).segments) {
+				const bool closed = assembler.close(file);
+				if (closed && journal != NULL && mode == fileassembler::DIRECT) {
+					const nzbfile &f = job->file(file);
+					for (unsigned long i = f.firstsegment; i < f.firstsegment + f.segments; i++) {
+						if (pieces[i].stored)
+							journal->record(jobid, file, i, pieces[i].offset, pieces[i].length, pieces[i].crc);
+					}
+				}
+				// The slices of the files come from the PAR2 index, the
+				// volumes add recovery slices to the set of the same id.
+				const std::string name = job->filename(job->file(file));
+				if (verifier != NULL && segmentscheduler::priority(name) != 1) {
+					par2set set;
+					if (set.load(assembler.path(name)))
+						verifier->addset(set);
+					if (!set.id().empty()) {
+						std::lock_guard<std::mutex> guard(setslock);
+						unsigned long i = 0;
+						while (i < sets.size() && sets[i].id() != set.id())
+							i++;
+						if (i == sets.size())
+							sets.push_back(set);
+						else
+							sets[i].load(assembler.path(name));
+					}
+				}
+				if (callback)
+					callback(file);
+			}
+		} catch (...) {
+			scheduler->done();
+			throw;
+		}
+
+		scheduler->done();
+	}
+
+	/**
+	 * Keep where a decoded segment went, for the journal.
+	 *
+	 * @private
+	 *
+	 * @param segment = The segment.
+	 * @param  offset = Where it is in the file.
+	 * @param    data = The decoded data.
+	 * @param  length = Length of the data.
+	 * @param    info = The yEnc header and trailer of the segment.
+	 */
+	void downloader::remember(const unsigned long &segment, const unsigned long &offset,
+			const char *data, const unsigned long &length, const yencinfo &info) {
+		if (journal == NULL)
+			return;
+		// The decoder already checked the CRC32 of the trailer.
+		piece &p = pieces[segment];
+		p.offset = offset;
+		p.length = length;
+		p.crc = info.valid && info.hascrc ? info.crc : crc32(0, reinterpret_cast<const Bytef *>(data), length);
+		p.stored = true;
+	}
+}
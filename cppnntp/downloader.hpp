@@ -0,0 +1,471 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "articlecache.hpp"
+#include "bufferpool.hpp"
+#include "checkpoint.hpp"
+#include "connectionpool.hpp"
+#include "diskwriter.hpp"
+#include "fileassembler.hpp"
+#include "memorybudget.hpp"
+#include "negativecache.hpp"
+#include "nzbjob.hpp"
+#include "par2repair.hpp"
+#include "par2verifier.hpp"
+#include "pipelinedepth.hpp"
+#include "segmentscheduler.hpp"
+#include "yencdecode.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Downloads every segment of a NZB job over the connection pools
+	 * of 1 or more servers.
+	 *
+	 * @note There is 1 worker thread per connection. Each worker keeps
+	 * several BODY commands in flight on its connection (pipelining),
+	 * as many as its pipelinedepth finds cover the latency. It decodes
+	 * the yEnc data of each response and queues it on a diskwriter,
+	 * which writes it to its place in the output file, so segments
+	 * never wait for each other and downloads never wait for the disk.
+	 * The segments are handed out by a segmentscheduler, segments of a
+	 * broken connection are retried, missing articles (430) are tried
+	 * on the other servers before they are counted as failed.
+	 * The progress functions can be called from any thread while
+	 * run() works.
+	 */
+	class downloader
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param      pool = The connections to use.
+		 * @param directory = Where the files are written.
+		 * @param     depth = Most BODY commands in flight per connection,
+		 * each connection adapts it to its latency and throughput.
+		 * @param   retries = How many times a segment is tried on a
+		 * new connection before it is given up on.
+		 */
+		downloader(connectionpool &pool, const std::string &directory,
+				const unsigned short &depth = 16, const unsigned short &retries = 3);
+
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param     pools = The connections of each server, in order
+		 * of preference.
+		 * @param directory = Where the files are written.
+		 * @param     depth = Most BODY commands in flight per connection,
+		 * each connection adapts it to its latency and throughput.
+		 * @param   retries = How many times a segment is tried on a
+		 * new connection before it is given up on.
+		 */
+		downloader(const std::vector<connectionpool *> &pools, const std::string &directory,
+				const unsigned short &depth = 16, const unsigned short &retries = 3);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~downloader();
+
+		/**
+		 * Set a function called when every segment of a file was
+		 * handled (downloaded or failed).
+		 *
+		 * @note Called from the download and writer threads.
+		 * @public
+		 *
+		 * @param callback = The function, it gets the file position.
+		 */
+		void onfile(const std::function<void(const unsigned int &)> &callback);
+
+		/**
+		 * Set a cache of BODY responses, consulted before a segment
+		 * is asked for and filled with every segment downloaded.
+		 *
+		 * @public
+		 *
+		 * @param cache = The cache, NULL for none.
+		 */
+		void setcache(articlecache *cache);
+
+		/**
+		 * Set a cache of the servers missing each article, servers in
+		 * it are not asked for those articles, 430 responses are
+		 * added to it.
+		 *
+		 * @public
+		 *
+		 * @param cache = The cache, NULL for none.
+		 */
+		void setnegativecache(negativecache *cache);
+
+		/**
+		 * Change how the output files are written, see fileassembler.
+		 *
+		 * @public
+		 *
+		 * @param mode = The mode.
+		 */
+		void setoutputmode(const fileassembler::outputmode &mode);
+
+		/**
+		 * Set a PAR2 verifier, fed every segment written. The PAR2
+		 * index files of the job are added to it once downloaded.
+		 *
+		 * @public
+		 *
+		 * @param verifier = The verifier, NULL for none.
+		 */
+		void setverifier(par2verifier *verifier);
+
+		/**
+		 * Set a checkpoint journal: the segments of a job it has are
+		 * not downloaded again, the segments written are added to it.
+		 *
+		 * @note In DIRECT mode the segments of a file are added once
+		 * the file is closed, the blocks they share are written last.
+		 * @public
+		 *
+		 * @param journal = The journal, NULL for none.
+		 */
+		void setcheckpoint(checkpoint *journal);
+
+		/**
+		 * Set a memory budget shared by the stages of the download.
+		 *
+		 * @note The size of an article is reserved before its BODY
+		 * command is sent, the reservation follows the decoded segment
+		 * to the writer. A connection with nothing in flight waits for
+		 * room, the others stop sending commands.
+		 * @public
+		 *
+		 * @param budget = The budget, NULL for none.
+		 */
+		void setbudget(memorybudget *budget);
+
+		/**
+		 * Set a pool the segments are decoded into, the buffers go back
+		 * to it once written.
+		 *
+		 * @public
+		 *
+		 * @param buffers = The pool, NULL to decode into new strings.
+		 */
+		void setbufferpool(bufferpool *buffers);
+
+		/**
+		 * Download a job, returns when every segment was handled.
+		 *
+		 * @public
+		 *
+		 * @param job = The job.
+		 * @return bool = Was every segment downloaded?
+		 */
+		bool run(const nzbjob &job);
+
+		/**
+		 * Repair the files of the last job with the PAR2 sets it
+		 * downloaded, the damaged slices come from the verifier.
+		 *
+		 * @public
+		 *
+		 * @param threads = Amount of threads, 0 for 1 per CPU.
+		 * @return   bool = Is every file of every set whole?
+		 */
+		bool repair(const unsigned short &threads = 0);
+
+		/**
+		 * Amount of article bytes received.
+		 *
+		 * @public
+		 */
+		unsigned long received() const;
+
+		/**
+		 * Amount of decoded bytes written to the files.
+		 *
+		 * @public
+		 */
+		unsigned long written() const;
+
+		/**
+		 * Amount of segments downloaded.
+		 *
+		 * @public
+		 */
+		unsigned long done() const;
+
+		/**
+		 * Amount of segments that could not be downloaded.
+		 *
+		 * @public
+		 */
+		unsigned long failed() const;
+
+		/**
+		 * Amount of downloaded segments whose size or CRC32
+		 * did not match.
+		 *
+		 * @public
+		 */
+		unsigned long damaged() const;
+
+		/**
+		 * Amount of segments a connection took from another one.
+		 *
+		 * @public
+		 */
+		unsigned long stolen() const;
+
+		/**
+		 * Amount of segments the checkpoint journal had written
+		 * before, counted in done.
+		 *
+		 * @public
+		 */
+		unsigned long resumed() const;
+
+		/**
+		 * Percentage of the segments of the job that were handled.
+		 *
+		 * @public
+		 */
+		double completion() const;
+
+		/**
+		 * Percentage of the segments of a file that were handled.
+		 *
+		 * @public
+		 *
+		 * @param file = Position of the file in the job.
+		 */
+		double completion(const unsigned int &file) const;
+
+	private:
+		/**
+		 * The connections of each server.
+		 *
+		 * @private
+		 */
+		std::vector<connectionpool *> pools;
+
+		/**
+		 * Writes the decoded segments.
+		 *
+		 * @private
+		 */
+		fileassembler assembler;
+
+		/**
+		 * Queues the decoded segments for the assembler.
+		 *
+		 * @private
+		 */
+		diskwriter writer;
+
+		/**
+		 * Most BODY commands in flight per connection.
+		 *
+		 * @private
+		 */
+		unsigned short depth;
+
+		/**
+		 * Tries per segment.
+		 *
+		 * @private
+		 */
+		unsigned short retries;
+
+		/**
+		 * The job being downloaded.
+		 *
+		 * @private
+		 */
+		const nzbjob *job = NULL;
+
+		/**
+		 * Cache of BODY responses, NULL when not set.
+		 *
+		 * @private
+		 */
+		articlecache *cache = NULL;
+
+		/**
+		 * Servers missing each article, NULL when not set, and the id
+		 * of each pool in it.
+		 *
+		 * @private
+		 */
+		negativecache *negative = NULL;
+		std::vector<unsigned short> serverids;
+
+		/**
+		 * Checks the PAR2 slices, NULL when not set.
+		 *
+		 * @private
+		 */
+		par2verifier *verifier = NULL;
+
+		/**
+		 * Journal of the segments written, NULL when not set, and the
+		 * id of the job in it.
+		 *
+		 * @private
+		 */
+		checkpoint *journal = NULL;
+		uint64_t jobid = 0;
+
+		/**
+		 * Limits the bytes held by the download, NULL when not set.
+		 *
+		 * @private
+		 */
+		memorybudget *budget = NULL;
+
+		/**
+		 * Buffers the segments are decoded into, NULL when not set.
+		 *
+		 * @private
+		 */
+		bufferpool *buffers = NULL;
+
+		/**
+		 * Where a decoded segment went, kept for the journal.
+		 *
+		 * @private
+		 */
+		struct piece
+		{
+			unsigned long offset;
+			unsigned long length;
+			uint32_t crc;
+			bool stored;
+		};
+		std::vector<piece> pieces;
+
+		/**
+		 * How the files are written.
+		 *
+		 * @private
+		 */
+		fileassembler::outputmode mode = fileassembler::BUFFERED;
+
+		/**
+		 * The PAR2 sets of the job, with their recovery slices.
+		 *
+		 * @private
+		 */
+		std::vector<par2set> sets;
+		std::mutex setslock;
+
+		/**
+		 * Called when a file is handled.
+		 *
+		 * @private
+		 */
+		std::function<void(const unsigned int &)> callback;
+
+		/**
+		 * Hands out the segments of the job being downloaded.
+		 *
+		 * @private
+		 */
+		std::unique_ptr<segmentscheduler> scheduler;
+
+		/**
+		 * Progress counters.
+		 *
+		 * @private
+		 */
+		std::atomic<unsigned long> bytes;
+		std::atomic<unsigned long> downloaded;
+		std::atomic<unsigned long> missing;
+		std::atomic<unsigned long> corrupt;
+		unsigned long restored = 0;
+
+		/**
+		 * Handled segments of each file.
+		 *
+		 * @private
+		 */
+		std::unique_ptr<std::atomic<unsigned int>[]> filedone;
+
+		/**
+		 * Download segments until the job is done.
+		 *
+		 * @private
+		 *
+		 * @param id = The worker number in the scheduler.
+		 */
+		void worker(const unsigned int &id);
+
+		/**
+		 * Decode a downloaded segment and queue it for writing, it
+		 * is marked as handled once written.
+		 *
+		 * @note Segments of mapped files are decoded straight into the
+		 * map instead (see fileassembler::region).
+		 * When it throws the segment was still marked as handled.
+		 * @private
+		 *
+		 * @param  segment = The segment.
+		 * @param      raw = The BODY response.
+		 * @param  decoded = Buffer for the decoded data without a pool, taken by
+		 * the writer.
+		 * @param reserved = Memory reserved for the segment, taken by
+		 * the writer.
+		 */
+		void store(const unsigned long &segment, const std::string &raw, std::string &decoded,
+				memorybudget::reservation &reserved);
+
+		/**
+		 * Reserve memory for the article of a segment.
+		 *
+		 * @private
+		 *
+		 * @param  segment = The segment.
+		 * @param     wait = Wait for room?
+		 * @param reserved = Where the reservation is stored.
+		 * @return    bool = Was there room (always true without a budget)?
+		 */
+		bool reserve(const unsigned long &segment, const bool &wait, memorybudget::reservation &reserved);
+
+		/**
+		 * Mark a segment as handled.
+		 *
+		 * @private
+		 *
+		 * @param segment = The segment.
+		 * @param      ok = Was it downloaded?
+		 */
+		void finish(const unsigned long &segment, const bool &ok);
+
+		/**
+		 * Keep where a decoded segment went, for the journal.
+		 *
+		 * @private
+		 *
+		 * @param segment = The segment.
+		 * @param  offset = Where it is in the file.
+		 * @param    data = The decoded data.
+		 * @param  length = Length of the data.
+		 * @param    info = The yEnc header and trailer of the segment.
+		 */
+		void remember(const unsigned long &segment, const unsigned long &offset,
+				const char *data, const unsigned long &length, const yencinfo &info);
+	};
+}
@@ -0,0 +1,518 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fileassembler.hpp"
+namespace cppnntp {
+	const unsigned long fileassembler::BLOCK;
+	const unsigned long fileassembler::MAPLIMIT;
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param directory = Where the files are written.
+	 */
+	fileassembler::fileassembler(const std::string &directory)
+		: directory(directory), bytes(0), sync(false) {
+		::mkdir(directory.c_str(), 0755);
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @note Closes every file.
+	 * @public
+	 */
+	fileassembler::~fileassembler() {
+		closeall();
+		for (unsigned long i = 0; i < stagings.size(); i++)
+			std::free(stagings[i].data);
+	}
+
+	/**
+	 * Write a segment.
+	 *
+	 * @public
+	 *
+	 * @param   file = Position of the file in the job.
+	 * @param   name = Name of the file, used on the first write.
+	 * @param   size = Size of the whole file if known (0 if not),
+	 * used on the first write.
+	 * @param offset = Where the segment goes in the file.
+	 * @param   data = The decoded segment.
+	 * @param length = Length of the segment.
+	 * @return  bool = Was it written?
+	 */
+	bool fileassembler::write(const unsigned int &file, const std::string &name,
+			const unsigned long &size, const unsigned long &offset,
+			const char *data, const unsigned long &length) {
+		bool direct;
+		const int fd = descriptor(file, name, size, direct);
+		if (fd < 0 || !(direct ? writedirect(file, fd, offset, data, length) : writeat(fd, data, length, offset)))
+			return false;
+		bytes += length;
+		return true;
+	}
+
+	/**
+	 * Write a batch of segments, with 1 submission when io_uring
+	 * is available.
+	 *
+	 * @public
+	 *
+	 * @param batch = The segments, ok is set on each.
+	 */
+	void fileassembler::write(std::vector<segment> &batch) {
+		std::vector<storagering::request> requests;
+		std::vector<unsigned long> positions;
+		for (unsigned long i = 0; i < batch.size(); i++) {
+			segment &s = batch[i];
+			s.ok = false;
+			bool direct;
+			const int fd = descriptor(s.file, *s.name, s.size, direct);
+			if (fd < 0)
+				continue;
+			// The ring writes unaligned buffers, O_DIRECT files go around it.
+			if (direct) {
+				s.ok = writedirect(s.file, fd, s.offset, s.data, s.length);
+				if (s.ok)
+					bytes += s.length;
+				continue;
+			}
+			if (!ring.available()) {
+				s.ok = writeat(fd, s.data, s.length, s.offset);
+				if (s.ok)
+					bytes += s.length;
+				continue;
+			}
+			storagering::request r = {fd, s.data, s.length, s.offset, false};
+			requests.push_back(r);
+			positions.push_back(i);
+		}
+		if (requests.empty())
+			return;
+
+		ring.write(requests);
+		for (unsigned long i = 0; i < requests.size(); i++) {
+			segment &s = batch[positions[i]];
+			// The ring can break during the batch, what it did not write
+			// is written here.
+			s.ok = requests[i].ok || (!ring.available() && writeat(requests[i].fd, s.data, s.length, s.offset));
+			if (s.ok)
+				bytes += s.length;
+		}
+	}
+
+	/**
+	 * Close a file once every segment was written.
+	 *
+	 * @note The data is flushed to the disk first if setsync was on.
+	 * @public
+	 *
+	 * @param file = Position of the file in the job.
+	 * @return bool = Did it close without errors?
+	 */
+	bool fileassembler::close(const unsigned int &file) {
+		int fd;
+		bool released;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (file >= outputs.size() || outputs[file].fd < 0)
+				return true;
+
+			fd = outputs[file].fd;
+			released = release(outputs[file]);
+		}
+		// Other files can be opened while this one is flushed.
+		return ring.close(fd, sync) && released;
+	}
+
+	/**
+	 * Close every file.
+	 *
+	 * @public
+	 */
+	void fileassembler::closeall() {
+		std::lock_guard<std::mutex> guard(lock);
+		for (unsigned long i = 0; i < outputs.size(); i++) {
+			if (outputs[i].fd >= 0) {
+				const int fd = outputs[i].fd;
+				release(outputs[i]);
+				::close(fd);
+			}
+		}
+		outputs.clear();
+	}
+
+	/**
+	 * Path/file a file name is written to, path separators and
+	 * control chars in the name are replaced.
+	 *
+	 * @public
+	 *
+	 * @param name = The file name.
+	 * @return The path.
+	 */
+	std::string fileassembler::path(const std::string &name) const {
+		std::string safe = name;
+		for (unsigned long i = 0; i < safe.length(); i++) {
+			if (safe[i] == '/' || safe[i] == '\\' || static_cast<unsigned char>(safe[i]) < 0x20)
+				safe[i] = '_';
+		}
+		if (safe.empty() || safe == "." || safe == "..")
+			safe = "_" + safe;
+		return directory + "/" + safe;
+	}
+
+	/**
+	 * Amount of bytes written.
+	 *
+	 * @public
+	 */
+	unsigned long fileassembler::written() const {
+		return bytes;
+	}
+
+	/**
+	 * Where a segment goes in the memory map of its file, for
+	 * the decoder to write to.
+	 *
+	 * @note Call filled once written.
+	 * @public
+	 *
+	 * @param   file = Position of the file in the job.
+	 * @param   name = Name of the file, used on the first write.
+	 * @param   size = Size of the whole file if known (0 if not),
+	 * used on the first write.
+	 * @param offset = Where the segment goes in the file.
+	 * @param length = Most bytes of the segment.
+	 * @return The address, NULL when the file is not mapped (write
+	 * the segment with write then).
+	 */
+	char *fileassembler::region(const unsigned int &file, const std::string &name,
+			const unsigned long &size, const unsigned long &offset,
+			const unsigned long &length) {
+		bool direct;
+		if (descriptor(file, name, size, direct) < 0)
+			return NULL;
+
+		std::lock_guard<std::mutex> guard(lock);
+		const output &out = outputs[file];
+		if (out.map == NULL || offset > out.mapsize || length > out.mapsize - offset)
+			return NULL;
+		return out.map + offset;
+	}
+
+	/**
+	 * Count bytes written to a region.
+	 *
+	 * @public
+	 *
+	 * @param length = Amount of bytes.
+	 */
+	void fileassembler::filled(const unsigned long &length) {
+		bytes += length;
+	}
+
+	/**
+	 * Flush each file to the disk when it is closed.
+	 *
+	 * @public
+	 *
+	 * @param sync = Flush?
+	 */
+	void fileassembler::setsync(const bool &sync) {
+		this->sync = sync;
+	}
+
+	/**
+	 * Are batches written with io_uring?
+	 *
+	 * @public
+	 */
+	bool fileassembler::uring() const {
+		return ring.available();
+	}
+
+	/**
+	 * Change how the files opened from now on are written.
+	 *
+	 * @note DIRECT falls back to BUFFERED for files whose file
+	 * system refuses O_DIRECT.
+	 * @public
+	 *
+	 * @param mode = The mode.
+	 */
+	void fileassembler::setmode(const outputmode &mode) {
+		std::lock_guard<std::mutex> guard(lock);
+		this->mode = mode;
+	}
+
+	/**
+	 * Get the descriptor of a file, opening it if needed.
+	 *
+	 * @private
+	 *
+	 * @param   file = Position of the file in the job.
+	 * @param   name = Name of the file.
+	 * @param   size = Size of the whole file, 0 if unknown.
+	 * @param direct = Set to whether the file uses O_DIRECT.
+	 * @return The descriptor, -1 on failure.
+	 */
+	int fileassembler::descriptor(const unsigned int &file, const std::string &name,
+			const unsigned long &size, bool &direct) {
+		std::lock_guard<std::mutex> guard(lock);
+		if (file >= outputs.size()) {
+			output closed;
+			closed.fd = -1;
+			closed.direct = false;
+			closed.existing = false;
+			closed.size = closed.end = 0;
+			closed.map = NULL;
+			closed.mapsize = 0;
+			outputs.resize(file + 1, closed);
+		}
+		output &out = outputs[file];
+		if (out.fd >= 0) {
+			direct = out.direct;
+			return out.fd;
+		}
+
+		const std::string target = path(name);
+		const bool mapped = mode == MAPPED && size > 0 && size <= MAPLIMIT;
+		struct stat before;
+		const bool existing = ::stat(target.c_str(), &before) == 0 && before.st_size > 0;
+		int fd = -1;
+		// Read too, the shared blocks of an existing file are read back.
+		if (mode == DIRECT)
+			fd = ::open(target.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+		direct = fd >= 0;
+		if (fd < 0)
+			fd = ::open(target.c_str(), (mapped ? O_RDWR : O_WRONLY) | O_CREAT, 0644);
+		if (fd < 0)
+			return -1;
+
+		// The blocks of a mapped file must be allocated, a write to a
+		// hole on a full disk would kill the process with SIGBUS.
+		out.map = NULL;
+		out.mapsize = 0;
+		if (mapped && ::fallocate(fd, 0, 0, size) == 0) {
+			void *map = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (map != MAP_FAILED) {
+				// Segments mostly arrive in order and are not read back.
+				::madvise(map, size, MADV_SEQUENTIAL);
+				out.map = static_cast<char *>(map);
+				out.mapsize = size;
+			}
+		}
+
+		// Set the final size up front, the gaps are filled as segments come in.
+		// With O_DIRECT every block is allocated too, so the file stays in
+		// 1 piece whatever order the segments arrive in.
+		struct stat info;
+		if (size > 0 && ::fstat(fd, &info) == 0 && static_cast<unsigned long>(info.st_size) < size
+				&& !(direct && ::fallocate(fd, 0, 0, size) == 0) && ::ftruncate(fd, size) != 0) {
+			::close(fd);
+			return -1;
+		}
+
+		out.fd = fd;
+		out.direct = direct;
+		out.existing = existing;
+		out.size = size;
+		out.end = 0;
+		return fd;
+	}
+
+	/**
+	 * Write a segment to a file opened with O_DIRECT.
+	 *
+	 * @private
+	 *
+	 * @param   file = Position of the file in the job.
+	 * @param     fd = Its descriptor.
+	 * @param offset = Where the segment goes in the file.
+	 * @param   data = The decoded segment.
+	 * @param length = Length of the segment.
+	 * @return  bool = Was it written?
+	 */
+	bool fileassembler::writedirect(const unsigned int &file, const int &fd, const unsigned long &offset,
+			const char *data, const unsigned long &length) {
+		const unsigned long end = offset + length;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			outputs[file].end = std::max(outputs[file].end, end);
+		}
+
+		unsigned long position = offset;
+		while (position < end) {
+			const unsigned long within = position % BLOCK;
+			if (within == 0 && end - position >= BLOCK) {
+				// The whole blocks, copied to an aligned buffer.
+				const unsigned long run = (end - position) / BLOCK * BLOCK;
+				const staging buffer = takestaging(run);
+				if (buffer.data == NULL)
+					return false;
+				std::memcpy(buffer.data, data + (position - offset), run);
+				const bool ok = writeat(fd, buffer.data, run, position);
+				givestaging(buffer);
+				if (!ok)
+					return false;
+				position += run;
+				continue;
+			}
+
+			// Part of a block shared with another segment.
+			const unsigned long count = std::min(BLOCK - within, end - position);
+			const unsigned long index = position / BLOCK;
+			char *full = NULL;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				output &out = outputs[file];
+				block &b = out.blocks[index];
+				if (b.data == NULL) {
+					void *memory = NULL;
+					if (::posix_memalign(&memory, BLOCK, BLOCK) != 0) {
+						out.blocks.erase(index);
+						return false;
+					}
+					b.data = static_cast<char *>(memory);
+					std::memset(b.data, 0, BLOCK);
+					// The rest of the block may hold segments restored
+					// from a previous run, don't write zeros over them.
+					if (out.existing && ::pread(fd, b.data, BLOCK, index * BLOCK) < 0) {
+						std::free(b.data);
+						out.blocks.erase(index);
+						return false;
+					}
+				}
+				std::memcpy(b.data + within, data + (position - offset), count);
+				b.filled += count;
+
+				// The last block of a file is shorter.
+				unsigned long wanted = BLOCK;
+				if (out.size > index * BLOCK && out.size - index * BLOCK < BLOCK)
+					wanted = out.size - index * BLOCK;
+				if (b.filled >= wanted) {
+					full = b.data;
+					out.blocks.erase(index);
+				}
+			}
+			if (full != NULL) {
+				const bool ok = writeat(fd, full, BLOCK, index * BLOCK);
+				std::free(full);
+				if (!ok)
+					return false;
+			}
+			position += count;
+		}
+		return true;
+	}
+
+	/**
+	 * Take a staging buffer, grown to a size if needed.
+	 *
+	 * @private
+	 *
+	 * @param length = Least size.
+	 * @return The buffer, data is NULL if it could not be allocated.
+	 */
+	fileassembler::staging fileassembler::takestaging(const unsigned long &length) {
+		staging buffer = {NULL, 0};
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (!stagings.empty()) {
+				buffer = stagings.back();
+				stagings.pop_back();
+			}
+		}
+		if (buffer.size < length) {
+			std::free(buffer.data);
+			void *memory = NULL;
+			if (::posix_memalign(&memory, BLOCK, length) != 0)
+				memory = NULL;
+			buffer.data = static_cast<char *>(memory);
+			buffer.size = memory != NULL ? length : 0;
+		}
+		return buffer;
+	}
+
+	/**
+	 * Give a staging buffer back for reuse.
+	 *
+	 * @private
+	 *
+	 * @param buffer = The buffer from takestaging.
+	 */
+	void fileassembler::givestaging(const staging &buffer) {
+		std::lock_guard<std::mutex> guard(lock);
+		stagings.push_back(buffer);
+	}
+
+	/**
+	 * Write the blocks still being filled, sync and remove the map
+	 * and set the final size of a file, then forget it.
+	 *
+	 * @note lock must be held.
+	 * @private
+	 *
+	 * @param out = The file.
+	 * @return bool = Did it work?
+	 */
+	bool fileassembler::release(output &out) {
+		bool ok = true;
+		// Blocks next to missing segments, the missing part stays zeros.
+		for (std::map<unsigned long, block>::iterator it = out.blocks.begin(); it != out.blocks.end(); ++it) {
+			if (ok)
+				ok = writeat(out.fd, it->second.data, BLOCK, it->first * BLOCK);
+			std::free(it->second.data);
+		}
+		out.blocks.clear();
+
+		if (out.map != NULL) {
+			if (::msync(out.map, out.mapsize, sync ? MS_SYNC : MS_ASYNC) != 0)
+				ok = false;
+			::munmap(out.map, out.mapsize);
+			out.map = NULL;
+			out.mapsize = 0;
+		}
+
+		// Whole blocks can go past the end of the file.
+		if (out.direct && ::ftruncate(out.fd, out.size > 0 ? out.size : out.end) != 0)
+			ok = false;
+		out.fd = -1;
+		return ok;
+	}
+
+	/**
+	 * Write all of a buffer with pwrite.
+	 *
+	 * @private
+	 *
+	 * @param     fd = The file descriptor.
+	 * @param   data = The buffer.
+	 * @param length = Length of the buffer.
+	 * @param offset = Where it goes in the file.
+	 * @return  bool = Was it written?
+	 */
+	bool fileassembler::writeat(const int &fd, const char *data, const unsigned long &length,
+			const unsigned long &offset) {
+		unsigned long done = 0;
+		while (done < length) {
+			const ssize_t count = ::pwrite(fd, data + done, length - done, offset + done);
+			if (count < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			done += count;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,405 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "storagering.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Writes decoded segments straight to their place in the
+	 * output files.
+	 *
+	 * @note Segments can arrive in any order and from any thread,
+	 * each is written with pwrite at its offset, so no file is ever
+	 * held in memory. Files are opened on their first write.
+	 * Batches go through a storagering when io_uring is available,
+	 * pwrite is used otherwise.
+	 * In DIRECT mode the files are preallocated with fallocate and
+	 * written with O_DIRECT, so they bypass the page cache: whole 4K
+	 * blocks are written from an aligned staging buffer, the blocks
+	 * a segment shares with its neighbours are collected in memory
+	 * and written once every byte of them arrived (or on close), for
+	 * a file that already existed they start from what is on the disk
+	 * so the data of a resumed job is kept.
+	 * In MAPPED mode files of known size up to MAPLIMIT are mapped in
+	 * memory, the decoder writes each segment straight to its place
+	 * (see region), the map is synced to the file on close.
+	 */
+	class fileassembler
+	{
+	public:
+		/**
+		 * How the files are written.
+		 */
+		enum outputmode { BUFFERED, DIRECT, MAPPED };
+
+		/**
+		 * A segment of a batch.
+		 */
+		struct segment
+		{
+			unsigned int file;
+
+			/**
+			 * Name of the file, must stay valid during the write.
+			 */
+			const std::string *name;
+			unsigned long size;
+			unsigned long offset;
+			const char *data;
+			unsigned long length;
+
+			/**
+			 * Set by write, was it written?
+			 */
+			bool ok;
+		};
+
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param directory = Where the files are written.
+		 */
+		fileassembler(const std::string &directory);
+
+		/**
+		 * Destructor.
+		 *
+		 * @note Closes every file.
+		 * @public
+		 */
+		~fileassembler();
+
+		/**
+		 * Write a segment.
+		 *
+		 * @public
+		 *
+		 * @param   file = Position of the file in the job.
+		 * @param   name = Name of the file, used on the first write.
+		 * @param   size = Size of the whole file if known (0 if not),
+		 * used on the first write.
+		 * @param offset = Where the segment goes in the file.
+		 * @param   data = The decoded segment.
+		 * @param length = Length of the segment.
+		 * @return  bool = Was it written?
+		 */
+		bool write(const unsigned int &file, const std::string &name,
+				const unsigned long &size, const unsigned long &offset,
+				const char *data, const unsigned long &length);
+
+		/**
+		 * Write a batch of segments, with 1 submission when io_uring
+		 * is available.
+		 *
+		 * @public
+		 *
+		 * @param batch = The segments, ok is set on each.
+		 */
+		void write(std::vector<segment> &batch);
+
+		/**
+		 * Close a file once every segment was written.
+		 *
+		 * @note The data is flushed to the disk first if setsync was on.
+		 * @public
+		 *
+		 * @param file = Position of the file in the job.
+		 * @return bool = Did it close without errors?
+		 */
+		bool close(const unsigned int &file);
+
+		/**
+		 * Close every file.
+		 *
+		 * @public
+		 */
+		void closeall();
+
+		/**
+		 * Path/file a file name is written to, path separators and
+		 * control chars in the name are replaced.
+		 *
+		 * @public
+		 *
+		 * @param name = The file name.
+		 * @return The path.
+		 */
+		std::string path(const std::string &name) const;
+
+		/**
+		 * Amount of bytes written.
+		 *
+		 * @public
+		 */
+		unsigned long written() const;
+
+		/**
+		 * Where a segment goes in the memory map of its file, for
+		 * the decoder to write to.
+		 *
+		 * @note Call filled once written.
+		 * @public
+		 *
+		 * @param   file = Position of the file in the job.
+		 * @param   name = Name of the file, used on the first write.
+		 * @param   size = Size of the whole file if known (0 if not),
+		 * used on the first write.
+		 * @param offset = Where the segment goes in the file.
+		 * @param length = Most bytes of the segment.
+		 * @return The address, NULL when the file is not mapped (write
+		 * the segment with write then).
+		 */
+		char *region(const unsigned int &file, const std::string &name,
+				const unsigned long &size, const unsigned long &offset,
+				const unsigned long &length);
+
+		/**
+		 * Count bytes written to a region.
+		 *
+		 * @public
+		 *
+		 * @param length = Amount of bytes.
+		 */
+		void filled(const unsigned long &length);
+
+		/**
+		 * Flush each file to the disk when it is closed.
+		 *
+		 * @public
+		 *
+		 * @param sync = Flush?
+		 */
+		void setsync(const bool &sync);
+
+		/**
+		 * Are batches written with io_uring?
+		 *
+		 * @public
+		 */
+		bool uring() const;
+
+		/**
+		 * Change how the files opened from now on are written.
+		 *
+		 * @note DIRECT falls back to BUFFERED for files whose file
+		 * system refuses O_DIRECT.
+		 * @public
+		 *
+		 * @param mode = The mode.
+		 */
+		void setmode(const outputmode &mode);
+
+	private:
+		/**
+		 * Alignment and size of the O_DIRECT blocks.
+		 *
+		 * @private
+		 */
+		static const unsigned long BLOCK = 4096;
+
+		/**
+		 * Largest file mapped in MAPPED mode.
+		 *
+		 * @private
+		 */
+		static const unsigned long MAPLIMIT = 1073741824;
+
+		/**
+		 * A block shared by segments, filled = bytes of it written.
+		 *
+		 * @private
+		 */
+		struct block
+		{
+			char *data;
+			unsigned long filled;
+		};
+
+		/**
+		 * An aligned buffer whole blocks are copied to for O_DIRECT.
+		 *
+		 * @private
+		 */
+		struct staging
+		{
+			char *data;
+			unsigned long size;
+		};
+
+		/**
+		 * An open file.
+		 *
+		 * @private
+		 */
+		struct output
+		{
+			int fd;
+
+			/**
+			 * Opened with O_DIRECT?
+			 */
+			bool direct;
+
+			/**
+			 * Did the file hold data before it was opened (a resumed
+			 * job)? Its shared blocks then start from the disk.
+			 */
+			bool existing;
+
+			/**
+			 * Size of the file (0 if not known), end of the furthest
+			 * segment.
+			 */
+			unsigned long size;
+			unsigned long end;
+
+			/**
+			 * The blocks being filled, by position in the file.
+			 */
+			std::map<unsigned long, block> blocks;
+
+			/**
+			 * The memory map of the file (NULL if not mapped), its size.
+			 */
+			char *map;
+			unsigned long mapsize;
+		};
+
+		/**
+		 * Where the files are written.
+		 *
+		 * @private
+		 */
+		std::string directory;
+
+		/**
+		 * The open files, by position in the job, fd is -1 when not open.
+		 *
+		 * @private
+		 */
+		std::vector<output> outputs;
+
+		/**
+		 * Mode of the files opened from now on.
+		 *
+		 * @private
+		 */
+		outputmode mode = BUFFERED;
+
+		/**
+		 * Staging buffers not in use, at most 1 per writing thread,
+		 * kept so each O_DIRECT write does not allocate.
+		 *
+		 * @private
+		 */
+		std::vector<staging> stagings;
+
+		/**
+		 * Protects outputs, mode and stagings.
+		 *
+		 * @private
+		 */
+		std::mutex lock;
+
+		/**
+		 * Amount of bytes written.
+		 *
+		 * @private
+		 */
+		std::atomic<unsigned long> bytes;
+
+		/**
+		 * Flush the files when closed.
+		 *
+		 * @private
+		 */
+		std::atomic<bool> sync;
+
+		/**
+		 * Writes the batches when io_uring is available.
+		 *
+		 * @private
+		 */
+		storagering ring;
+
+		/**
+		 * Get the descriptor of a file, opening it if needed.
+		 *
+		 * @private
+		 *
+		 * @param   file = Position of the file in the job.
+		 * @param   name = Name of the file.
+		 * @param   size = Size of the whole file, 0 if unknown.
+		 * @param direct = Set to whether the file uses O_DIRECT.
+		 * @return The descriptor, -1 on failure.
+		 */
+		int descriptor(const unsigned int &file, const std::string &name,
+				const unsigned long &size, bool &direct);
+
+		/**
+		 * Write a segment to a file opened with O_DIRECT.
+		 *
+		 * @private
+		 *
+		 * @param   file = Position of the file in the job.
+		 * @param     fd = Its descriptor.
+		 * @param offset = Where the segment goes in the file.
+		 * @param   data = The decoded segment.
+		 * @param length = Length of the segment.
+		 * @return  bool = Was it written?
+		 */
+		bool writedirect(const unsigned int &file, const int &fd, const unsigned long &offset,
+				const char *data, const unsigned long &length);
+
+		/**
+		 * Take a staging buffer, grown to a size if needed.
+		 *
+		 * @private
+		 *
+		 * @param length = Least size.
+		 * @return The buffer, data is NULL if it could not be allocated.
+		 */
+		staging takestaging(const unsigned long &length);
+
+		/**
+		 * Give a staging buffer back for reuse.
+		 *
+		 * @private
+		 *
+		 * @param buffer = The buffer from takestaging.
+		 */
+		void givestaging(const staging &buffer);
+
+		/**
+		 * Write the blocks still being filled, sync and remove the map
+		 * and set the final size of a file, then forget it.
+		 *
+		 * @note lock must be held.
+		 * @private
+		 *
+		 * @param out = The file.
+		 * @return bool = Did it work?
+		 */
+		bool release(output &out);
+
+		/**
+		 * Write all of a buffer with pwrite.
+		 *
+		 * @private
+		 *
+		 * @param     fd = The file descriptor.
+		 * @param   data = The buffer.
+		 * @param length = Length of the buffer.
+		 * @param offset = Where it goes in the file.
+		 * @return  bool = Was it written?
+		 */
+		bool writeat(const int &fd, const char *data, const unsigned long &length,
+				const unsigned long &offset);
+	};
+}
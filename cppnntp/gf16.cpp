@@ -0,0 +1,250 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GF16_X86
+#include <immintrin.h>
+#endif
+#include "gf16.hpp"
+namespace cppnntp {
+	/**
+	 * Logarithm and exponent tables, exp is doubled so a sum of
+	 * 2 logarithms needs no modulo.
+	 */
+	struct gf16tables
+	{
+		uint16_t log[65536];
+		uint16_t exp[131070];
+
+		gf16tables() {
+			unsigned long x = 1;
+			for (unsigned long i = 0; i < 65535; i++) {
+				exp[i] = exp[i + 65535] = x;
+				log[x] = i;
+				x <<= 1;
+				if (x & 0x10000)
+					x ^= 0x1100B;
+			}
+			log[0] = 0;
+		}
+	};
+
+	/**
+	 * The tables, built on first use.
+	 */
+	static const gf16tables &tables() {
+		static const gf16tables t;
+		return t;
+	}
+
+	/**
+	 * Kernels, by what the CPU supports.
+	 */
+	enum gf16level { SCALAR, SSSE3, AVX2 };
+
+	static gf16level detect() {
+#ifdef GF16_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return AVX2;
+		if (__builtin_cpu_supports("ssse3"))
+			return SSSE3;
+#endif
+		return SCALAR;
+	}
+
+	static gf16level level() {
+		static const gf16level l = detect();
+		return l;
+	}
+
+#ifdef GF16_X86
+	/**
+	 * multiplyadd with SSSE3, 16 words at a time.
+	 *
+	 * @param lo = Low bytes of the products of each nibble.
+	 * @param hi = High bytes of the products of each nibble.
+	 * @return Bytes done, the rest is left to the scalar loop.
+	 */
+	__attribute__((target("ssse3")))
+	static unsigned long ssse3kernel(const unsigned char lo[4][16], const unsigned char hi[4][16],
+			const unsigned char *src, unsigned char *dst, const unsigned long &length) {
+		__m128i tl[4], th[4];
+		for (int k = 0; k < 4; k++) {
+			tl[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo[k]));
+			th[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi[k]));
+		}
+		const __m128i mask = _mm_set1_epi8(0x0F);
+		// Low bytes of the words to the first half, high bytes to the second.
+		const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+		unsigned long i = 0;
+		for (; i + 32 <= length; i += 32) {
+			const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), split);
+			const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16)), split);
+			const __m128i l = _mm_unpacklo_epi64(a, b);
+			const __m128i h = _mm_unpackhi_epi64(a, b);
+			const __m128i n0 = _mm_and_si128(l, mask);
+			const __m128i n1 = _mm_and_si128(_mm_srli_epi16(l, 4), mask);
+			const __m128i n2 = _mm_and_si128(h, mask);
+			const __m128i n3 = _mm_and_si128(_mm_srli_epi16(h, 4), mask);
+			const __m128i pl = _mm_xor_si128(
+				_mm_xor_si128(_mm_shuffle_epi8(tl[0], n0), _mm_shuffle_epi8(tl[1], n1)),
+				_mm_xor_si128(_mm_shuffle_epi8(tl[2], n2), _mm_shuffle_epi8(tl[3], n3)));
+			const __m128i ph = _mm_xor_si128(
+				_mm_xor_si128(_mm_shuffle_epi8(th[0], n0), _mm_shuffle_epi8(th[1], n1)),
+				_mm_xor_si128(_mm_shuffle_epi8(th[2], n2), _mm_shuffle_epi8(th[3], n3)));
+			__m128i *out = reinterpret_cast<__m128i *>(dst + i);
+			_mm_storeu_si128(out, _mm_xor_si128(_mm_loadu_si128(out), _mm_unpacklo_epi8(pl, ph)));
+			_mm_storeu_si128(out + 1, _mm_xor_si128(_mm_loadu_si128(out + 1), _mm_unpackhi_epi8(pl, ph)));
+		}
+		return i;
+	}
+
+	/**
+	 * multiplyadd with AVX2, 32 words at a time.
+	 *
+	 * @note The shuffles work within each 128 bit lane, the unpacks
+	 * put the words back where the loads found them.
+	 * @param lo = Low bytes of the products of each nibble.
+	 * @param hi = High bytes of the products of each nibble.
+	 * @return Bytes done, the rest is left to the scalar loop.
+	 */
+	__attribute__((target("avx2")))
+	static unsigned long avx2kernel(const unsigned char lo[4][16], const unsigned char hi[4][16],
+			const unsigned char *src, unsigned char *dst, const unsigned long &length) {
+		__m256i tl[4], th[4];
+		for (int k = 0; k < 4; k++) {
+			tl[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo[k])));
+			th[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(hi[k])));
+		}
+		const __m256i mask = _mm256_set1_epi8(0x0F);
+		const __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+			0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+		unsigned long i = 0;
+		for (; i + 64 <= length; i += 64) {
+			const __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), split);
+			const __m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32)), split);
+			const __m256i l = _mm256_unpacklo_epi64(a, b);
+			const __m256i h = _mm256_unpackhi_epi64(a, b);
+			const __m256i n0 = _mm256_and_si256(l, mask);
+			const __m256i n1 = _mm256_and_si256(_mm256_srli_epi16(l, 4), mask);
+			const __m256i n2 = _mm256_and_si256(h, mask);
+			const __m256i n3 = _mm256_and_si256(_mm256_srli_epi16(h, 4), mask);
+			const __m256i pl = _mm256_xor_si256(
+				_mm256_xor_si256(_mm256_shuffle_epi8(tl[0], n0), _mm256_shuffle_epi8(tl[1], n1)),
+				_mm256_xor_si256(_mm256_shuffle_epi8(tl[2], n2), _mm256_shuffle_epi8(tl[3], n3)));
+			const __m256i ph = _mm256_xor_si256(
+				_mm256_xor_si256(_mm256_shuffle_epi8(th[0], n0), _mm256_shuffle_epi8(th[1], n1)),
+				_mm256_xor_si256(_mm256_shuffle_epi8(th[2], n2), _mm256_shuffle_epi8(th[3], n3)));
+			__m256i *out = reinterpret_cast<__m256i *>(dst + i);
+			_mm256_storeu_si256(out, _mm256_xor_si256(_mm256_loadu_si256(out), _mm256_unpacklo_epi8(pl, ph)));
+			_mm256_storeu_si256(out + 1, _mm256_xor_si256(_mm256_loadu_si256(out + 1), _mm256_unpackhi_epi8(pl, ph)));
+		}
+		return i;
+	}
+#endif
+
+	/**
+	 * Multiply 2 elements.
+	 *
+	 * @public
+	 */
+	uint16_t gf16::multiply(const uint16_t &a, const uint16_t &b) {
+		if (a == 0 || b == 0)
+			return 0;
+		const gf16tables &t = tables();
+		return t.exp[t.log[a] + t.log[b]];
+	}
+
+	/**
+	 * Divide 2 elements, b can not be 0.
+	 *
+	 * @public
+	 */
+	uint16_t gf16::divide(const uint16_t &a, const uint16_t &b) {
+		if (a == 0)
+			return 0;
+		const gf16tables &t = tables();
+		return t.exp[t.log[a] + 65535 - t.log[b]];
+	}
+
+	/**
+	 * Raise an element to a power.
+	 *
+	 * @public
+	 */
+	uint16_t gf16::power(const uint16_t &a, const unsigned long &exponent) {
+		if (exponent == 0)
+			return 1;
+		if (a == 0)
+			return 0;
+		const gf16tables &t = tables();
+		return t.exp[(static_cast<uint64_t>(t.log[a]) * (exponent % 65535)) % 65535];
+	}
+
+	/**
+	 * 2 raised to a power (the generator).
+	 *
+	 * @public
+	 */
+	uint16_t gf16::exp(const unsigned long &exponent) {
+		return tables().exp[exponent % 65535];
+	}
+
+	/**
+	 * dst ^= factor * src, over 16 bit little endian words.
+	 *
+	 * @public
+	 *
+	 * @param factor = The factor.
+	 * @param    src = The words to multiply.
+	 * @param    dst = Where the products are added.
+	 * @param length = Length in bytes, a multiple of 2.
+	 */
+	void gf16::multiplyadd(const uint16_t &factor, const unsigned char *src,
+			unsigned char *dst, const unsigned long &length) {
+		if (factor == 0)
+			return;
+
+		// Products of the factor and each nibble value, at each nibble position.
+		uint16_t products[4][16];
+		unsigned char lo[4][16], hi[4][16];
+		for (int k = 0; k < 4; k++) {
+			for (int n = 0; n < 16; n++) {
+				products[k][n] = multiply(factor, n << (4 * k));
+				lo[k][n] = products[k][n] & 0xFF;
+				hi[k][n] = products[k][n] >> 8;
+			}
+		}
+
+		unsigned long i = 0;
+#ifdef GF16_X86
+		const gf16level l = level();
+		if (l == AVX2)
+			i = avx2kernel(lo, hi, src, dst, length);
+		else if (l == SSSE3)
+			i = ssse3kernel(lo, hi, src, dst, length);
+#else
+		static_cast<void>(lo);
+		static_cast<void>(hi);
+#endif
+		for (; i + 1 < length; i += 2) {
+			const uint16_t w = src[i] | (src[i + 1] << 8);
+			const uint16_t p = products[0][w & 15] ^ products[1][(w >> 4) & 15]
+				^ products[2][(w >> 8) & 15] ^ products[3][w >> 12];
+			dst[i] ^= p & 0xFF;
+			dst[i + 1] ^= p >> 8;
+		}
+	}
+
+	/**
+	 * Name of the kernel used by multiplyadd.
+	 *
+	 * @public
+	 *
+	 * @return "avx2", "ssse3" or "scalar".
+	 */
+	std::string gf16::kernel() {
+		const gf16level l = level();
+		return l == AVX2 ? "avx2" : l == SSSE3 ? "ssse3" : "scalar";
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace cppnntp
+{
+	/**
+	 * Arithmetic in GF(2^16) with the PAR2 polynomial (0x1100B).
+	 *
+	 * @note multiplyadd is the inner loop of the PAR2 recovery: every
+	 * 16 bit word is split in 4 nibbles, each looked up in a 16 entry
+	 * table of the factor's products. With SSSE3 or AVX2 the lookups
+	 * are done 16 or 32 at a time with pshufb, the kernel is picked
+	 * once at run time from what the CPU supports.
+	 */
+	class gf16
+	{
+	public:
+		/**
+		 * Multiply 2 elements.
+		 *
+		 * @public
+		 */
+		static uint16_t multiply(const uint16_t &a, const uint16_t &b);
+
+		/**
+		 * Divide 2 elements, b can not be 0.
+		 *
+		 * @public
+		 */
+		static uint16_t divide(const uint16_t &a, const uint16_t &b);
+
+		/**
+		 * Raise an element to a power.
+		 *
+		 * @public
+		 */
+		static uint16_t power(const uint16_t &a, const unsigned long &exponent);
+
+		/**
+		 * 2 raised to a power (the generator).
+		 *
+		 * @public
+		 */
+		static uint16_t exp(const unsigned long &exponent);
+
+		/**
+		 * dst ^= factor * src, over 16 bit little endian words.
+		 *
+		 * @public
+		 *
+		 * @param factor = The factor.
+		 * @param    src = The words to multiply.
+		 * @param    dst = Where the products are added.
+		 * @param length = Length in bytes, a multiple of 2.
+		 */
+		static void multiplyadd(const uint16_t &factor, const unsigned char *src,
+				unsigned char *dst, const unsigned long &length);
+
+		/**
+		 * Name of the kernel used by multiplyadd.
+		 *
+		 * @public
+		 *
+		 * @return "avx2", "ssse3" or "scalar".
+		 */
+		static std::string kernel();
+	};
+}
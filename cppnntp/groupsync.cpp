@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "groupsync.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @note Loads the state file if it exists.
+	 * @public
+	 *
+	 * @param statefile = Path/file where the state is stored
+	 * (example: /home/kevin/.cppnntp/groups.state).
+	 * @param   initial = Maximum amount of articles to fetch the
+	 * first time a group is synced, 0 for all of them.
+	 */
+	groupsync::groupsync(const std::string &statefile, const unsigned long &initial)
+		: statefile(statefile), initial(initial) {
+		load();
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	groupsync::~groupsync() {}
+
+	/**
+	 * Download the overview of every article posted since the
+	 * last sync of a group over 1 connection.
+	 *
+	 * @note The group is selected on the connection. The state
+	 * file is updated when the rows have been fetched.
+	 * @public
+	 *
+	 * @param connection = A connected, logged in connection.
+	 * @param  groupname = The name of the group.
+	 * @param       rows = Where the new rows are added.
+	 * @return      bool = Did the sync succeed?
+	 */
+	bool groupsync::sync_group(nntp &connection, const std::string &groupname,
+			overview &rows) {
+		return sync_group(connection, groupname,
+			[&rows](const overview &chunk) {
+				rows.add(chunk);
+				return true;
+			});
+	}
+
+	/**
+	 * Download the overview of every article posted since the
+	 * last sync of a group over many connections.
+	 *
+	 * @public
+	 *
+	 * @param   scanner = The scanner to use.
+	 * @param groupname = The name of the group.
+	 * @param      rows = Where the new rows are added.
+	 * @return     bool = Did the sync succeed?
+	 */
+	bool groupsync::sync_group(xoverscan &scanner, const std::string &groupname,
+			overview &rows) {
+		return sync_group(scanner, groupname,
+			[&rows](const overview &chunk) {
+				rows.add(chunk);
+				return true;
+			});
+	}
+
+	/**
+	 * Download the overview of every article posted since the
+	 * last sync of a group over 1 connection, straight into an
+	 * overview database.
+	 *
+	 * @note Segments holding only articles below the new
+	 * low-water mark are removed from the database.
+	 * When the server renumbered the group the database is
+	 * emptied first (see overviewdb::reset).
+	 * @public
+	 *
+	 * @param connection = A connected, logged in connection.
+	 * @param  groupname = The name of the group.
+	 * @param         db = Where the new rows are appended.
+	 * @return      bool = Did the sync succeed?
+	 */
+	bool groupsync::sync_group(nntp &connection, const std::string &groupname,
+			overviewdb &db) {
+		// The rows must be on disk before the state says they are indexed.
+		bool synced = sync_group(connection, groupname,
+			[this, &db](const overview &chunk) {
+				restart(db);
+				db.append(chunk);
+				return db.flush();
+			});
+		restart(db);
+
+		groupstate current;
+		if (state(groupname, current))
+			db.expire(current.low);
+		return synced;
+	}
+
+	/**
+	 * Download the overview of every article posted since the
+	 * last sync of a group over many connections, straight into
+	 * an overview database.
+	 *
+	 * @note See the version above.
+	 * @public
+	 *
+	 * @param   scanner = The scanner to use.
+	 * @param groupname = The name of the group.
+	 * @param        db = Where the new rows are appended.
+	 * @return     bool = Did the sync succeed?
+	 */
+	bool groupsync::sync_group(xoverscan &scanner, const std::string &groupname,
+			overviewdb &db) {
+		// The rows must be on disk before the state says they are indexed.
+		bool synced = sync_group(scanner, groupname,
+			[this, &db](const overview &chunk) {
+				restart(db);
+				db.append(chunk);
+				return db.flush();
+			});
+		restart(db);
+
+		groupstate current;
+		if (state(groupname, current))
+			db.expire(current.low);
+		return synced;
+	}
+
+	/**
+	 * Download the overview of every article posted since the
+	 * last sync of a group over 1 connection and pass it to a
+	 * function, chunk by chunk, in article number order.
+	 *
+	 * @note The state is only advanced past chunks the
+	 * function accepted.
+	 * @public
+	 *
+	 * @param connection = A connected, logged in connection.
+	 * @param  groupname = The name of the group.
+	 * @param       sink = Called with the rows of each chunk,
+	 * returning false stops the sync.
+	 * @return      bool = Did the sync succeed?
+	 */
+	bool groupsync::sync_group(nntp &connection, const std::string &groupname,
+			const std::function<bool(const overview &)> &sink) {
+		if (!connection.group(groupname))
+			return false;
+
+		const unsigned long newest = connection.group_newest();
+		unsigned long first;
+		if (!plan(groupname, connection.group_oldest(), newest, first))
+			return advance(groupname, newest);
+
+		// Don't ask for millions of headers in 1 command.
+		const unsigned long chunksize = 50000;
+		overview chunk;
+		while (first <= newest) {
+			const unsigned long last = std::min(newest, first + chunksize - 1);
+			chunk.clear();
+			if (!connection.xover(std::to_string(first), std::to_string(last), chunk)
+					|| !sink(chunk)) {
+				// Keep what we got so far.
+				if (first > 0)
+					advance(groupname, first - 1);
+				return false;
+			}
+			first = last + 1;
+		}
+		return advance(groupname, newest);
+	}
+
+	/**
+	 * Download the overview of every article posted since the
+	 * last sync of a group over many connections and pass it to
+	 * a function, chunk by chunk, in article number order.
+	 *
+	 * @note See the version above.
+	 * @public
+	 *
+	 * @param   scanner = The scanner to use.
+	 * @param groupname = The name of the group.
+	 * @param      sink = Called with the rows of each chunk,
+	 * returning false stops the sync.
+	 * @return     bool = Did the sync succeed?
+	 */
+	bool groupsync::sync_group(xoverscan &scanner, const std::string &groupname,
+			const std::function<bool(const overview &)> &sink) {
+		unsigned long oldest, newest, first;
+		if (!scanner.bounds(groupname, oldest, newest))
+			return false;
+
+		if (!plan(groupname, oldest, newest, first))
+			return advance(groupname, newest);
+
+		// Newest article the sink accepted, the chunks come in order.
+		unsigned long reached = 0;
+		bool synced = scanner.scan(groupname, first, newest,
+			[&sink, &reached](const overview &chunk) {
+				if (!sink(chunk))
+					return false;
+				if (chunk.size() > 0)
+					reached = chunk.number(chunk.size() - 1);
+				return true;
+			});
+
+		if (!synced) {
+			// Keep what we got so far.
+			advance(groupname, reached);
+			return false;
+		}
+		return advance(groupname, newest);
+	}
+
+	/**
+	 * Get the state of a group.
+	 *
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @param     state = Where the state is copied.
+	 * @return     bool = Was the group synced before?
+	 */
+	bool groupsync::state(const std::string &groupname, groupstate &state) const {
+		std::map<std::string, groupstate>::const_iterator it = groups.find(groupname);
+		if (it == groups.end())
+			return false;
+
+		state = it->second;
+		return true;
+	}
+
+	/**
+	 * Read the state file.
+	 *
+	 * @public
+	 *
+	 * @return bool = Did we read it? (False if it does not exist.)
+	 */
+	bool groupsync::load() {
+		std::ifstream file(statefile.c_str());
+		if (!file.is_open())
+			return false;
+
+		groups.clear();
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream in(line);
+			groupstate state;
+			if (in >> state.name >> state.last >> state.low)
+				groups[state.name] = state;
+		}
+		return true;
+	}
+
+	/**
+	 * Write the state file.
+	 *
+	 * @note Written to a temporary file first, then renamed, so
+	 * a crash never leaves a half written state file.
+	 * @public
+	 *
+	 * @return bool = Did we write it?
+	 */
+	bool groupsync::save() {
+		const std::string temporary = statefile + ".tmp";
+		{
+			std::ofstream file(temporary.c_str(), std::ios::trunc);
+			if (!file.is_open())
+				return false;
+
+			std::map<std::string, groupstate>::const_iterator it;
+			for (it = groups.begin(); it != groups.end(); ++it)
+				file << it->second.name << ' ' << it->second.last
+					 << ' ' << it->second.low << '\n';
+
+			file.flush();
+			if (!file.good())
+				return false;
+		}
+		return std::rename(temporary.c_str(), statefile.c_str()) == 0;
+	}
+
+	/**
+	 * Work out which articles need to be fetched, given the
+	 * current oldest and newest articles of a group.
+	 *
+	 * @note Also raises the low-water mark when the server
+	 * expired articles since the last sync.
+	 * @private
+	 *
+	 * @param groupname = The name of the group.
+	 * @param    oldest = The oldest article on the server.
+	 * @param    newest = The newest article on the server.
+	 * @param     first = Where the first article to fetch is stored.
+	 * @return     bool = Is there anything to fetch?
+	 */
+	bool groupsync::plan(const std::string &groupname, const unsigned long &oldest,
+			const unsigned long &newest, unsigned long &first) {
+		renumbered = false;
+		std::map<std::string, groupstate>::iterator it = groups.find(groupname);
+
+		// First sync of this group.
+		if (it == groups.end()) {
+			groupstate state;
+			state.name = groupname;
+			state.last = 0;
+			state.low = oldest;
+			it = groups.insert(std::make_pair(groupname, state)).first;
+
+			first = oldest;
+			if (initial > 0 && newest >= initial && newest - initial + 1 > first)
+				first = newest - initial + 1;
+			return newest >= first && newest > 0;
+		}
+
+		groupstate &state = it->second;
+
+		// The server renumbered the group, start over.
+		if (newest < state.last) {
+			renumbered = true;
+			state.last = 0;
+			state.low = oldest;
+			first = oldest;
+			return newest >= first && newest > 0;
+		}
+
+		// Articles below the new low-water mark have expired.
+		if (oldest > state.low)
+			state.low = oldest;
+
+		// Anything we missed while not running may be expired too.
+		first = std::max(state.last + 1, oldest);
+		return newest >= first;
+	}
+
+	/**
+	 * Remember the newest indexed article of a group and
+	 * save the state file.
+	 *
+	 * @private
+	 *
+	 * @param groupname = The name of the group.
+	 * @param      last = The newest indexed article.
+	 * @return     bool = Did we save the state file?
+	 */
+	bool groupsync::advance(const std::string &groupname, const unsigned long &last) {
+		std::map<std::string, groupstate>::iterator it = groups.find(groupname);
+		if (it == groups.end())
+			return false;
+
+		if (last > it->second.last)
+			it->second.last = last;
+		return save();
+	}
+
+	/**
+	 * Empty an overview database if the last plan found the group
+	 * renumbered, the stored article numbers mean nothing anymore
+	 * and the new rows would be skipped as older.
+	 *
+	 * @private
+	 *
+	 * @param db = The database.
+	 */
+	void groupsync::restart(overviewdb &db) {
+		if (!renumbered)
+			return;
+		db.reset();
+		renumbered = false;
+	}
+}
@@ -0,0 +1,265 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <string>
+#include "nntp.hpp"
+#include "overview.hpp"
+#include "overviewdb.hpp"
+#include "xoverscan.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * What we know about a group from the previous runs.
+	 */
+	struct groupstate
+	{
+		/**
+		 * Name of the group.
+		 */
+		std::string name;
+
+		/**
+		 * Newest article number already indexed, 0 if none.
+		 */
+		unsigned long last;
+
+		/**
+		 * Oldest article number the server still had on the last
+		 * sync (the retention low-water mark), articles below this
+		 * are expired.
+		 */
+		unsigned long low;
+	};
+
+	/**
+	 * Keeps track of which articles of each group were already indexed,
+	 * so a sync only downloads the overview of new articles.
+	 *
+	 * @note The state is stored in a text file, 1 line per group:
+	 * name last low
+	 */
+	class groupsync
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @note Loads the state file if it exists.
+		 * @public
+		 *
+		 * @param statefile = Path/file where the state is stored
+		 * (example: /home/kevin/.cppnntp/groups.state).
+		 * @param   initial = Maximum amount of articles to fetch the
+		 * first time a group is synced, 0 for all of them.
+		 */
+		groupsync(const std::string &statefile, const unsigned long &initial = 0);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~groupsync();
+
+		/**
+		 * Download the overview of every article posted since the
+		 * last sync of a group over 1 connection.
+		 *
+		 * @note The group is selected on the connection. The state
+		 * file is updated when the rows have been fetched.
+		 * @public
+		 *
+		 * @param connection = A connected, logged in connection.
+		 * @param  groupname = The name of the group.
+		 * @param       rows = Where the new rows are added.
+		 * @return      bool = Did the sync succeed?
+		 */
+		bool sync_group(nntp &connection, const std::string &groupname,
+				overview &rows);
+
+		/**
+		 * Download the overview of every article posted since the
+		 * last sync of a group over many connections.
+		 *
+		 * @public
+		 *
+		 * @param   scanner = The scanner to use.
+		 * @param groupname = The name of the group.
+		 * @param      rows = Where the new rows are added.
+		 * @return     bool = Did the sync succeed?
+		 */
+		bool sync_group(xoverscan &scanner, const std::string &groupname,
+				overview &rows);
+
+		/**
+		 * Download the overview of every article posted since the
+		 * last sync of a group over 1 connection, straight into an
+		 * overview database.
+		 *
+		 * @note Segments holding only articles below the new
+		 * low-water mark are removed from the database.
+		 * When the server renumbered the group the database is
+		 * emptied first (see overviewdb::reset).
+		 * @public
+		 *
+		 * @param connection = A connected, logged in connection.
+		 * @param  groupname = The name of the group.
+		 * @param         db = Where the new rows are appended.
+		 * @return      bool = Did the sync succeed?
+		 */
+		bool sync_group(nntp &connection, const std::string &groupname,
+				overviewdb &db);
+
+		/**
+		 * Download the overview of every article posted since the
+		 * last sync of a group over many connections, straight into
+		 * an overview database.
+		 *
+		 * @note See the version above.
+		 * @public
+		 *
+		 * @param   scanner = The scanner to use.
+		 * @param groupname = The name of the group.
+		 * @param        db = Where the new rows are appended.
+		 * @return     bool = Did the sync succeed?
+		 */
+		bool sync_group(xoverscan &scanner, const std::string &groupname,
+				overviewdb &db);
+
+		/**
+		 * Download the overview of every article posted since the
+		 * last sync of a group over 1 connection and pass it to a
+		 * function, chunk by chunk, in article number order.
+		 *
+		 * @note The state is only advanced past chunks the
+		 * function accepted.
+		 * @public
+		 *
+		 * @param connection = A connected, logged in connection.
+		 * @param  groupname = The name of the group.
+		 * @param       sink = Called with the rows of each chunk,
+		 * returning false stops the sync.
+		 * @return      bool = Did the sync succeed?
+		 */
+		bool sync_group(nntp &connection, const std::string &groupname,
+				const std::function<bool(const overview &)> &sink);
+
+		/**
+		 * Download the overview of every article posted since the
+		 * last sync of a group over many connections and pass it to
+		 * a function, chunk by chunk, in article number order.
+		 *
+		 * @note See the version above.
+		 * @public
+		 *
+		 * @param   scanner = The scanner to use.
+		 * @param groupname = The name of the group.
+		 * @param      sink = Called with the rows of each chunk,
+		 * returning false stops the sync.
+		 * @return     bool = Did the sync succeed?
+		 */
+		bool sync_group(xoverscan &scanner, const std::string &groupname,
+				const std::function<bool(const overview &)> &sink);
+
+		/**
+		 * Get the state of a group.
+		 *
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @param     state = Where the state is copied.
+		 * @return     bool = Was the group synced before?
+		 */
+		bool state(const std::string &groupname, groupstate &state) const;
+
+		/**
+		 * Read the state file.
+		 *
+		 * @public
+		 *
+		 * @return bool = Did we read it? (False if it does not exist.)
+		 */
+		bool load();
+
+		/**
+		 * Write the state file.
+		 *
+		 * @note Written to a temporary file first, then renamed, so
+		 * a crash never leaves a half written state file.
+		 * @public
+		 *
+		 * @return bool = Did we write it?
+		 */
+		bool save();
+
+	private:
+		/**
+		 * Path/file of the state file.
+		 *
+		 * @private
+		 */
+		std::string statefile;
+
+		/**
+		 * Maximum amount of articles to fetch on the first sync.
+		 *
+		 * @private
+		 */
+		unsigned long initial;
+
+		/**
+		 * The state of every group, by name.
+		 *
+		 * @private
+		 */
+		std::map<std::string, groupstate> groups;
+
+		/**
+		 * Did the last plan find the group renumbered?
+		 *
+		 * @private
+		 */
+		bool renumbered = false;
+
+		/**
+		 * Work out which articles need to be fetched, given the
+		 * current oldest and newest articles of a group.
+		 *
+		 * @note Also raises the low-water mark when the server
+		 * expired articles since the last sync.
+		 * @private
+		 *
+		 * @param groupname = The name of the group.
+		 * @param    oldest = The oldest article on the server.
+		 * @param    newest = The newest article on the server.
+		 * @param     first = Where the first article to fetch is stored.
+		 * @return     bool = Is there anything to fetch?
+		 */
+		bool plan(const std::string &groupname, const unsigned long &oldest,
+				const unsigned long &newest, unsigned long &first);
+
+		/**
+		 * Remember the newest indexed article of a group and
+		 * save the state file.
+		 *
+		 * @private
+		 *
+		 * @param groupname = The name of the group.
+		 * @param      last = The newest indexed article.
+		 * @return     bool = Did we save the state file?
+		 */
+		bool advance(const std::string &groupname, const unsigned long &last);
+
+		/**
+		 * Empty an overview database if the last plan found the group
+		 * renumbered, the stored article numbers mean nothing anymore
+		 * and the new rows would be skipped as older.
+		 *
+		 * @private
+		 *
+		 * @param db = The database.
+		 */
+		void restart(overviewdb &db);
+	};
+}
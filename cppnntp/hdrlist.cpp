@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstring>
+#include "hdrlist.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	hdrlist::hdrlist() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	hdrlist::~hdrlist() {}
+
+	/**
+	 * Add a pair to the list.
+	 *
+	 * @public
+	 *
+	 * @param number = The article number (0 when HDR/XHDR was
+	 * sent with a message-id).
+	 * @param  value = The header value.
+	 * @param length = The length of the header value.
+	 */
+	void hdrlist::add(const unsigned long &number, const char *value,
+			const unsigned long &length) {
+		entry e;
+		e.number = number;
+		e.offset = values.append(value, length);
+		e.length = length;
+		entries.push_back(e);
+	}
+
+	/**
+	 * Parse a HDR/XHDR response and add every line to the list.
+	 *
+	 * @public
+	 *
+	 * @param finalbuffer = The response, including the response
+	 * line and the terminating .CRLF
+	 * @return       bool = Was the response well formed?
+	 */
+	bool hdrlist::parse(const std::string &finalbuffer) {
+		const char *pos = finalbuffer.data();
+		const char *end = pos + finalbuffer.length();
+
+		// Skip the response line.
+		pos = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+		if (pos == NULL)
+			return false;
+		pos++;
+
+		// Roughly 40 chars per line is a good first guess for subjects.
+		grow((end - pos) / 40, end - pos);
+
+		while (pos < end) {
+			const char *eol = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+			if (eol == NULL)
+				return false;
+
+			// Line without the CRLF.
+			const char *lineend = eol;
+			if (lineend > pos && lineend[-1] == '\r')
+				lineend--;
+
+			// Found the terminator.
+			if (lineend - pos == 1 && pos[0] == '.')
+				return true;
+
+			parseline(pos, lineend);
+			pos = eol + 1;
+		}
+
+		// The terminator was missing.
+		return false;
+	}
+
+	/**
+	 * Parse a HDR/XHDR response held in a chain of blocks, see
+	 * parse above.
+	 *
+	 * @public
+	 *
+	 * @param chain = The response, including the response
+	 * line and the terminating .CRLF
+	 * @return bool = Was the response well formed?
+	 */
+	bool hdrlist::parse(const bufferchain &chain) {
+		unsigned long pos = 0;
+		const char *line;
+		unsigned long length;
+		std::string scratch;
+
+		// Skip the response line.
+		if (!chain.line(pos, line, length, scratch))
+			return false;
+
+		grow((chain.size() - pos) / 40, chain.size() - pos);
+
+		while (chain.line(pos, line, length, scratch)) {
+			// Found the terminator.
+			if (length == 1 && line[0] == '.')
+				return true;
+			parseline(line, line + length);
+		}
+
+		// The terminator was missing.
+		return false;
+	}
+
+	/**
+	 * Remove every pair from the list, keep the memory.
+	 *
+	 * @public
+	 */
+	void hdrlist::clear() {
+		entries.clear();
+		values.clear();
+	}
+
+	/**
+	 * Parse 1 HDR/XHDR line and add it to the list.
+	 *
+	 * @private
+	 *
+	 * @param     pos = Start of the line.
+	 * @param lineend = End of the line, without the CRLF.
+	 */
+	void hdrlist::parseline(const char *pos, const char *lineend) {
+		// Remove the dot stuffing.
+		if (pos < lineend && pos[0] == '.')
+			pos++;
+
+		// The article number, then a space, then the value. XHDR sent
+		// with a message-id gives the message-id instead, stored as 0.
+		unsigned long number = 0;
+		if (pos < lineend && *pos == '<') {
+			const char *close = static_cast<const char *>(std::memchr(pos, '>', lineend - pos));
+			if (close != NULL)
+				pos = close + 1;
+		}
+		while (pos < lineend && *pos >= '0' && *pos <= '9')
+			number = number * 10 + (*pos++ - '0');
+		if (pos < lineend && *pos == ' ')
+			pos++;
+
+		add(number, pos, lineend - pos);
+	}
+
+	/**
+	 * Make room for more pairs, at least doubling so parsing
+	 * many responses into 1 list stays linear.
+	 *
+	 * @private
+	 *
+	 * @param  pairs = Amount of pairs to add.
+	 * @param  chars = Amount of value chars to add.
+	 */
+	void hdrlist::grow(const unsigned long &pairs, const unsigned long &chars) {
+		const unsigned long need = entries.size() + pairs;
+		if (entries.capacity() < need)
+			entries.reserve(std::max<unsigned long>(need, entries.capacity() * 2));
+		values.reserve(values.size() + chars);
+	}
+}
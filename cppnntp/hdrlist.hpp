@@ -0,0 +1,157 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "bufferchain.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * List of (article number, header value) pairs returned by HDR/XHDR.
+	 *
+	 * @note The values are stored back to back in an arena, so fetching
+	 * a header for a million articles costs two allocations that grow,
+	 * not a million small strings.
+	 */
+	class hdrlist
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		hdrlist();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~hdrlist();
+
+		/**
+		 * Add a pair to the list.
+		 *
+		 * @public
+		 *
+		 * @param number = The article number (0 when HDR/XHDR was
+		 * sent with a message-id).
+		 * @param  value = The header value.
+		 * @param length = The length of the header value.
+		 */
+		void add(const unsigned long &number, const char *value,
+				const unsigned long &length);
+
+		/**
+		 * Parse a HDR/XHDR response and add every line to the list.
+		 *
+		 * @public
+		 *
+		 * @param finalbuffer = The response, including the response
+		 * line and the terminating .CRLF
+		 * @return       bool = Was the response well formed?
+		 */
+		bool parse(const std::string &finalbuffer);
+
+		/**
+		 * Parse a HDR/XHDR response held in a chain of blocks, see
+		 * parse above.
+		 *
+		 * @public
+		 *
+		 * @param chain = The response, including the response
+		 * line and the terminating .CRLF
+		 * @return bool = Was the response well formed?
+		 */
+		bool parse(const bufferchain &chain);
+
+		/**
+		 * Amount of pairs in the list.
+		 *
+		 * @public
+		 */
+		unsigned long size() const {
+			return entries.size();
+		}
+
+		/**
+		 * Article number of a pair.
+		 *
+		 * @public
+		 *
+		 * @param index = Position in the list.
+		 * @return The article number.
+		 */
+		unsigned long number(const unsigned long &index) const {
+			return entries[index].number;
+		}
+
+		/**
+		 * Header value of a pair.
+		 *
+		 * @public
+		 *
+		 * @param index = Position in the list.
+		 * @return A view of the value, valid until the list changes.
+		 */
+		field value(const unsigned long &index) const {
+			return values.view(entries[index].offset, entries[index].length);
+		}
+
+		/**
+		 * Remove every pair from the list, keep the memory.
+		 *
+		 * @public
+		 */
+		void clear();
+
+	private:
+		/**
+		 * A pair, the value lives in the arena.
+		 *
+		 * @private
+		 */
+		struct entry
+		{
+			unsigned long number;
+			unsigned long offset;
+			unsigned long length;
+		};
+
+		/**
+		 * The pairs in the order the server sent them.
+		 *
+		 * @private
+		 */
+		std::vector<entry> entries;
+
+		/**
+		 * Storage for the header values.
+		 *
+		 * @private
+		 */
+		arena values;
+
+		/**
+		 * Parse 1 HDR/XHDR line and add it to the list.
+		 *
+		 * @private
+		 *
+		 * @param     pos = Start of the line.
+		 * @param lineend = End of the line, without the CRLF.
+		 */
+		void parseline(const char *pos, const char *lineend);
+
+		/**
+		 * Make room for more pairs, at least doubling so parsing
+		 * many responses into 1 list stays linear.
+		 *
+		 * @private
+		 *
+		 * @param  pairs = Amount of pairs to add.
+		 * @param  chars = Amount of value chars to add.
+		 */
+		void grow(const unsigned long &pairs, const unsigned long &chars);
+	};
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include "memorybudget.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor, nothing reserved.
+	 *
+	 * @public
+	 */
+	memorybudget::reservation::reservation() : budget(NULL), bytes(0) {}
+
+	/**
+	 * Move constructor.
+	 *
+	 * @public
+	 */
+	memorybudget::reservation::reservation(reservation &&other) : budget(other.budget), bytes(other.bytes) {
+		other.budget = NULL;
+		other.bytes = 0;
+	}
+
+	/**
+	 * Move assignment, what this held is given back.
+	 *
+	 * @public
+	 */
+	memorybudget::reservation &memorybudget::reservation::operator=(reservation &&other) {
+		if (this != &other) {
+			release();
+			budget = other.budget;
+			bytes = other.bytes;
+			other.budget = NULL;
+			other.bytes = 0;
+		}
+		return *this;
+	}
+
+	/**
+	 * Destructor, gives the bytes back.
+	 *
+	 * @public
+	 */
+	memorybudget::reservation::~reservation() {
+		release();
+	}
+
+	/**
+	 * Change the amount of bytes held, without waiting.
+	 *
+	 * @note Growing can go over the budget, it is used when a
+	 * buffer turns out bigger than what was reserved for it.
+	 * @public
+	 *
+	 * @param bytes = The new amount.
+	 */
+	void memorybudget::reservation::resize(const unsigned long &bytes) {
+		if (budget == NULL)
+			return;
+		budget->change(this->bytes, bytes);
+		this->bytes = bytes;
+	}
+
+	/**
+	 * Give the bytes back.
+	 *
+	 * @public
+	 */
+	void memorybudget::reservation::release() {
+		if (budget == NULL)
+			return;
+		budget->change(bytes, 0);
+		budget = NULL;
+		bytes = 0;
+	}
+
+	/**
+	 * Amount of bytes held.
+	 *
+	 * @public
+	 */
+	unsigned long memorybudget::reservation::size() const {
+		return bytes;
+	}
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param limit = Most bytes reserved at once.
+	 */
+	memorybudget::memorybudget(const unsigned long &limit) : maximum(limit ? limit : 1) {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	memorybudget::~memorybudget() {}
+
+	/**
+	 * Reserve bytes, wait until there is room.
+	 *
+	 * @public
+	 *
+	 * @param bytes = Amount of bytes.
+	 * @return The reservation.
+	 */
+	memorybudget::reservation memorybudget::reserve(const unsigned long &bytes) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (reserved > 0 && reserved + bytes > maximum) {
+			waits++;
+			room.wait(guard, [this, &bytes]() { return reserved == 0 || reserved + bytes <= maximum; });
+		}
+		reserved += bytes;
+		highest = std::max(highest, reserved);
+
+		reservation r;
+		r.budget = this;
+		r.bytes = bytes;
+		return r;
+	}
+
+	/**
+	 * Reserve bytes if there is room now.
+	 *
+	 * @public
+	 *
+	 * @param bytes = Amount of bytes.
+	 * @param  held = Where the reservation is stored.
+	 * @return bool = Was there room?
+	 */
+	bool memorybudget::tryreserve(const unsigned long &bytes, reservation &held) {
+		held.release();
+		std::lock_guard<std::mutex> guard(lock);
+		if (reserved > 0 && reserved + bytes > maximum)
+			return false;
+		reserved += bytes;
+		highest = std::max(highest, reserved);
+		held.budget = this;
+		held.bytes = bytes;
+		return true;
+	}
+
+	/**
+	 * Most bytes reserved at once.
+	 *
+	 * @public
+	 */
+	unsigned long memorybudget::limit() const {
+		return maximum;
+	}
+
+	/**
+	 * Bytes reserved now.
+	 *
+	 * @public
+	 */
+	unsigned long memorybudget::used() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return reserved;
+	}
+
+	/**
+	 * Most bytes that were reserved at once.
+	 *
+	 * @public
+	 */
+	unsigned long memorybudget::peak() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return highest;
+	}
+
+	/**
+	 * Amount of times reserve had to wait for room.
+	 *
+	 * @public
+	 */
+	unsigned long memorybudget::stalls() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return waits;
+	}
+
+	/**
+	 * Change the bytes reserved by a reservation.
+	 *
+	 * @private
+	 *
+	 * @param  from = Bytes it held.
+	 * @param    to = Bytes it holds now.
+	 */
+	void memorybudget::change(const unsigned long &from, const unsigned long &to) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			reserved = reserved - from + to;
+			highest = std::max(highest, reserved);
+		}
+		if (to < from)
+			room.notify_all();
+	}
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+
+namespace cppnntp
+{
+	/**
+	 * A global limit on the bytes held by the download pipeline
+	 * (articles in flight, decoded segments, the writer queue).
+	 *
+	 * @note Every stage holds a reservation for its buffers, passed
+	 * on with them, so 1 reservation follows a segment from the BODY
+	 * command to the disk. reserve waits while the budget is spent,
+	 * which pauses the connections until the writers catch up.
+	 * A reservation bigger than the whole budget is let through when
+	 * nothing else is reserved.
+	 * Thread safe.
+	 */
+	class memorybudget
+	{
+	public:
+		/**
+		 * Bytes reserved from a budget, given back when destroyed.
+		 *
+		 * @note Can be moved, not copied.
+		 */
+		class reservation
+		{
+		public:
+			/**
+			 * Constructor, nothing reserved.
+			 *
+			 * @public
+			 */
+			reservation();
+
+			/**
+			 * Move constructor.
+			 *
+			 * @public
+			 */
+			reservation(reservation &&other);
+
+			/**
+			 * Move assignment, what this held is given back.
+			 *
+			 * @public
+			 */
+			reservation &operator=(reservation &&other);
+
+			/**
+			 * Destructor, gives the bytes back.
+			 *
+			 * @public
+			 */
+			~reservation();
+
+			/**
+			 * Change the amount of bytes held, without waiting.
+			 *
+			 * @note Growing can go over the budget, it is used when a
+			 * buffer turns out bigger than what was reserved for it.
+			 * @public
+			 *
+			 * @param bytes = The new amount.
+			 */
+			void resize(const unsigned long &bytes);
+
+			/**
+			 * Give the bytes back.
+			 *
+			 * @public
+			 */
+			void release();
+
+			/**
+			 * Amount of bytes held.
+			 *
+			 * @public
+			 */
+			unsigned long size() const;
+
+		private:
+			friend class memorybudget;
+
+			reservation(const reservation &);
+			reservation &operator=(const reservation &);
+
+			/**
+			 * The budget, NULL when nothing is held.
+			 *
+			 * @private
+			 */
+			memorybudget *budget;
+
+			/**
+			 * Bytes held.
+			 *
+			 * @private
+			 */
+			unsigned long bytes;
+		};
+
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param limit = Most bytes reserved at once.
+		 */
+		memorybudget(const unsigned long &limit = 268435456);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~memorybudget();
+
+		/**
+		 * Reserve bytes, wait until there is room.
+		 *
+		 * @public
+		 *
+		 * @param bytes = Amount of bytes.
+		 * @return The reservation.
+		 */
+		reservation reserve(const unsigned long &bytes);
+
+		/**
+		 * Reserve bytes if there is room now.
+		 *
+		 * @public
+		 *
+		 * @param bytes = Amount of bytes.
+		 * @param  held = Where the reservation is stored.
+		 * @return bool = Was there room?
+		 */
+		bool tryreserve(const unsigned long &bytes, reservation &held);
+
+		/**
+		 * Most bytes reserved at once.
+		 *
+		 * @public
+		 */
+		unsigned long limit() const;
+
+		/**
+		 * Bytes reserved now.
+		 *
+		 * @public
+		 */
+		unsigned long used() const;
+
+		/**
+		 * Most bytes that were reserved at once.
+		 *
+		 * @public
+		 */
+		unsigned long peak() const;
+
+		/**
+		 * Amount of times reserve had to wait for room.
+		 *
+		 * @public
+		 */
+		unsigned long stalls() const;
+
+	private:
+		/**
+		 * Most bytes reserved at once.
+		 *
+		 * @private
+		 */
+		unsigned long maximum;
+
+		/**
+		 * Bytes reserved now, the most ever reserved.
+		 *
+		 * @private
+		 */
+		unsigned long reserved = 0;
+		unsigned long highest = 0;
+
+		/**
+		 * Times reserve waited.
+		 *
+		 * @private
+		 */
+		unsigned long waits = 0;
+
+		/**
+		 * Protects the counters, room wakes reserve.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+		std::condition_variable room;
+
+		/**
+		 * Change the bytes reserved by a reservation.
+		 *
+		 * @private
+		 *
+		 * @param  from = Bytes it held.
+		 * @param    to = Bytes it holds now.
+		 */
+		void change(const unsigned long &from, const unsigned long &to);
+	};
+}
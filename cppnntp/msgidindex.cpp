@@ -0,0 +1,364 @@
+#include <cstdio>
+#include <fstream>
+#include "msgidindex.hpp"
+#include "overviewdb.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param capacity = Amount of articles to make room for.
+	 */
+	msgidindex::msgidindex(const unsigned long &capacity) {
+		// Keep the table at most 70% full.
+		unsigned long size = 16;
+		while (size * 7 / 10 < capacity)
+			size *= 2;
+		slot empty = {0, 0, 0, 0};
+		slots.assign(size, empty);
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	msgidindex::~msgidindex() {}
+
+	/**
+	 * 64 bit hash of a message-id (FNV-1a).
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id, with the < and >.
+	 * @return The hash, never 0.
+	 */
+	uint64_t msgidindex::hash(const field &messageid) {
+		uint64_t h = 14695981039346656037ULL;
+		for (unsigned long i = 0; i < messageid.length; i++) {
+			h ^= static_cast<unsigned char>(messageid.data[i]);
+			h *= 1099511628211ULL;
+		}
+		// 0 marks an empty slot.
+		return h ? h : 1;
+	}
+
+	/**
+	 * 64 bit hash of a message-id (FNV-1a).
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id, with the < and >.
+	 * @return The hash, never 0.
+	 */
+	uint64_t msgidindex::hash(const std::string &messageid) {
+		field f = { messageid.data(), messageid.length() };
+		return hash(f);
+	}
+
+	/**
+	 * Get the id of a group, adding it if it is new.
+	 *
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @return The id.
+	 */
+	unsigned int msgidindex::groupid(const std::string &groupname) {
+		std::map<std::string, unsigned int>::const_iterator it = groupids.find(groupname);
+		if (it != groupids.end())
+			return it->second;
+
+		groups.push_back(groupname);
+		groupids[groupname] = groups.size() - 1;
+		return groups.size() - 1;
+	}
+
+	/**
+	 * Get the name of a group id.
+	 *
+	 * @public
+	 *
+	 * @param id = The id from groupid.
+	 * @return The name.
+	 */
+	const std::string &msgidindex::groupname(const unsigned int &id) const {
+		return groups.at(id);
+	}
+
+	/**
+	 * Add an article.
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id of the article.
+	 * @param  location = Where it is stored.
+	 * @return     bool = Was it added? (False if the message-id
+	 * was already in the index.)
+	 */
+	bool msgidindex::insert(const field &messageid, const msgidlocation &location) {
+		if ((used + 1) * 10 > slots.size() * 7)
+			grow();
+
+		const uint64_t h = hash(messageid);
+		slot &s = slots[probe(h)];
+		if (s.hash == h)
+			return false;
+
+		s.hash = h;
+		s.group = location.group;
+		s.number = location.number;
+		s.row = location.row;
+		used++;
+		return true;
+	}
+
+	/**
+	 * Remove an article.
+	 *
+	 * @note The slots after it are shifted back, no tombstone is
+	 * left, so removed articles free their slot for good.
+	 * @public
+	 *
+	 * @param messageid = The message-id of the article.
+	 * @return     bool = Was it in the index?
+	 */
+	bool msgidindex::erase(const field &messageid) {
+		const uint64_t h = hash(messageid);
+		unsigned long hole = probe(h);
+		if (slots[hole].hash != h)
+			return false;
+
+		// Move back every slot of the run that probing would no
+		// longer reach past the hole.
+		const unsigned long mask = slots.size() - 1;
+		unsigned long pos = (hole + 1) & mask;
+		while (slots[pos].hash != 0) {
+			const unsigned long home = slots[pos].hash & mask;
+			if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+				slots[hole] = slots[pos];
+				hole = pos;
+			}
+			pos = (pos + 1) & mask;
+		}
+		slot empty = {0, 0, 0, 0};
+		slots[hole] = empty;
+		used--;
+		return true;
+	}
+
+	/**
+	 * Look up an article.
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id of the article.
+	 * @param  location = Where the location is stored.
+	 * @return     bool = Was it found?
+	 */
+	bool msgidindex::find(const field &messageid, msgidlocation &location) const {
+		const uint64_t h = hash(messageid);
+		const slot &s = slots[probe(h)];
+		if (s.hash != h)
+			return false;
+
+		location.group = s.group;
+		location.number = s.number;
+		location.row = s.row;
+		return true;
+	}
+
+	/**
+	 * Look up an article.
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id of the article.
+	 * @param  location = Where the location is stored.
+	 * @return     bool = Was it found?
+	 */
+	bool msgidindex::find(const std::string &messageid, msgidlocation &location) const {
+		field f = { messageid.data(), messageid.length() };
+		return find(f, location);
+	}
+
+	/**
+	 * Is an article in the index?
+	 *
+	 * @public
+	 *
+	 * @param messageid = The message-id of the article.
+	 * @return     bool = Is it?
+	 */
+	bool msgidindex::contains(const field &messageid) const {
+		const uint64_t h = hash(messageid);
+		return slots[probe(h)].hash == h;
+	}
+
+	/**
+	 * Add every row of an overview database that is not
+	 * in the index yet.
+	 *
+	 * @note Used to catch up after rows were stored without
+	 * the index (or the index file was lost).
+	 * @public
+	 *
+	 * @param db = The database.
+	 * @return The amount of rows added.
+	 */
+	unsigned long msgidindex::build(overviewdb &db) {
+		msgidlocation location;
+		location.group = groupid(db.group());
+
+		unsigned long added = 0;
+		for (unsigned long i = db.begin(); i < db.size(); i++) {
+			overviewrow row = db.row(i);
+			location.number = row.number;
+			location.row = i;
+			if (insert(row.messageid, location))
+				added++;
+		}
+		return added;
+	}
+
+	/**
+	 * Amount of articles in the index.
+	 *
+	 * @public
+	 */
+	unsigned long msgidindex::size() const {
+		return used;
+	}
+
+	/**
+	 * Write the index to a file.
+	 *
+	 * @note Written to a temporary file first, then renamed.
+	 * @public
+	 *
+	 * @param path = Path/file to write.
+	 * @return bool = Did it work?
+	 */
+	bool msgidindex::save(const std::string &path) const {
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return false;
+
+			// The group names, 1 per line, then the used slots.
+			file << "cppnntp-msgidindex 1\n" << groups.size() << '\n';
+			for (unsigned long i = 0; i < groups.size(); i++)
+				file << groups[i] << '\n';
+			file << used << '\n';
+			for (unsigned long i = 0; i < slots.size(); i++) {
+				if (slots[i].hash != 0)
+					file.write(reinterpret_cast<const char *>(&slots[i]), sizeof(slot));
+			}
+			file.flush();
+			if (!file.good())
+				return false;
+		}
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+
+	/**
+	 * Replace the index with the contents of a file.
+	 *
+	 * @note Entries with a group id out of range or a hash seen
+	 * before are skipped. The counts in the file are not trusted,
+	 * memory only grows with what is actually read.
+	 * @public
+	 *
+	 * @param path = Path/file to read.
+	 * @return bool = Did it work?
+	 */
+	bool msgidindex::load(const std::string &path) {
+		std::ifstream file(path.c_str(), std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		std::string magic;
+		unsigned long count = 0;
+		std::getline(file, magic);
+		if (magic != "cppnntp-msgidindex 1" || !(file >> count))
+			return false;
+		file.ignore(1);
+
+		// Grown as read, a damaged count can not make us allocate.
+		std::vector<std::string> names;
+		std::string name;
+		for (unsigned long i = 0; i < count; i++) {
+			if (!std::getline(file, name))
+				return false;
+			names.push_back(name);
+		}
+
+		unsigned long entries = 0;
+		if (!(file >> entries))
+			return false;
+		file.ignore(1);
+
+		// Start over with an empty table, grown like insert does.
+		msgidindex loaded;
+		loaded.groups = names;
+		for (unsigned long i = 0; i < names.size(); i++)
+			loaded.groupids[names[i]] = i;
+
+		slot s;
+		for (unsigned long i = 0; i < entries; i++) {
+			if (!file.read(reinterpret_cast<char *>(&s), sizeof(slot)))
+				return false;
+			// Skip what a damaged file could hold: empty or repeated
+			// hashes, and groups that are not in the list.
+			if (s.hash == 0 || s.group >= names.size())
+				continue;
+			if ((loaded.used + 1) * 10 > loaded.slots.size() * 7)
+				loaded.grow();
+			slot &target = loaded.slots[loaded.probe(s.hash)];
+			if (target.hash == s.hash)
+				continue;
+			target = s;
+			loaded.used++;
+		}
+
+		slots.swap(loaded.slots);
+		groups.swap(loaded.groups);
+		groupids.swap(loaded.groupids);
+		used = loaded.used;
+		return true;
+	}
+
+	/**
+	 * Find the slot of a hash, or the empty slot it would go in.
+	 *
+	 * @private
+	 *
+	 * @param hash = The hash.
+	 * @return Position of the slot.
+	 */
+	unsigned long msgidindex::probe(const uint64_t &hash) const {
+		const unsigned long mask = slots.size() - 1;
+		unsigned long pos = hash & mask;
+		while (slots[pos].hash != 0 && slots[pos].hash != hash)
+			pos = (pos + 1) & mask;
+		return pos;
+	}
+
+	/**
+	 * Double the size of the table.
+	 *
+	 * @private
+	 */
+	void msgidindex::grow() {
+		std::vector<slot> old;
+		old.swap(slots);
+		slot empty = {0, 0, 0, 0};
+		slots.assign(old.size() * 2, empty);
+		for (unsigned long i = 0; i < old.size(); i++) {
+			if (old[i].hash != 0)
+				slots[probe(old[i].hash)] = old[i];
+		}
+	}
+}
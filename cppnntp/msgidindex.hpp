@@ -0,0 +1,261 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "arena.hpp"
+
+namespace cppnntp
+{
+	class overviewdb;
+
+	/**
+	 * Where an article is stored.
+	 */
+	struct msgidlocation
+	{
+		/**
+		 * Id of the group, see msgidindex::groupid.
+		 */
+		unsigned int group;
+
+		/**
+		 * Article number in that group.
+		 */
+		unsigned long number;
+
+		/**
+		 * Position of the row in the group's overview database.
+		 */
+		unsigned long row;
+	};
+
+	/**
+	 * Hash index from message-id to the stored overview row.
+	 *
+	 * @note Open addressing with linear probing over a flat array,
+	 * only the 64 bit hash of the message-id is kept, not the
+	 * message-id itself. The first group an article is stored in
+	 * wins, crossposts found later in other groups are duplicates.
+	 * Articles are removed when overviewdb expires their segment.
+	 * Not thread safe.
+	 */
+	class msgidindex
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param capacity = Amount of articles to make room for.
+		 */
+		msgidindex(const unsigned long &capacity = 65536);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~msgidindex();
+
+		/**
+		 * 64 bit hash of a message-id (FNV-1a).
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id, with the < and >.
+		 * @return The hash, never 0.
+		 */
+		static uint64_t hash(const field &messageid);
+
+		/**
+		 * 64 bit hash of a message-id (FNV-1a).
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id, with the < and >.
+		 * @return The hash, never 0.
+		 */
+		static uint64_t hash(const std::string &messageid);
+
+		/**
+		 * Get the id of a group, adding it if it is new.
+		 *
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @return The id.
+		 */
+		unsigned int groupid(const std::string &groupname);
+
+		/**
+		 * Get the name of a group id.
+		 *
+		 * @public
+		 *
+		 * @param id = The id from groupid.
+		 * @return The name.
+		 */
+		const std::string &groupname(const unsigned int &id) const;
+
+		/**
+		 * Add an article.
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id of the article.
+		 * @param  location = Where it is stored.
+		 * @return     bool = Was it added? (False if the message-id
+		 * was already in the index.)
+		 */
+		bool insert(const field &messageid, const msgidlocation &location);
+
+		/**
+		 * Remove an article.
+		 *
+		 * @note The slots after it are shifted back, no tombstone is
+		 * left, so removed articles free their slot for good.
+		 * @public
+		 *
+		 * @param messageid = The message-id of the article.
+		 * @return     bool = Was it in the index?
+		 */
+		bool erase(const field &messageid);
+
+		/**
+		 * Look up an article.
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id of the article.
+		 * @param  location = Where the location is stored.
+		 * @return     bool = Was it found?
+		 */
+		bool find(const field &messageid, msgidlocation &location) const;
+
+		/**
+		 * Look up an article.
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id of the article.
+		 * @param  location = Where the location is stored.
+		 * @return     bool = Was it found?
+		 */
+		bool find(const std::string &messageid, msgidlocation &location) const;
+
+		/**
+		 * Is an article in the index?
+		 *
+		 * @public
+		 *
+		 * @param messageid = The message-id of the article.
+		 * @return     bool = Is it?
+		 */
+		bool contains(const field &messageid) const;
+
+		/**
+		 * Add every row of an overview database that is not
+		 * in the index yet.
+		 *
+		 * @note Used to catch up after rows were stored without
+		 * the index (or the index file was lost).
+		 * @public
+		 *
+		 * @param db = The database.
+		 * @return The amount of rows added.
+		 */
+		unsigned long build(overviewdb &db);
+
+		/**
+		 * Amount of articles in the index.
+		 *
+		 * @public
+		 */
+		unsigned long size() const;
+
+		/**
+		 * Write the index to a file.
+		 *
+		 * @note Written to a temporary file first, then renamed.
+		 * @public
+		 *
+		 * @param path = Path/file to write.
+		 * @return bool = Did it work?
+		 */
+		bool save(const std::string &path) const;
+
+		/**
+		 * Replace the index with the contents of a file.
+		 *
+		 * @note Entries with a group id out of range or a hash seen
+		 * before are skipped. The counts in the file are not trusted,
+		 * memory only grows with what is actually read.
+		 * @public
+		 *
+		 * @param path = Path/file to read.
+		 * @return bool = Did it work?
+		 */
+		bool load(const std::string &path);
+
+	private:
+		/**
+		 * A slot of the table, hash 0 means empty.
+		 *
+		 * @private
+		 */
+		struct slot
+		{
+			uint64_t hash;
+			uint32_t group;
+			uint64_t number;
+			uint64_t row;
+		};
+
+		/**
+		 * The table, the size is always a power of 2.
+		 *
+		 * @private
+		 */
+		std::vector<slot> slots;
+
+		/**
+		 * Amount of used slots.
+		 *
+		 * @private
+		 */
+		unsigned long used = 0;
+
+		/**
+		 * Group names by id.
+		 *
+		 * @private
+		 */
+		std::vector<std::string> groups;
+
+		/**
+		 * Group ids by name.
+		 *
+		 * @private
+		 */
+		std::map<std::string, unsigned int> groupids;
+
+		/**
+		 * Find the slot of a hash, or the empty slot it would go in.
+		 *
+		 * @private
+		 *
+		 * @param hash = The hash.
+		 * @return Position of the slot.
+		 */
+		unsigned long probe(const uint64_t &hash) const;
+
+		/**
+		 * Double the size of the table.
+		 *
+		 * @private
+		 */
+		void grow();
+	};
+}
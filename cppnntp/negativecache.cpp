@@ -0,0 +1,247 @@
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include "negativecache.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param      ttl = Seconds an entry is kept.
+	 * @param capacity = Amount of entries to make room for.
+	 */
+	negativecache::negativecache(const unsigned long &ttl, const unsigned long &capacity) : ttl(ttl) {
+		rebuild(capacity);
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	negativecache::~negativecache() {}
+
+	/**
+	 * Get the id of a server, adding it if it is new.
+	 *
+	 * @public
+	 *
+	 * @param name = The name of the server (the hostname).
+	 * @return The id.
+	 */
+	unsigned short negativecache::serverid(const std::string &name) {
+		std::lock_guard<std::mutex> guard(lock);
+		std::map<std::string, unsigned short>::const_iterator it = serverids.find(name);
+		if (it != serverids.end())
+			return it->second;
+
+		servers.push_back(name);
+		serverids[name] = servers.size() - 1;
+		return servers.size() - 1;
+	}
+
+	/**
+	 * A server does not have an article.
+	 *
+	 * @public
+	 *
+	 * @param   hash = Hash of the message-id.
+	 * @param server = Id of the server.
+	 */
+	void negativecache::add(const uint64_t &hash, const unsigned short &server) {
+		std::lock_guard<std::mutex> guard(lock);
+		// Keep the table at most 70% full, the expired entries are
+		// dropped when it grows.
+		if ((used + 1) * 10 > slots.size() * 7)
+			rebuild(used * 2 + 1);
+
+		const unsigned long pos = probe(hash, server);
+		if (slots[pos].hash == 0)
+			used++;
+		slots[pos].hash = hash;
+		slots[pos].server = server;
+		slots[pos].expiry = static_cast<uint32_t>(std::time(NULL) + ttl);
+	}
+
+	/**
+	 * Is a server known not to have an article?
+	 *
+	 * @public
+	 *
+	 * @param   hash = Hash of the message-id.
+	 * @param server = Id of the server.
+	 * @return  bool = Is it, and did the entry not expire?
+	 */
+	bool negativecache::missing(const uint64_t &hash, const unsigned short &server) const {
+		std::lock_guard<std::mutex> guard(lock);
+		const slot &s = slots[probe(hash, server)];
+		return s.hash != 0 && s.expiry > std::time(NULL);
+	}
+
+	/**
+	 * Drop the expired entries.
+	 *
+	 * @public
+	 *
+	 * @return The amount dropped.
+	 */
+	unsigned long negativecache::expire() {
+		std::lock_guard<std::mutex> guard(lock);
+		const unsigned long before = used;
+		rebuild(used);
+		return before - used;
+	}
+
+	/**
+	 * Amount of entries, expired ones included.
+	 *
+	 * @public
+	 */
+	unsigned long negativecache::size() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return used;
+	}
+
+	/**
+	 * Write the cache to a file, without the expired entries.
+	 *
+	 * @note Written to a temporary file first, then renamed.
+	 * @public
+	 *
+	 * @param path = Path/file to write.
+	 * @return bool = Did it work?
+	 */
+	bool negativecache::save(const std::string &path) const {
+		std::lock_guard<std::mutex> guard(lock);
+		const uint32_t now = static_cast<uint32_t>(std::time(NULL));
+		unsigned long live = 0;
+		for (unsigned long i = 0; i < slots.size(); i++) {
+			if (slots[i].hash != 0 && slots[i].expiry > now)
+				live++;
+		}
+
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return false;
+
+			// The server names, 1 per line, then the live slots.
+			file << "cppnntp-negativecache 1\n" << servers.size() << '\n';
+			for (unsigned long i = 0; i < servers.size(); i++)
+				file << servers[i] << '\n';
+			file << live << '\n';
+			for (unsigned long i = 0; i < slots.size(); i++) {
+				if (slots[i].hash != 0 && slots[i].expiry > now)
+					file.write(reinterpret_cast<const char *>(&slots[i]), sizeof(slot));
+			}
+			file.flush();
+			if (!file.good())
+				return false;
+		}
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+
+	/**
+	 * Replace the cache with the contents of a file.
+	 *
+	 * @public
+	 *
+	 * @param path = Path/file to read.
+	 * @return bool = Did it work?
+	 */
+	bool negativecache::load(const std::string &path) {
+		std::ifstream file(path.c_str(), std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		std::string magic;
+		unsigned long count = 0;
+		std::getline(file, magic);
+		if (magic != "cppnntp-negativecache 1" || !(file >> count) || count > 65536)
+			return false;
+		file.ignore(1);
+
+		std::vector<std::string> names(count);
+		for (unsigned long i = 0; i < count; i++)
+			std::getline(file, names[i]);
+
+		unsigned long entries = 0;
+		if (!(file >> entries))
+			return false;
+		file.ignore(1);
+
+		// Grown as read, a damaged count can not make us allocate.
+		std::vector<slot> read;
+		slot s;
+		for (unsigned long i = 0; i < entries; i++) {
+			if (!file.read(reinterpret_cast<char *>(&s), sizeof(slot)) || s.hash == 0 || s.server >= count)
+				return false;
+			read.push_back(s);
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		servers = names;
+		serverids.clear();
+		for (unsigned long i = 0; i < names.size(); i++)
+			serverids[names[i]] = i;
+		slots.clear();
+		used = 0;
+		rebuild(read.size());
+		for (unsigned long i = 0; i < read.size(); i++) {
+			const unsigned long pos = probe(read[i].hash, read[i].server);
+			if (slots[pos].hash == 0)
+				used++;
+			slots[pos] = read[i];
+		}
+		return true;
+	}
+
+	/**
+	 * Find the slot of a hash and server, or the empty slot
+	 * it would go in.
+	 *
+	 * @private
+	 *
+	 * @param   hash = The hash.
+	 * @param server = The server.
+	 * @return Position of the slot.
+	 */
+	unsigned long negativecache::probe(const uint64_t &hash, const unsigned short &server) const {
+		const unsigned long mask = slots.size() - 1;
+		// Spread the servers of 1 article over the table.
+		unsigned long pos = (hash ^ (server * 0x9E3779B97F4A7C15ULL)) & mask;
+		while (slots[pos].hash != 0 && (slots[pos].hash != hash || slots[pos].server != server))
+			pos = (pos + 1) & mask;
+		return pos;
+	}
+
+	/**
+	 * Rebuild the table with room for an amount of entries,
+	 * dropping the expired ones.
+	 *
+	 * @private
+	 *
+	 * @param capacity = Amount of entries to make room for.
+	 */
+	void negativecache::rebuild(const unsigned long &capacity) {
+		const uint32_t now = static_cast<uint32_t>(std::time(NULL));
+		std::vector<slot> old;
+		old.swap(slots);
+
+		// Keep the table at most 70% full.
+		unsigned long size = 16;
+		while (size * 7 / 10 < capacity)
+			size *= 2;
+		slot empty = {0, 0, 0, 0};
+		slots.assign(size, empty);
+		used = 0;
+		for (unsigned long i = 0; i < old.size(); i++) {
+			if (old[i].hash != 0 && old[i].expiry > now) {
+				slots[probe(old[i].hash, old[i].server)] = old[i];
+				used++;
+			}
+		}
+	}
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cppnntp
+{
+	/**
+	 * Remembers which servers do not have an article (430), so they
+	 * are not asked again until the entry expires.
+	 *
+	 * @note Open addressing with linear probing over a flat array of
+	 * 16 byte slots, 1 slot per message-id hash (see msgidindex::hash)
+	 * and server. Servers are stored by name so a saved cache stays
+	 * valid when the server list changes.
+	 * Thread safe.
+	 */
+	class negativecache
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param      ttl = Seconds an entry is kept.
+		 * @param capacity = Amount of entries to make room for.
+		 */
+		negativecache(const unsigned long &ttl = 604800, const unsigned long &capacity = 65536);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~negativecache();
+
+		/**
+		 * Get the id of a server, adding it if it is new.
+		 *
+		 * @public
+		 *
+		 * @param name = The name of the server (the hostname).
+		 * @return The id.
+		 */
+		unsigned short serverid(const std::string &name);
+
+		/**
+		 * A server does not have an article.
+		 *
+		 * @public
+		 *
+		 * @param   hash = Hash of the message-id.
+		 * @param server = Id of the server.
+		 */
+		void add(const uint64_t &hash, const unsigned short &server);
+
+		/**
+		 * Is a server known not to have an article?
+		 *
+		 * @public
+		 *
+		 * @param   hash = Hash of the message-id.
+		 * @param server = Id of the server.
+		 * @return  bool = Is it, and did the entry not expire?
+		 */
+		bool missing(const uint64_t &hash, const unsigned short &server) const;
+
+		/**
+		 * Drop the expired entries.
+		 *
+		 * @public
+		 *
+		 * @return The amount dropped.
+		 */
+		unsigned long expire();
+
+		/**
+		 * Amount of entries, expired ones included.
+		 *
+		 * @public
+		 */
+		unsigned long size() const;
+
+		/**
+		 * Write the cache to a file, without the expired entries.
+		 *
+		 * @note Written to a temporary file first, then renamed.
+		 * @public
+		 *
+		 * @param path = Path/file to write.
+		 * @return bool = Did it work?
+		 */
+		bool save(const std::string &path) const;
+
+		/**
+		 * Replace the cache with the contents of a file.
+		 *
+		 * @public
+		 *
+		 * @param path = Path/file to read.
+		 * @return bool = Did it work?
+		 */
+		bool load(const std::string &path);
+
+	private:
+		/**
+		 * A slot of the table, hash 0 means empty.
+		 *
+		 * @private
+		 */
+		struct slot
+		{
+			uint64_t hash;
+
+			/**
+			 * Unix time the entry expires.
+			 */
+			uint32_t expiry;
+			uint16_t server;
+			uint16_t padding;
+		};
+
+		/**
+		 * Seconds an entry is kept.
+		 *
+		 * @private
+		 */
+		unsigned long ttl;
+
+		/**
+		 * The table, the size is always a power of 2.
+		 *
+		 * @private
+		 */
+		std::vector<slot> slots;
+
+		/**
+		 * Amount of used slots.
+		 *
+		 * @private
+		 */
+		unsigned long used = 0;
+
+		/**
+		 * Server names, the position is the id, and the reverse.
+		 *
+		 * @private
+		 */
+		std::vector<std::string> servers;
+		std::map<std::string, unsigned short> serverids;
+
+		/**
+		 * Protects everything.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+
+		/**
+		 * Find the slot of a hash and server, or the empty slot
+		 * it would go in.
+		 *
+		 * @private
+		 *
+		 * @param   hash = The hash.
+		 * @param server = The server.
+		 * @return Position of the slot.
+		 */
+		unsigned long probe(const uint64_t &hash, const unsigned short &server) const;
+
+		/**
+		 * Rebuild the table with room for an amount of entries,
+		 * dropping the expired ones.
+		 *
+		 * @private
+		 *
+		 * @param capacity = Amount of entries to make room for.
+		 */
+		void rebuild(const unsigned long &capacity);
+	};
+}
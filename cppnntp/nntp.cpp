@@ -34,6 +34,7 @@ namespace cppnntp {
 	bool nntp::clioutput(const bool &output) {
 		echocli = output;
 		sock.clioutput(output);
+		return echocli;
 	}
 
 	/**
@@ -77,11 +78,24 @@ namespace cppnntp {
 		}
 		// Set groupselected back to false.
 		groupselected = false;
+		// The next server might support HDR.
+		hdrsupported = true;
 		// Set compression flag in socket to false.
 		sock.togglecompression(false);
 		sock.close();
 	}
 
+	/**
+	 * Are we connected to usenet?
+	 *
+	 * @public
+	 *
+	 * @return bool = Are we?
+	 */
+	bool nntp::is_connected() {
+		return sock.is_connected();
+	}
+
 	/**
 	 * Authenticate to usenet.
 	 *
@@ -660,12 +674,20 @@ namespace cppnntp {
 			return false;
 		}
 
-		if (!sock.send_command("BODY " + anumber))
-			return false;
+		// Bodies asked for by message-id can come from the cache.
+		const bool cacheable = cache != NULL && !anumber.empty() && anumber[0] == '<';
+		std::string &finalbuffer = bodybuffer;
+		finalbuffer.clear();
+		if (!cacheable || !cache->get(anumber, finalbuffer)) {
+			if (!sock.send_command("BODY " + anumber))
+				return false;
 
-		std::string finalbuffer = "";
-		if (!sock.read_lines(RESPONSECODE_BODY_FOLLOWS, finalbuffer))
-			return false;
+			if (!sock.read_lines(RESPONSECODE_BODY_FOLLOWS, finalbuffer))
+				return false;
+
+			if (cacheable)
+				cache->put(anumber, finalbuffer);
+		}
 
 		yencdecode yd;
 		if (!yd.decodeyencstring(finalbuffer, data))
@@ -684,6 +706,77 @@ namespace cppnntp {
 		return true;
 	}
 
+	/**
+	 * Send the BODY command for several message-ids at once,
+	 * without waiting for the responses (pipelining).
+	 *
+	 * @note Read each response, in order, with readbody.
+	 * @public
+	 *
+	 * @param messageids = The message-ids, with the < and >.
+	 * @return      bool = Were the commands sent?
+	 */
+	bool nntp::sendbodies(const std::vector<std::string> &messageids) {
+		std::string commands;
+		commands.reserve(messageids.size() * 64);
+		for (unsigned long i = 0; i < messageids.size(); i++) {
+			commands += "BODY ";
+			commands += messageids[i];
+			commands += "\r\n";
+		}
+		return sock.send_commands(commands);
+	}
+
+	/**
+	 * Read the response to the oldest BODY command sent by
+	 * sendbodies.
+	 *
+	 * @public
+	 *
+	 * @param data = Where the raw response is stored (status line,
+	 * then the still encoded body up to and including the .\r\n).
+	 * @param code = Where the response code is stored
+	 * (example: 430 when the article is missing).
+	 * @return bool = Did we receive the body?
+	 */
+	bool nntp::readbody(std::string &data, unsigned short &code) {
+		return sock.read_response(RESPONSECODE_BODY_FOLLOWS, data, code);
+	}
+
+	/**
+	 * When the first byte of the last response read by readbody
+	 * arrived, used to measure the time to first byte.
+	 *
+	 * @public
+	 */
+	std::chrono::steady_clock::time_point nntp::firstbyte() const {
+		return sock.firstbyte();
+	}
+
+	/**
+	 * Set the bandwidth limits applied to every read.
+	 *
+	 * @public
+	 *
+	 * @param global = Limit shared by every server, NULL for none.
+	 * @param server = Limit of this server, NULL for none.
+	 */
+	void nntp::setlimiters(ratelimiter *global, ratelimiter *server) {
+		sock.setlimiters(global, server);
+	}
+
+	/**
+	 * Set a cache consulted by body before going to usenet,
+	 * for bodies asked for by message-id.
+	 *
+	 * @public
+	 *
+	 * @param cache = The cache, NULL for none.
+	 */
+	void nntp::setcache(articlecache *cache) {
+		this->cache = cache;
+	}
+
 	/**
 	 * Send the HEAD command for 1 article number or message-id.
 	 *
@@ -775,6 +868,37 @@ namespace cppnntp {
 		return true;
 	}
 
+	/**
+	 * Send the XOVER command for a range of article numbers and
+	 * store the headers.
+	 *
+	 * @note Same as the range version above, but the headers are
+	 * parsed into rows instead of being displayed. A range without
+	 * articles is not an error, no rows are added.
+	 * @public
+	 *
+	 * @param  start = The oldest wanted article.
+	 * @param    end = The newest wanted article.
+	 * @param   rows = Where the parsed headers are added.
+	 * @return  bool = Did we receive the headers?
+	 */
+	bool nntp::xover(const std::string &start, const std::string &end,
+					overview &rows) {
+		if (!groupselected) {
+			throw NNTPException("No group selected.");
+			return false;
+		}
+
+		if (!sock.send_command("XOVER " + start + '-' + end))
+			return false;
+
+		if (!sock.read_lines(RESPONSECODE_OVERVIEW_FOLLOWS, responsechain, true))
+			// No articles in that range.
+			return startswith(responsechain, "423");
+
+		return rows.parse(responsechain);
+	}
+
 	/**
 	 * Send the XOVER command for an article number
 	 * (and all above or below).
@@ -821,6 +945,59 @@ namespace cppnntp {
 		return true;
 	}
 
+	/**
+	 * Send the HDR command for a range of article numbers.
+	 *
+	 * @note This passes the HDR command (RFC3977) for a single
+	 * header over multiple article numbers, falling back to XHDR
+	 * (RFC2980) if the server does not know HDR. The results are
+	 * stored in values instead of being displayed, use this
+	 * instead of XOVER when only 1 header is needed.
+	 * @public
+	 * @example       hdr("Subject", "1000", "2000", values);
+	 *
+	 * @param header = The name of the header (example: Subject).
+	 * @param  start = The oldest wanted article.
+	 * @param    end = The newest wanted article.
+	 * @param values = Where the (article number, value) pairs
+	 * are added.
+	 * @return  bool = Did we receive the headers?
+	 */
+	bool nntp::hdr(const std::string &header, const std::string &start,
+					const std::string &end, hdrlist &values) {
+		if (!groupselected) {
+			throw NNTPException("No group selected.");
+			return false;
+		}
+
+		return sendhdr(header + ' ' + start + '-' + end, values);
+	}
+
+	/**
+	 * Send the HDR command for 1 article number or message-id.
+	 *
+	 * @note See the range version above, when a message-id is
+	 * used HDR returns 0 and XHDR returns the message-id in place
+	 * of the article number, the pair is added with number 0.
+	 * @public
+	 *
+	 * @param  header = The name of the header (example: Subject).
+	 * @param anumber = The number or message-id of the article.
+	 * @param  values = Where the (article number, value) pair
+	 * is added.
+	 * @return   bool = Did we receive the header?
+	 */
+	bool nntp::hdr(const std::string &header, const std::string &anumber,
+					hdrlist &values) {
+		// A message-id does not need a group.
+		if (!groupselected && (anumber.empty() || anumber[0] != '<')) {
+			throw NNTPException("No group selected.");
+			return false;
+		}
+
+		return sendhdr(header + ' ' + anumber, values);
+	}
+
 	/**
 	 * Post an article to usenet.
 	 * 
@@ -1070,6 +1247,54 @@ namespace cppnntp {
 		}
 	}
 
+	/**
+	 * Send HDR (or XHDR) with the arguments and parse the response.
+	 *
+	 * @private
+	 *
+	 * @param arguments = The header name and the range.
+	 * @param    values = Where the pairs are added.
+	 * @return     bool = Did we receive the headers?
+	 */
+	bool nntp::sendhdr(const std::string &arguments, hdrlist &values) {
+		if (hdrsupported) {
+			if (!sock.send_command("HDR " + arguments))
+				return false;
+
+			if (sock.read_lines(RESPONSECODE_HEADERS_FOLLOW, responsechain))
+				return values.parse(responsechain);
+
+			// Anything other than unknown command is a real error.
+			if (!startswith(responsechain, "500"))
+				return false;
+
+			// Don't try HDR again on this connection.
+			hdrsupported = false;
+		}
+
+		if (!sock.send_command("XHDR " + arguments))
+			return false;
+
+		if (!sock.read_lines(RESPONSECODE_HEAD_FOLLOWS, responsechain))
+			return false;
+
+		return values.parse(responsechain);
+	}
+
+	/**
+	 * Does a response start with a response code?
+	 *
+	 * @private
+	 *
+	 * @param chain = The response.
+	 * @param  code = The 3 digits of the code.
+	 * @return bool = Does it start with the code?
+	 */
+	bool nntp::startswith(const bufferchain &chain, const char *code) {
+		return chain.size() >= 3 && chain[0] == code[0]
+			&& chain[1] == code[1] && chain[2] == code[2];
+	}
+
 	/**
 	 * Parse response from GROUP command.
 	 * 
@@ -1092,15 +1317,15 @@ namespace cppnntp {
 						break;
 					// Total amount of articles.
 					case 1:
-						grouptotal = std::stoi(curline);
+						grouptotal = std::stoul(curline);
 						break;
 					// Oldest article.
 					case 2:
-						groupoldest = std::stoi(curline);
+						groupoldest = std::stoul(curline);
 						break;
 					// Newest article.
 					case 3:
-						groupnewest = std::stoi(curline);
+						groupnewest = std::stoul(curline);
 						break;
 				}
 				curline = "";
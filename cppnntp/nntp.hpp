@@ -3,11 +3,16 @@
 #include <boost/asio/ssl.hpp>
 #include <boost/system/system_error.hpp>
 #include <boost/date_time.hpp>
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <stdexcept>
+#include <vector>
+#include "articlecache.hpp"
+#include "hdrlist.hpp"
+#include "overview.hpp"
 #include "socket.hpp"
 #include "yencdecode.hpp"
 
@@ -65,6 +70,15 @@ namespace cppnntp
 		 */
 		void disconnect();
 
+		/**
+		 * Are we connected to usenet?
+		 *
+		 * @public
+		 *
+		 * @return bool = Are we?
+		 */
+		bool is_connected();
+
 		/**
 		 * Authenticate to usenet.
 		 *
@@ -398,6 +412,60 @@ namespace cppnntp
 		bool body(const std::string &anumber, std::string &data,
 						const std::string &store = "");
 
+		/**
+		 * Send the BODY command for several message-ids at once,
+		 * without waiting for the responses (pipelining).
+		 *
+		 * @note Read each response, in order, with readbody.
+		 * @public
+		 *
+		 * @param messageids = The message-ids, with the < and >.
+		 * @return      bool = Were the commands sent?
+		 */
+		bool sendbodies(const std::vector<std::string> &messageids);
+
+		/**
+		 * Read the response to the oldest BODY command sent by
+		 * sendbodies.
+		 *
+		 * @public
+		 *
+		 * @param data = Where the raw response is stored (status line,
+		 * then the still encoded body up to and including the .\r\n).
+		 * @param code = Where the response code is stored
+		 * (example: 430 when the article is missing).
+		 * @return bool = Did we receive the body?
+		 */
+		bool readbody(std::string &data, unsigned short &code);
+
+		/**
+		 * When the first byte of the last response read by readbody
+		 * arrived, used to measure the time to first byte.
+		 *
+		 * @public
+		 */
+		std::chrono::steady_clock::time_point firstbyte() const;
+
+		/**
+		 * Set the bandwidth limits applied to every read.
+		 *
+		 * @public
+		 *
+		 * @param global = Limit shared by every server, NULL for none.
+		 * @param server = Limit of this server, NULL for none.
+		 */
+		void setlimiters(ratelimiter *global, ratelimiter *server);
+
+		/**
+		 * Set a cache consulted by body before going to usenet,
+		 * for bodies asked for by message-id.
+		 *
+		 * @public
+		 *
+		 * @param cache = The cache, NULL for none.
+		 */
+		void setcache(articlecache *cache);
+
 		/**
 		 * Send the HEAD command for 1 article number or message-id.
 		 *
@@ -438,6 +506,23 @@ namespace cppnntp
 		 */
 		bool xover(const std::string &start, const std::string &end);
 
+		/**
+		 * Send the XOVER command for a range of article numbers and
+		 * store the headers.
+		 *
+		 * @note Same as the range version above, but the headers are
+		 * parsed into rows instead of being displayed. A range without
+		 * articles is not an error, no rows are added.
+		 * @public
+		 *
+		 * @param  start = The oldest wanted article.
+		 * @param    end = The newest wanted article.
+		 * @param   rows = Where the parsed headers are added.
+		 * @return  bool = Did we receive the headers?
+		 */
+		bool xover(const std::string &start, const std::string &end,
+						overview &rows);
+
 		/**
 		 * Send the XOVER command for an article number
 		 * (and all above or below).
@@ -454,6 +539,44 @@ namespace cppnntp
 		 */
 		bool xover(const std::string &anumber, bool &direction);
 
+		/**
+		 * Send the HDR command for a range of article numbers.
+		 *
+		 * @note This passes the HDR command (RFC3977) for a single
+		 * header over multiple article numbers, falling back to XHDR
+		 * (RFC2980) if the server does not know HDR. The results are
+		 * stored in values instead of being displayed, use this
+		 * instead of XOVER when only 1 header is needed.
+		 * @public
+		 * @example       hdr("Subject", "1000", "2000", values);
+		 *
+		 * @param header = The name of the header (example: Subject).
+		 * @param  start = The oldest wanted article.
+		 * @param    end = The newest wanted article.
+		 * @param values = Where the (article number, value) pairs
+		 * are added.
+		 * @return  bool = Did we receive the headers?
+		 */
+		bool hdr(const std::string &header, const std::string &start,
+						const std::string &end, hdrlist &values);
+
+		/**
+		 * Send the HDR command for 1 article number or message-id.
+		 *
+		 * @note See the range version above, when a message-id is
+		 * used HDR returns 0 and XHDR returns the message-id in place
+		 * of the article number, the pair is added with number 0.
+		 * @public
+		 *
+		 * @param  header = The name of the header (example: Subject).
+		 * @param anumber = The number or message-id of the article.
+		 * @param  values = Where the (article number, value) pair
+		 * is added.
+		 * @return   bool = Did we receive the header?
+		 */
+		bool hdr(const std::string &header, const std::string &anumber,
+						hdrlist &values);
+
 		/**
 		 * Post an article to usenet.
 		 *
@@ -510,6 +633,27 @@ namespace cppnntp
 		 */
 		socket sock;
 
+		/**
+		 * Cache of bodies, NULL when not set.
+		 *
+		 * @private
+		 */
+		articlecache *cache = NULL;
+
+		/**
+		 * Response buffer of body, kept so its memory is reused.
+		 *
+		 * @private
+		 */
+		std::string bodybuffer;
+
+		/**
+		 * Response buffer of XOVER and HDR, kept so its blocks are reused.
+		 *
+		 * @private
+		 */
+		bufferchain responsechain;
+
 		/**
 		 * Did we already parse the overview format?
 		 *
@@ -570,6 +714,37 @@ namespace cppnntp
 		 */
 		void parsegroup(const std::string &finalbuffer);
 
+		/**
+		 * Does the server support HDR? If not we use XHDR.
+		 *
+		 * @note This is set to false the first time the server
+		 * answers HDR with unknown command.
+		 * @private
+		 */
+		bool hdrsupported = true;
+
+		/**
+		 * Send HDR (or XHDR) with the arguments and parse the response.
+		 *
+		 * @private
+		 *
+		 * @param arguments = The header name and the range.
+		 * @param    values = Where the pairs are added.
+		 * @return     bool = Did we receive the headers?
+		 */
+		bool sendhdr(const std::string &arguments, hdrlist &values);
+
+		/**
+		 * Does a response start with a response code?
+		 *
+		 * @private
+		 *
+		 * @param chain = The response.
+		 * @param  code = The 3 digits of the code.
+		 * @return bool = Does it start with the code?
+		 */
+		static bool startswith(const bufferchain &chain, const char *code);
+
 		/* Group objects for the currently selected group follow.
 		 */
 		/**
@@ -611,7 +786,7 @@ namespace cppnntp
 	/**
 	 * Exceptions for class nntp.
 	 */
-	class NNTPException : std::runtime_error
+	class NNTPException : public std::runtime_error
 	{
 		public: NNTPException(const std::string& error) : runtime_error(error) {
 		}
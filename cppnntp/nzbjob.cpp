@@ -0,0 +1,191 @@
+#include <algorithm>
+#include "nzbjob.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	nzbjob::nzbjob() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	nzbjob::~nzbjob() {}
+
+	/**
+	 * Start a file.
+	 *
+	 * @public
+	 *
+	 * @param  poster = The poster.
+	 * @param    date = Unix time of the post.
+	 * @param subject = The subject.
+	 * @return Position of the file.
+	 */
+	unsigned int nzbjob::addfile(const field &poster, const unsigned long &date, const field &subject) {
+		nzbfile f;
+		f.subject = strings.append(subject.data, subject.length);
+		f.subjectlength = subject.length;
+		f.poster = strings.append(poster.data, poster.length);
+		f.posterlength = poster.length;
+		f.date = date;
+		f.firstsegment = segmentlist.size();
+		f.segments = 0;
+		f.bytes = 0;
+		f.firstgroup = grouprefs.size();
+		f.groups = 0;
+		filelist.push_back(f);
+		return filelist.size() - 1;
+	}
+
+	/**
+	 * Add a group to the last file.
+	 *
+	 * @public
+	 *
+	 * @param name = The group.
+	 */
+	void nzbjob::addgroup(const field &name) {
+		if (filelist.empty() || name.length == 0)
+			return;
+
+		// Jobs use a handful of groups, a linear search is fine.
+		unsigned int id = 0;
+		while (id < groupnames.size() && !(name == groupnames[id]))
+			id++;
+		if (id == groupnames.size())
+			groupnames.push_back(name.str());
+
+		grouprefs.push_back(id);
+		filelist.back().groups++;
+	}
+
+	/**
+	 * Add a segment to the last file.
+	 *
+	 * @public
+	 *
+	 * @param    number = The part number.
+	 * @param     bytes = Size of the article.
+	 * @param messageid = The message-id, with or without the < and >.
+	 */
+	void nzbjob::addsegment(const unsigned int &number, const unsigned long &bytes,
+			const field &messageid) {
+		if (filelist.empty())
+			return;
+
+		const char *id = messageid.data;
+		unsigned long length = messageid.length;
+		if (length >= 2 && id[0] == '<' && id[length - 1] == '>') {
+			id++;
+			length -= 2;
+		}
+		if (length == 0)
+			return;
+
+		nzbsegment s;
+		s.messageid = strings.append(id, length);
+		s.messageidlength = length;
+		s.number = number;
+		s.bytes = bytes;
+		s.file = filelist.size() - 1;
+		segmentlist.push_back(s);
+
+		nzbfile &f = filelist.back();
+		f.segments++;
+		f.bytes += bytes;
+		totalbytes += bytes;
+	}
+
+	/**
+	 * Finish the last file: sort its segments by part number
+	 * and drop repeated part numbers.
+	 *
+	 * @public
+	 */
+	void nzbjob::endfile() {
+		if (filelist.empty())
+			return;
+
+		nzbfile &f = filelist.back();
+		std::vector<nzbsegment>::iterator first = segmentlist.begin() + f.firstsegment;
+		std::stable_sort(first, segmentlist.end(),
+			[](const nzbsegment &a, const nzbsegment &b) { return a.number < b.number; });
+
+		std::vector<nzbsegment>::iterator last = std::unique(first, segmentlist.end(),
+			[](const nzbsegment &a, const nzbsegment &b) { return a.number == b.number; });
+		for (std::vector<nzbsegment>::iterator it = last; it != segmentlist.end(); ++it) {
+			f.bytes -= it->bytes;
+			totalbytes -= it->bytes;
+		}
+		segmentlist.erase(last, segmentlist.end());
+		f.segments = segmentlist.size() - f.firstsegment;
+	}
+
+	/**
+	 * Add a meta value from the NZB head.
+	 *
+	 * @public
+	 *
+	 * @param  type = The type (example: password).
+	 * @param value = The value.
+	 */
+	void nzbjob::addmeta(const std::string &type, const std::string &value) {
+		metas.push_back(std::make_pair(type, value));
+	}
+
+	/**
+	 * Get a meta value.
+	 *
+	 * @public
+	 *
+	 * @param type = The type.
+	 * @return The first value of that type, empty if none.
+	 */
+	std::string nzbjob::meta(const std::string &type) const {
+		for (unsigned long i = 0; i < metas.size(); i++) {
+			if (metas[i].first == type)
+				return metas[i].second;
+		}
+		return "";
+	}
+
+	/**
+	 * The file name of a file, the first "quoted" part of the
+	 * subject, or the whole subject if there are no quotes.
+	 *
+	 * @public
+	 *
+	 * @param f = The file.
+	 * @return The name.
+	 */
+	std::string nzbjob::filename(const nzbfile &f) const {
+		const field s = subject(f);
+		const char *end = s.data + s.length;
+		const char *open = std::find(s.data, end, '"');
+		if (open != end) {
+			const char *close = std::find(open + 1, end, '"');
+			if (close != end && close > open + 1)
+				return std::string(open + 1, close);
+		}
+		return s.str();
+	}
+
+	/**
+	 * Remove every file.
+	 *
+	 * @public
+	 */
+	void nzbjob::clear() {
+		strings.clear();
+		filelist.clear();
+		segmentlist.clear();
+		groupnames.clear();
+		grouprefs.clear();
+		metas.clear();
+		totalbytes = 0;
+	}
+}
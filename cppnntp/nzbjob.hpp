@@ -0,0 +1,318 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include "arena.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * 1 article of a file in a download job.
+	 */
+	struct nzbsegment
+	{
+		/**
+		 * Message-id offset and length in the job's arena
+		 * (without the < and >).
+		 */
+		unsigned long messageid;
+		unsigned int messageidlength;
+
+		/**
+		 * Part number, from 1.
+		 */
+		unsigned int number;
+
+		/**
+		 * Size of the article in bytes.
+		 */
+		unsigned long bytes;
+
+		/**
+		 * Position of the file the segment belongs to.
+		 */
+		unsigned int file;
+	};
+
+	/**
+	 * A file in a download job.
+	 */
+	struct nzbfile
+	{
+		/**
+		 * Subject and poster offsets and lengths in the job's arena.
+		 */
+		unsigned long subject;
+		unsigned int subjectlength;
+		unsigned long poster;
+		unsigned int posterlength;
+
+		/**
+		 * Unix time of the post.
+		 */
+		unsigned long date;
+
+		/**
+		 * Position of the first segment and amount of segments,
+		 * sorted by part number.
+		 */
+		unsigned long firstsegment;
+		unsigned int segments;
+
+		/**
+		 * Sum of the segment sizes.
+		 */
+		unsigned long bytes;
+
+		/**
+		 * Position of the first group id and amount of groups.
+		 */
+		unsigned long firstgroup;
+		unsigned short groups;
+	};
+
+	/**
+	 * A download job: the files, segments and groups of a NZB.
+	 *
+	 * @note Every segment of every file is in 1 flat list and every
+	 * string in 1 arena, so a job with 100k segments is a few
+	 * allocations.
+	 * Files are built in order: addfile(), then addgroup() and
+	 * addsegment() for that file, then endfile().
+	 */
+	class nzbjob
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		nzbjob();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~nzbjob();
+
+		/**
+		 * Start a file.
+		 *
+		 * @public
+		 *
+		 * @param  poster = The poster.
+		 * @param    date = Unix time of the post.
+		 * @param subject = The subject.
+		 * @return Position of the file.
+		 */
+		unsigned int addfile(const field &poster, const unsigned long &date, const field &subject);
+
+		/**
+		 * Add a group to the last file.
+		 *
+		 * @public
+		 *
+		 * @param name = The group.
+		 */
+		void addgroup(const field &name);
+
+		/**
+		 * Add a segment to the last file.
+		 *
+		 * @public
+		 *
+		 * @param    number = The part number.
+		 * @param     bytes = Size of the article.
+		 * @param messageid = The message-id, with or without the < and >.
+		 */
+		void addsegment(const unsigned int &number, const unsigned long &bytes,
+				const field &messageid);
+
+		/**
+		 * Finish the last file: sort its segments by part number
+		 * and drop repeated part numbers.
+		 *
+		 * @public
+		 */
+		void endfile();
+
+		/**
+		 * Add a meta value from the NZB head.
+		 *
+		 * @public
+		 *
+		 * @param  type = The type (example: password).
+		 * @param value = The value.
+		 */
+		void addmeta(const std::string &type, const std::string &value);
+
+		/**
+		 * Get a meta value.
+		 *
+		 * @public
+		 *
+		 * @param type = The type.
+		 * @return The first value of that type, empty if none.
+		 */
+		std::string meta(const std::string &type) const;
+
+		/**
+		 * Amount of files.
+		 *
+		 * @public
+		 */
+		unsigned long files() const {
+			return filelist.size();
+		}
+
+		/**
+		 * Get a file.
+		 *
+		 * @public
+		 *
+		 * @param index = Position, from 0 to files() - 1.
+		 */
+		const nzbfile &file(const unsigned long &index) const {
+			return filelist[index];
+		}
+
+		/**
+		 * Amount of segments of every file.
+		 *
+		 * @public
+		 */
+		unsigned long segments() const {
+			return segmentlist.size();
+		}
+
+		/**
+		 * Get a segment.
+		 *
+		 * @public
+		 *
+		 * @param index = Position, from 0 to segments() - 1.
+		 */
+		const nzbsegment &segment(const unsigned long &index) const {
+			return segmentlist[index];
+		}
+
+		/**
+		 * Sum of the sizes of every segment.
+		 *
+		 * @public
+		 */
+		unsigned long bytes() const {
+			return totalbytes;
+		}
+
+		/**
+		 * The subject of a file.
+		 *
+		 * @public
+		 */
+		field subject(const nzbfile &f) const {
+			return strings.view(f.subject, f.subjectlength);
+		}
+
+		/**
+		 * The poster of a file.
+		 *
+		 * @public
+		 */
+		field poster(const nzbfile &f) const {
+			return strings.view(f.poster, f.posterlength);
+		}
+
+		/**
+		 * The message-id of a segment, without the < and >.
+		 *
+		 * @public
+		 */
+		field messageid(const nzbsegment &s) const {
+			return strings.view(s.messageid, s.messageidlength);
+		}
+
+		/**
+		 * Get a group of a file.
+		 *
+		 * @public
+		 *
+		 * @param     f = The file.
+		 * @param index = From 0 to f.groups - 1.
+		 * @return The name of the group.
+		 */
+		const std::string &group(const nzbfile &f, const unsigned short &index) const {
+			return groupnames[grouprefs[f.firstgroup + index]];
+		}
+
+		/**
+		 * The file name of a file, the first "quoted" part of the
+		 * subject, or the whole subject if there are no quotes.
+		 *
+		 * @public
+		 *
+		 * @param f = The file.
+		 * @return The name.
+		 */
+		std::string filename(const nzbfile &f) const;
+
+		/**
+		 * Remove every file.
+		 *
+		 * @public
+		 */
+		void clear();
+
+	private:
+		/**
+		 * Every string of the job.
+		 *
+		 * @private
+		 */
+		arena strings;
+
+		/**
+		 * The files in NZB order.
+		 *
+		 * @private
+		 */
+		std::vector<nzbfile> filelist;
+
+		/**
+		 * The segments of every file, file by file.
+		 *
+		 * @private
+		 */
+		std::vector<nzbsegment> segmentlist;
+
+		/**
+		 * Group names, each stored once.
+		 *
+		 * @private
+		 */
+		std::vector<std::string> groupnames;
+
+		/**
+		 * Group ids of every file, file by file.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned int> grouprefs;
+
+		/**
+		 * Meta values from the NZB head.
+		 *
+		 * @private
+		 */
+		std::vector<std::pair<std::string, std::string> > metas;
+
+		/**
+		 * Sum of the sizes of every segment.
+		 *
+		 * @private
+		 */
+		unsigned long totalbytes = 0;
+	};
+}
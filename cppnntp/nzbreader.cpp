@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "nzbreader.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param job = The job to fill.
+	 */
+	nzbreader::nzbreader(nzbjob &job) : job(job) {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	nzbreader::~nzbreader() {}
+
+	/**
+	 * Parse the next chunk of a NZB.
+	 *
+	 * @public
+	 *
+	 * @param   data = The chunk.
+	 * @param length = Length of the chunk.
+	 */
+	void nzbreader::feed(const char *data, const unsigned long &length) {
+		// Only copy the chunk when a tag was cut in half by the last one.
+		if (pending.empty()) {
+			const unsigned long parsed = parse(data, length);
+			if (parsed < length)
+				pending.assign(data + parsed, length - parsed);
+			return;
+		}
+		pending.append(data, length);
+		pending.erase(0, parse(pending.data(), pending.length()));
+	}
+
+	/**
+	 * Call after the last chunk.
+	 *
+	 * @public
+	 *
+	 * @return bool = Was it a NZB? (Had a nzb element.)
+	 */
+	bool nzbreader::finish() {
+		// A truncated file keeps what was read.
+		if (infile)
+			job.endfile();
+		infile = false;
+		current = NONE;
+		pending.clear();
+		text.clear();
+
+		const bool found = seenroot;
+		seenroot = false;
+		return found;
+	}
+
+	/**
+	 * Read a NZB from a stream.
+	 *
+	 * @public
+	 *
+	 * @param in = The stream.
+	 * @return bool = Was it read and was it a NZB?
+	 */
+	bool nzbreader::read(std::istream &in) {
+		std::vector<char> buffer(1048576);
+		while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)
+			feed(buffer.data(), in.gcount());
+
+		const bool bad = in.bad();
+		return finish() && !bad;
+	}
+
+	/**
+	 * Read a NZB file.
+	 *
+	 * @public
+	 *
+	 * @param path = Path/file.
+	 * @return bool = Was it read and was it a NZB?
+	 */
+	bool nzbreader::load(const std::string &path) {
+		std::ifstream file(path.c_str(), std::ios::binary);
+		if (!file.is_open())
+			return false;
+		return read(file);
+	}
+
+	/**
+	 * Parse as much of a buffer as possible.
+	 *
+	 * @private
+	 *
+	 * @param   data = The buffer.
+	 * @param length = Its length.
+	 * @return The amount of bytes parsed.
+	 */
+	unsigned long nzbreader::parse(const char *data, const unsigned long &length) {
+		static const char comment[] = "<!--";
+		static const char cdata[] = "<![CDATA[";
+		const char *pos = data;
+		const char *end = data + length;
+
+		while (pos < end) {
+			if (*pos != '<') {
+				const char *lt = static_cast<const char *>(std::memchr(pos, '<', end - pos));
+				if (lt == NULL)
+					lt = end;
+				if (current != NONE)
+					text.append(pos, lt - pos);
+				pos = lt;
+				continue;
+			}
+
+			const unsigned long left = end - pos;
+			// Wait for more data if this could still become a comment or CDATA.
+			if ((left < 4 && std::memcmp(pos, comment, left) == 0)
+					|| (left < 9 && std::memcmp(pos, cdata, left) == 0))
+				return pos - data;
+
+			if (left >= 4 && std::memcmp(pos, comment, 4) == 0) {
+				const char *close = std::search(pos + 4, end, "-->", "-->" + 3);
+				if (close == end)
+					return pos - data;
+				pos = close + 3;
+				continue;
+			}
+
+			if (left >= 9 && std::memcmp(pos, cdata, 9) == 0) {
+				const char *close = std::search(pos + 9, end, "]]>", "]]>" + 3);
+				if (close == end)
+					return pos - data;
+				// The text is decoded later, so escape the & of the raw text.
+				for (const char *c = pos + 9; current != NONE && c < close; c++) {
+					if (*c == '&')
+						text += "&amp;";
+					else
+						text += *c;
+				}
+				pos = close + 3;
+				continue;
+			}
+
+			// A > inside a quoted attribute value does not end the tag.
+			const char *gt = pos + 1;
+			char quote = 0;
+			for (; gt < end; gt++) {
+				if (quote) {
+					if (*gt == quote)
+						quote = 0;
+				} else if (*gt == '"' || *gt == '\'')
+					quote = *gt;
+				else if (*gt == '>')
+					break;
+			}
+			if (gt == end)
+				return pos - data;
+
+			tag(pos + 1, gt - pos - 1);
+			pos = gt + 1;
+		}
+		return length;
+	}
+
+	/**
+	 * Handle a tag (what is between < and >).
+	 *
+	 * @private
+	 *
+	 * @param   data = The tag.
+	 * @param length = Its length.
+	 */
+	void nzbreader::tag(const char *data, unsigned long length) {
+		if (length == 0 || data[0] == '?' || data[0] == '!')
+			return;
+
+		const char *end = data + length;
+		const bool closing = data[0] == '/';
+		if (closing)
+			data++;
+		const bool selfclosing = !closing && end[-1] == '/';
+		if (selfclosing)
+			end--;
+
+		// Element name, without a namespace prefix.
+		const char *name = data;
+		const char *pos = data;
+		while (pos < end && *pos != ' ' && *pos != '\t' && *pos != '\r' && *pos != '\n') {
+			if (*pos++ == ':')
+				name = pos;
+		}
+		const unsigned long namelength = pos - name;
+
+		if (closing) {
+			close(name, namelength);
+			return;
+		}
+
+		// Attributes: name="value" or name='value'.
+		attributecount = 0;
+		while (pos < end) {
+			while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n'))
+				pos++;
+			const char *attribute = pos;
+			while (pos < end && *pos != '=' && *pos != ' ' && *pos != '\t'
+					&& *pos != '\r' && *pos != '\n') {
+				if (*pos++ == ':')
+					attribute = pos;
+			}
+			const unsigned long attributelength = pos - attribute;
+			while (pos < end && *pos != '=')
+				pos++;
+			if (pos < end)
+				pos++;
+			while (pos < end && *pos != '"' && *pos != '\'')
+				pos++;
+			if (pos >= end)
+				break;
+
+			const char quote = *pos++;
+			const char *valueend = std::find(pos, end, quote);
+			if (attributecount == attributes.size())
+				attributes.resize(attributecount + 1);
+			std::pair<std::string, std::string> &a = attributes[attributecount++];
+			a.first.assign(attribute, attributelength);
+			a.second.clear();
+			decode(pos, valueend - pos, a.second);
+			pos = valueend < end ? valueend + 1 : end;
+		}
+
+		open(name, namelength);
+		if (selfclosing)
+			close(name, namelength);
+	}
+
+	/**
+	 * Handle the start of an element.
+	 *
+	 * @private
+	 *
+	 * @param   name = Local name of the element.
+	 * @param length = Length of the name.
+	 */
+	void nzbreader::open(const char *name, const unsigned long &length) {
+		if (is(name, length, "segment")) {
+			if (!infile)
+				return;
+			const std::string *a = attribute("number");
+			number = a ? std::strtoul(a->c_str(), NULL, 10) : 0;
+			a = attribute("bytes");
+			bytes = a ? std::strtoul(a->c_str(), NULL, 10) : 0;
+			current = SEGMENT;
+			text.clear();
+		} else if (is(name, length, "group")) {
+			if (!infile)
+				return;
+			current = GROUP;
+			text.clear();
+		} else if (is(name, length, "file")) {
+			if (infile)
+				job.endfile();
+
+			static const std::string empty;
+			const std::string *poster = attribute("poster");
+			const std::string *subject = attribute("subject");
+			const std::string *date = attribute("date");
+			if (poster == NULL)
+				poster = &empty;
+			if (subject == NULL)
+				subject = &empty;
+			field p = { poster->data(), poster->length() };
+			field s = { subject->data(), subject->length() };
+			job.addfile(p, date ? std::strtoul(date->c_str(), NULL, 10) : 0, s);
+			infile = true;
+		} else if (is(name, length, "meta")) {
+			const std::string *a = attribute("type");
+			type = a ? *a : "";
+			current = META;
+			text.clear();
+		} else if (is(name, length, "nzb"))
+			seenroot = true;
+	}
+
+	/**
+	 * Handle the end of an element.
+	 *
+	 * @private
+	 *
+	 * @param   name = Local name of the element.
+	 * @param length = Length of the name.
+	 */
+	void nzbreader::close(const char *name, const unsigned long &length) {
+		if (is(name, length, "segment")) {
+			if (current != SEGMENT)
+				return;
+			content(value);
+			field id = { value.data(), value.length() };
+			job.addsegment(number, bytes, id);
+			current = NONE;
+		} else if (is(name, length, "group")) {
+			if (current != GROUP)
+				return;
+			content(value);
+			field g = { value.data(), value.length() };
+			job.addgroup(g);
+			current = NONE;
+		} else if (is(name, length, "file")) {
+			if (infile)
+				job.endfile();
+			infile = false;
+			current = NONE;
+		} else if (is(name, length, "meta")) {
+			if (current != META)
+				return;
+			content(value);
+			job.addmeta(type, value);
+			current = NONE;
+		}
+	}
+
+	/**
+	 * Get an attribute of the tag being parsed.
+	 *
+	 * @private
+	 *
+	 * @param name = Local name of the attribute.
+	 * @return The decoded value, NULL if missing.
+	 */
+	const std::string *nzbreader::attribute(const char *name) const {
+		for (unsigned int i = 0; i < attributecount; i++) {
+			if (attributes[i].first == name)
+				return &attributes[i].second;
+		}
+		return NULL;
+	}
+
+	/**
+	 * Append text with the XML entities decoded.
+	 *
+	 * @private
+	 *
+	 * @param   data = The text.
+	 * @param length = Its length.
+	 * @param    out = Where it is appended.
+	 */
+	void nzbreader::decode(const char *data, const unsigned long &length, std::string &out) {
+		const char *pos = data;
+		const char *end = data + length;
+		while (pos < end) {
+			const char *amp = static_cast<const char *>(std::memchr(pos, '&', end - pos));
+			if (amp == NULL) {
+				out.append(pos, end - pos);
+				return;
+			}
+			out.append(pos, amp - pos);
+
+			const char *semi = static_cast<const char *>(
+				std::memchr(amp, ';', std::min<unsigned long>(end - amp, 12)));
+			if (semi == NULL) {
+				out += '&';
+				pos = amp + 1;
+				continue;
+			}
+
+			const char *entity = amp + 1;
+			const unsigned long entitylength = semi - entity;
+			if (is(entity, entitylength, "amp"))
+				out += '&';
+			else if (is(entity, entitylength, "lt"))
+				out += '<';
+			else if (is(entity, entitylength, "gt"))
+				out += '>';
+			else if (is(entity, entitylength, "quot"))
+				out += '"';
+			else if (is(entity, entitylength, "apos"))
+				out += '\'';
+			else if (entitylength > 1 && entity[0] == '#') {
+				// Character reference, written as UTF-8.
+				const bool hex = entity[1] == 'x' || entity[1] == 'X';
+				const unsigned long code = std::strtoul(
+					std::string(entity + (hex ? 2 : 1), semi).c_str(), NULL, hex ? 16 : 10);
+				if (code < 0x80)
+					out += static_cast<char>(code);
+				else if (code < 0x800) {
+					out += static_cast<char>(0xC0 | (code >> 6));
+					out += static_cast<char>(0x80 | (code & 0x3F));
+				} else if (code < 0x10000) {
+					out += static_cast<char>(0xE0 | (code >> 12));
+					out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (code & 0x3F));
+				} else if (code < 0x110000) {
+					out += static_cast<char>(0xF0 | (code >> 18));
+					out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+					out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (code & 0x3F));
+				}
+			} else
+				out.append(amp, semi + 1 - amp);
+			pos = semi + 1;
+		}
+	}
+
+	/**
+	 * Text of the current element without the entities and
+	 * leading and trailing white space.
+	 *
+	 * @private
+	 *
+	 * @param out = Where it is stored.
+	 */
+	void nzbreader::content(std::string &out) const {
+		const char *first = text.data();
+		const char *last = first + text.length();
+		while (first < last && std::isspace(static_cast<unsigned char>(*first)))
+			first++;
+		while (last > first && std::isspace(static_cast<unsigned char>(last[-1])))
+			last--;
+		out.clear();
+		decode(first, last - first, out);
+	}
+
+	/**
+	 * Compare a name to a string.
+	 *
+	 * @private
+	 *
+	 * @param   name = The name.
+	 * @param length = Length of the name.
+	 * @param literal = The string.
+	 * @return  bool = Are they equal?
+	 */
+	bool nzbreader::is(const char *name, const unsigned long &length, const char *literal) {
+		return std::strlen(literal) == length && std::memcmp(name, literal, length) == 0;
+	}
+}
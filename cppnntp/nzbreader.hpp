@@ -0,0 +1,236 @@
+#pragma once
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "nzbjob.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Reads a NZB file into a download job.
+	 *
+	 * @note The XML is parsed as it comes in (no document is built),
+	 * only the bytes of a tag cut in half by a chunk boundary are
+	 * kept between calls to feed(). Unknown elements are ignored,
+	 * segments without a message-id are dropped.
+	 * Not thread safe.
+	 */
+	class nzbreader
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param job = The job to fill.
+		 */
+		nzbreader(nzbjob &job);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~nzbreader();
+
+		/**
+		 * Parse the next chunk of a NZB.
+		 *
+		 * @public
+		 *
+		 * @param   data = The chunk.
+		 * @param length = Length of the chunk.
+		 */
+		void feed(const char *data, const unsigned long &length);
+
+		/**
+		 * Call after the last chunk.
+		 *
+		 * @public
+		 *
+		 * @return bool = Was it a NZB? (Had a nzb element.)
+		 */
+		bool finish();
+
+		/**
+		 * Read a NZB from a stream.
+		 *
+		 * @public
+		 *
+		 * @param in = The stream.
+		 * @return bool = Was it read and was it a NZB?
+		 */
+		bool read(std::istream &in);
+
+		/**
+		 * Read a NZB file.
+		 *
+		 * @public
+		 *
+		 * @param path = Path/file.
+		 * @return bool = Was it read and was it a NZB?
+		 */
+		bool load(const std::string &path);
+
+	private:
+		/**
+		 * Elements whose text is kept.
+		 *
+		 * @private
+		 */
+		enum element { NONE, GROUP, SEGMENT, META };
+
+		/**
+		 * The job to fill.
+		 *
+		 * @private
+		 */
+		nzbjob &job;
+
+		/**
+		 * Unparsed bytes from the previous chunk.
+		 *
+		 * @private
+		 */
+		std::string pending;
+
+		/**
+		 * Text of the current element.
+		 *
+		 * @private
+		 */
+		std::string text;
+
+		/**
+		 * Element whose text is being kept.
+		 *
+		 * @private
+		 */
+		element current = NONE;
+
+		/**
+		 * Is a file element open?
+		 *
+		 * @private
+		 */
+		bool infile = false;
+
+		/**
+		 * Was a nzb element seen?
+		 *
+		 * @private
+		 */
+		bool seenroot = false;
+
+		/**
+		 * Attributes of the open segment or meta element.
+		 *
+		 * @private
+		 */
+		unsigned int number = 0;
+		unsigned long bytes = 0;
+		std::string type;
+
+		/**
+		 * Attributes of the tag being parsed, the first
+		 * attributecount are used, the rest keep their memory.
+		 *
+		 * @private
+		 */
+		std::vector<std::pair<std::string, std::string> > attributes;
+		unsigned int attributecount = 0;
+
+		/**
+		 * Reused buffer for the text of an element.
+		 *
+		 * @private
+		 */
+		std::string value;
+
+		/**
+		 * Parse as much of a buffer as possible.
+		 *
+		 * @private
+		 *
+		 * @param   data = The buffer.
+		 * @param length = Its length.
+		 * @return The amount of bytes parsed.
+		 */
+		unsigned long parse(const char *data, const unsigned long &length);
+
+		/**
+		 * Handle a tag (what is between < and >).
+		 *
+		 * @private
+		 *
+		 * @param   data = The tag.
+		 * @param length = Its length.
+		 */
+		void tag(const char *data, unsigned long length);
+
+		/**
+		 * Handle the start of an element.
+		 *
+		 * @private
+		 *
+		 * @param   name = Local name of the element.
+		 * @param length = Length of the name.
+		 */
+		void open(const char *name, const unsigned long &length);
+
+		/**
+		 * Handle the end of an element.
+		 *
+		 * @private
+		 *
+		 * @param   name = Local name of the element.
+		 * @param length = Length of the name.
+		 */
+		void close(const char *name, const unsigned long &length);
+
+		/**
+		 * Get an attribute of the tag being parsed.
+		 *
+		 * @private
+		 *
+		 * @param name = Local name of the attribute.
+		 * @return The decoded value, NULL if missing.
+		 */
+		const std::string *attribute(const char *name) const;
+
+		/**
+		 * Append text with the XML entities decoded.
+		 *
+		 * @private
+		 *
+		 * @param   data = The text.
+		 * @param length = Its length.
+		 * @param    out = Where it is appended.
+		 */
+		static void decode(const char *data, const unsigned long &length, std::string &out);
+
+		/**
+		 * Text of the current element without the entities and
+		 * leading and trailing white space.
+		 *
+		 * @private
+		 *
+		 * @param out = Where it is stored.
+		 */
+		void content(std::string &out) const;
+
+		/**
+		 * Compare a name to a string.
+		 *
+		 * @private
+		 *
+		 * @param   name = The name.
+		 * @param length = Length of the name.
+		 * @param literal = The string.
+		 * @return  bool = Are they equal?
+		 */
+		static bool is(const char *name, const unsigned long &length, const char *literal);
+	};
+}
@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "nzbwriter.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param out = The stream to write to.
+	 */
+	nzbwriter::nzbwriter(std::ostream &out) : out(out) {
+		buffer.reserve(65536 + 4096);
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @note Calls finish() if it was not called.
+	 * @public
+	 */
+	nzbwriter::~nzbwriter() {
+		if (!finished)
+			finish();
+	}
+
+	/**
+	 * Add a meta element to the head (example: title, password).
+	 *
+	 * @note Must be called before the first file.
+	 * @public
+	 *
+	 * @param  type = The type attribute.
+	 * @param value = The value.
+	 */
+	void nzbwriter::meta(const std::string &type, const std::string &value) {
+		if (!started)
+			metas.push_back(std::make_pair(type, value));
+	}
+
+	/**
+	 * Start a file element.
+	 *
+	 * @public
+	 *
+	 * @param  poster = The poster.
+	 * @param    date = Unix time of the post.
+	 * @param subject = The subject.
+	 * @param  groups = The groups it was posted to.
+	 */
+	void nzbwriter::file(const std::string &poster, const unsigned long &date,
+			const std::string &subject, const std::vector<std::string> &groups) {
+		openfile(poster.data(), poster.length(), date, subject.data(), subject.length());
+		for (unsigned long i = 0; i < groups.size(); i++)
+			group(groups[i]);
+	}
+
+	/**
+	 * Add a segment to the current file.
+	 *
+	 * @note Segments must be added in increasing number order.
+	 * @public
+	 *
+	 * @param    number = The part number.
+	 * @param     bytes = Size of the article.
+	 * @param messageid = The message-id, with or without the < and >.
+	 */
+	void nzbwriter::segment(const unsigned int &number, const unsigned long &bytes,
+			const field &messageid) {
+		if (!infile)
+			return;
+		opensegments();
+
+		// The NZB format stores the message-id without the < and >.
+		const char *id = messageid.data;
+		unsigned long length = messageid.length;
+		if (length >= 2 && id[0] == '<' && id[length - 1] == '>') {
+			id++;
+			length -= 2;
+		}
+
+		buffer += "   <segment bytes=\"";
+		this->number(bytes);
+		buffer += "\" number=\"";
+		this->number(number);
+		buffer += "\">";
+		escape(id, length);
+		buffer += "</segment>\n";
+		drain();
+	}
+
+	/**
+	 * Add a collated binary as a file with every received segment.
+	 *
+	 * @public
+	 *
+	 * @param      bin = The binary.
+	 * @param collated = The collator holding it.
+	 */
+	void nzbwriter::add(const binary &bin, const collator &collated) {
+		// Put the part marker back, most tools expect it in the subject.
+		std::string subject;
+		subject.reserve(bin.name.length() + 24);
+		subject = bin.name;
+		subject += " (1/";
+		subject += std::to_string(bin.total);
+		subject += ')';
+
+		openfile(bin.poster.data(), bin.poster.length(), bin.date,
+				subject.data(), subject.length());
+		for (unsigned long i = 0; i < bin.groups.size(); i++)
+			group(collated.groupname(bin.groups[i]));
+
+		order.clear();
+		for (unsigned long i = 0; i < bin.parts.size(); i++)
+			order.push_back(&bin.parts[i]);
+		std::sort(order.begin(), order.end(),
+			[](const binarypart *a, const binarypart *b) { return a->number < b->number; });
+
+		for (unsigned long i = 0; i < order.size(); i++)
+			segment(order[i]->number, order[i]->bytes, collated.messageid(*order[i]));
+	}
+
+	/**
+	 * Close the last file and the document, and flush.
+	 *
+	 * @public
+	 *
+	 * @return bool = Was everything written?
+	 */
+	bool nzbwriter::finish() {
+		if (finished)
+			return out.good();
+
+		if (!started)
+			start();
+		closefile();
+		buffer += "</nzb>\n";
+		drain(true);
+		out.flush();
+		finished = true;
+		return out.good();
+	}
+
+	/**
+	 * Amount of files written.
+	 *
+	 * @public
+	 */
+	unsigned long nzbwriter::files() const {
+		return count;
+	}
+
+	/**
+	 * Write a NZB file for some binaries of a collator.
+	 *
+	 * @note Written to a temporary file first, then renamed.
+	 * @public
+	 *
+	 * @param     path = Path/file to write.
+	 * @param collated = The collator.
+	 * @param binaries = Positions of the binaries in the collator.
+	 * @param    title = Title meta element, none if empty.
+	 * @return    bool = Did it work?
+	 */
+	bool nzbwriter::save(const std::string &path, const collator &collated,
+			const std::vector<unsigned long> &binaries, const std::string &title) {
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return false;
+
+			nzbwriter writer(file);
+			if (!title.empty())
+				writer.meta("title", title);
+			for (unsigned long i = 0; i < binaries.size(); i++)
+				writer.add(collated.at(binaries[i]), collated);
+			if (!writer.finish()) {
+				std::remove(temporary.c_str());
+				return false;
+			}
+		}
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+
+	/**
+	 * Write the XML declaration, the nzb element and the head.
+	 *
+	 * @private
+	 */
+	void nzbwriter::start() {
+		started = true;
+		buffer += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+			"<!DOCTYPE nzb PUBLIC \"-//newzBin//DTD NZB 1.1//EN\" "
+			"\"http://www.newzbin.com/DTD/nzb/nzb-1.1.dtd\">\n"
+			"<nzb xmlns=\"http://www.newzbin.com/DTD/2003/nzb\">\n";
+		if (!metas.empty()) {
+			buffer += " <head>\n";
+			for (unsigned long i = 0; i < metas.size(); i++) {
+				buffer += "  <meta type=\"";
+				escape(metas[i].first.data(), metas[i].first.length());
+				buffer += "\">";
+				escape(metas[i].second.data(), metas[i].second.length());
+				buffer += "</meta>\n";
+			}
+			buffer += " </head>\n";
+			metas.clear();
+		}
+	}
+
+	/**
+	 * Start a file element, without its groups.
+	 *
+	 * @private
+	 */
+	void nzbwriter::openfile(const char *poster, const unsigned long &posterlength,
+			const unsigned long &date, const char *subject, const unsigned long &subjectlength) {
+		if (finished)
+			return;
+		if (!started)
+			start();
+		closefile();
+
+		buffer += " <file poster=\"";
+		escape(poster, posterlength);
+		buffer += "\" date=\"";
+		number(date);
+		buffer += "\" subject=\"";
+		escape(subject, subjectlength);
+		buffer += "\">\n  <groups>\n";
+		infile = true;
+		section = 0;
+		count++;
+	}
+
+	/**
+	 * Close the groups element and open the segments element
+	 * if needed.
+	 *
+	 * @private
+	 */
+	void nzbwriter::opensegments() {
+		if (section == 0) {
+			buffer += "  </groups>\n  <segments>\n";
+			section = 1;
+		}
+	}
+
+	/**
+	 * Close the current file element, if any.
+	 *
+	 * @private
+	 */
+	void nzbwriter::closefile() {
+		if (!infile)
+			return;
+		opensegments();
+		buffer += "  </segments>\n </file>\n";
+		infile = false;
+		drain();
+	}
+
+	/**
+	 * Add a group element.
+	 *
+	 * @private
+	 *
+	 * @param name = The group.
+	 */
+	void nzbwriter::group(const std::string &name) {
+		if (!infile || section != 0)
+			return;
+		buffer += "   <group>";
+		escape(name.data(), name.length());
+		buffer += "</group>\n";
+	}
+
+	/**
+	 * Append escaped text to the buffer.
+	 *
+	 * @private
+	 *
+	 * @param   text = The text.
+	 * @param length = Its length.
+	 */
+	void nzbwriter::escape(const char *text, const unsigned long &length) {
+		// Copy runs of plain chars at once.
+		unsigned long run = 0;
+		for (unsigned long i = 0; i < length; i++) {
+			const unsigned char c = text[i];
+			const char *entity;
+			switch (c) {
+				case '&': entity = "&amp;"; break;
+				case '<': entity = "&lt;"; break;
+				case '>': entity = "&gt;"; break;
+				case '"': entity = "&quot;"; break;
+				case '\'': entity = "&apos;"; break;
+				default:
+					// Control chars are not allowed in XML 1.0, drop them.
+					if (c >= 0x20 || c == '\t' || c == '\n' || c == '\r')
+						continue;
+					entity = "";
+			}
+			buffer.append(text + run, i - run);
+			buffer += entity;
+			run = i + 1;
+		}
+		buffer.append(text + run, length - run);
+	}
+
+	/**
+	 * Append a number to the buffer.
+	 *
+	 * @private
+	 *
+	 * @param value = The number.
+	 */
+	void nzbwriter::number(unsigned long value) {
+		char digits[20];
+		unsigned short length = 0;
+		do {
+			digits[length++] = '0' + value % 10;
+			value /= 10;
+		} while (value);
+		while (length)
+			buffer += digits[--length];
+	}
+
+	/**
+	 * Write the buffer to the stream once it is big enough.
+	 *
+	 * @private
+	 *
+	 * @param force = Write it whatever the size.
+	 */
+	void nzbwriter::drain(const bool &force) {
+		if (buffer.empty() || (!force && buffer.length() < 65536))
+			return;
+		out.write(buffer.data(), buffer.length());
+		buffer.clear();
+	}
+}
@@ -0,0 +1,249 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "arena.hpp"
+#include "collator.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Writes a NZB file to a stream, 1 file element at a time.
+	 *
+	 * @note No document is built in memory, the XML is appended to
+	 * a small buffer that is written to the stream every 64KB.
+	 * Calls go in this order: meta() (optional), then for each file
+	 * file() followed by its segment() calls (or add()), then finish().
+	 * Not thread safe.
+	 */
+	class nzbwriter
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param out = The stream to write to.
+		 */
+		nzbwriter(std::ostream &out);
+
+		/**
+		 * Destructor.
+		 *
+		 * @note Calls finish() if it was not called.
+		 * @public
+		 */
+		~nzbwriter();
+
+		/**
+		 * Add a meta element to the head (example: title, password).
+		 *
+		 * @note Must be called before the first file.
+		 * @public
+		 *
+		 * @param  type = The type attribute.
+		 * @param value = The value.
+		 */
+		void meta(const std::string &type, const std::string &value);
+
+		/**
+		 * Start a file element.
+		 *
+		 * @public
+		 *
+		 * @param  poster = The poster.
+		 * @param    date = Unix time of the post.
+		 * @param subject = The subject.
+		 * @param  groups = The groups it was posted to.
+		 */
+		void file(const std::string &poster, const unsigned long &date,
+				const std::string &subject, const std::vector<std::string> &groups);
+
+		/**
+		 * Add a segment to the current file.
+		 *
+		 * @note Segments must be added in increasing number order.
+		 * @public
+		 *
+		 * @param    number = The part number.
+		 * @param     bytes = Size of the article.
+		 * @param messageid = The message-id, with or without the < and >.
+		 */
+		void segment(const unsigned int &number, const unsigned long &bytes,
+				const field &messageid);
+
+		/**
+		 * Add a collated binary as a file with every received segment.
+		 *
+		 * @public
+		 *
+		 * @param      bin = The binary.
+		 * @param collated = The collator holding it.
+		 */
+		void add(const binary &bin, const collator &collated);
+
+		/**
+		 * Close the last file and the document, and flush.
+		 *
+		 * @public
+		 *
+		 * @return bool = Was everything written?
+		 */
+		bool finish();
+
+		/**
+		 * Amount of files written.
+		 *
+		 * @public
+		 */
+		unsigned long files() const;
+
+		/**
+		 * Write a NZB file for some binaries of a collator.
+		 *
+		 * @note Written to a temporary file first, then renamed.
+		 * @public
+		 *
+		 * @param     path = Path/file to write.
+		 * @param collated = The collator.
+		 * @param binaries = Positions of the binaries in the collator.
+		 * @param    title = Title meta element, none if empty.
+		 * @return    bool = Did it work?
+		 */
+		static bool save(const std::string &path, const collator &collated,
+				const std::vector<unsigned long> &binaries, const std::string &title = "");
+
+	private:
+		/**
+		 * The stream to write to.
+		 *
+		 * @private
+		 */
+		std::ostream &out;
+
+		/**
+		 * XML not written to the stream yet.
+		 *
+		 * @private
+		 */
+		std::string buffer;
+
+		/**
+		 * Meta elements, written with the document start.
+		 *
+		 * @private
+		 */
+		std::vector<std::pair<std::string, std::string> > metas;
+
+		/**
+		 * Was the document start written?
+		 *
+		 * @private
+		 */
+		bool started = false;
+
+		/**
+		 * Is a file element open?
+		 *
+		 * @private
+		 */
+		bool infile = false;
+
+		/**
+		 * Where the file element is: 0 groups, 1 segments.
+		 *
+		 * @private
+		 */
+		unsigned short section = 0;
+
+		/**
+		 * Was finish() called?
+		 *
+		 * @private
+		 */
+		bool finished = false;
+
+		/**
+		 * Amount of files written.
+		 *
+		 * @private
+		 */
+		unsigned long count = 0;
+
+		/**
+		 * Reused list for sorting the parts of a binary.
+		 *
+		 * @private
+		 */
+		std::vector<const binarypart *> order;
+
+		/**
+		 * Write the XML declaration, the nzb element and the head.
+		 *
+		 * @private
+		 */
+		void start();
+
+		/**
+		 * Start a file element, without its groups.
+		 *
+		 * @private
+		 */
+		void openfile(const char *poster, const unsigned long &posterlength,
+				const unsigned long &date, const char *subject, const unsigned long &subjectlength);
+
+		/**
+		 * Close the groups element and open the segments element
+		 * if needed.
+		 *
+		 * @private
+		 */
+		void opensegments();
+
+		/**
+		 * Close the current file element, if any.
+		 *
+		 * @private
+		 */
+		void closefile();
+
+		/**
+		 * Add a group element.
+		 *
+		 * @private
+		 *
+		 * @param name = The group.
+		 */
+		void group(const std::string &name);
+
+		/**
+		 * Append escaped text to the buffer.
+		 *
+		 * @private
+		 *
+		 * @param   text = The text.
+		 * @param length = Its length.
+		 */
+		void escape(const char *text, const unsigned long &length);
+
+		/**
+		 * Append a number to the buffer.
+		 *
+		 * @private
+		 *
+		 * @param value = The number.
+		 */
+		void number(unsigned long value);
+
+		/**
+		 * Write the buffer to the stream once it is big enough.
+		 *
+		 * @private
+		 *
+		 * @param force = Write it whatever the size.
+		 */
+		void drain(const bool &force = false);
+	};
+}
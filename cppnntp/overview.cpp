@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstdlib>
+#include <strings.h>
+#include "overview.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	overview::overview() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	overview::~overview() {}
+
+	/**
+	 * Copy a row into the list.
+	 *
+	 * @public
+	 *
+	 * @param row = The row, the strings are copied into the arena.
+	 */
+	void overview::add(const overviewrow &row) {
+		const field *fields[columns] = {
+			&row.subject, &row.from, &row.date,
+			&row.messageid, &row.references, &row.xref
+		};
+
+		entry e;
+		e.number = row.number;
+		e.offset = strings.size();
+		e.bytes = row.bytes;
+		e.lines = row.lines;
+		for (unsigned short i = 0; i < columns; i++) {
+			e.lengths[i] = fields[i]->length;
+			strings.append(fields[i]->data, fields[i]->length);
+		}
+		entries.push_back(e);
+	}
+
+	/**
+	 * Copy every row of another list to the end of this one.
+	 *
+	 * @public
+	 *
+	 * @param other = The rows to copy.
+	 */
+	void overview::add(const overview &other) {
+		unsigned long base = strings.size();
+		strings.append(other.strings.view(0, other.strings.size()).data,
+				other.strings.size());
+		grow(other.entries.size(), 0);
+		for (unsigned long i = 0; i < other.entries.size(); i++) {
+			entries.push_back(other.entries[i]);
+			entries.back().offset += base;
+		}
+	}
+
+	/**
+	 * Parse a XOVER/OVER response and add every line to the list.
+	 *
+	 * @note Only the default RFC3977 overview format is understood,
+	 * (number, subject, from, date, message-id, references, bytes,
+	 * lines, then optional xref).
+	 * @public
+	 *
+	 * @param finalbuffer = The response, including the response
+	 * line and the terminating .CRLF
+	 * @return       bool = Was the response well formed?
+	 */
+	bool overview::parse(const std::string &finalbuffer) {
+		const char *pos = finalbuffer.data();
+		const char *end = pos + finalbuffer.length();
+
+		// Skip the response line.
+		pos = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+		if (pos == NULL)
+			return false;
+		pos++;
+
+		// Overview lines are usually a bit over 300 chars.
+		grow((end - pos) / 300, end - pos);
+
+		while (pos < end) {
+			const char *eol = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+			if (eol == NULL)
+				return false;
+
+			// Line without the CRLF.
+			const char *lineend = eol;
+			if (lineend > pos && lineend[-1] == '\r')
+				lineend--;
+
+			// Found the terminator.
+			if (lineend - pos == 1 && pos[0] == '.')
+				return true;
+
+			parseline(pos, lineend);
+			pos = eol + 1;
+		}
+
+		// The terminator was missing.
+		return false;
+	}
+
+	/**
+	 * Parse a XOVER/OVER response held in a chain of blocks, see
+	 * parse above.
+	 *
+	 * @public
+	 *
+	 * @param chain = The response, including the response
+	 * line and the terminating .CRLF
+	 * @return bool = Was the response well formed?
+	 */
+	bool overview::parse(const bufferchain &chain) {
+		unsigned long pos = 0;
+		const char *line;
+		unsigned long length;
+		std::string scratch;
+
+		// Skip the response line.
+		if (!chain.line(pos, line, length, scratch))
+			return false;
+
+		grow((chain.size() - pos) / 300, chain.size() - pos);
+
+		while (chain.line(pos, line, length, scratch)) {
+			// Found the terminator.
+			if (length == 1 && line[0] == '.')
+				return true;
+			parseline(line, line + length);
+		}
+
+		// The terminator was missing.
+		return false;
+	}
+
+	/**
+	 * Get a row.
+	 *
+	 * @public
+	 *
+	 * @param index = Position in the list.
+	 * @return The row, valid until the list changes.
+	 */
+	overviewrow overview::row(const unsigned long &index) const {
+		const entry &e = entries[index];
+		field *fields[columns];
+		overviewrow row;
+		fields[0] = &row.subject;
+		fields[1] = &row.from;
+		fields[2] = &row.date;
+		fields[3] = &row.messageid;
+		fields[4] = &row.references;
+		fields[5] = &row.xref;
+
+		row.number = e.number;
+		row.bytes = e.bytes;
+		row.lines = e.lines;
+		unsigned long offset = e.offset;
+		for (unsigned short i = 0; i < columns; i++) {
+			*fields[i] = strings.view(offset, e.lengths[i]);
+			offset += e.lengths[i];
+		}
+		return row;
+	}
+
+	/**
+	 * Remove every row from the list, keep the memory.
+	 *
+	 * @public
+	 */
+	void overview::clear() {
+		entries.clear();
+		strings.clear();
+	}
+
+	/**
+	 * Parse 1 overview line and add it to the list.
+	 *
+	 * @private
+	 *
+	 * @param     pos = Start of the line.
+	 * @param lineend = End of the line, without the CRLF.
+	 */
+	void overview::parseline(const char *pos, const char *lineend) {
+		// Remove the dot stuffing.
+		if (pos < lineend && pos[0] == '.')
+			pos++;
+
+		// Split the line on tabs, extra columns are ignored.
+		field split[9];
+		unsigned short found = 0;
+		while (found < 9) {
+			const char *tab = static_cast<const char *>(std::memchr(pos, '\t', lineend - pos));
+			if (tab == NULL)
+				tab = lineend;
+			split[found].data = pos;
+			split[found].length = tab - pos;
+			found++;
+			if (tab == lineend)
+				break;
+			pos = tab + 1;
+		}
+
+		// Not an overview line.
+		if (found < 8)
+			return;
+
+		overviewrow row;
+		row.number = std::strtoul(split[0].str().c_str(), NULL, 10);
+		row.subject = split[1];
+		row.from = split[2];
+		row.date = split[3];
+		row.messageid = split[4];
+		row.references = split[5];
+		row.bytes = std::strtoul(split[6].str().c_str(), NULL, 10);
+		row.lines = std::strtoul(split[7].str().c_str(), NULL, 10);
+		row.xref.data = lineend;
+		row.xref.length = 0;
+		if (found == 9) {
+			row.xref = split[8];
+			// Strip the header name, keep "server group:number ..."
+			if (row.xref.length > 6 && strncasecmp(row.xref.data, "Xref: ", 6) == 0) {
+				row.xref.data += 6;
+				row.xref.length -= 6;
+			}
+		}
+		add(row);
+	}
+
+	/**
+	 * Make room for more rows, at least doubling so merging many
+	 * responses into 1 list stays linear.
+	 *
+	 * @private
+	 *
+	 * @param  rows = Amount of rows to add.
+	 * @param chars = Amount of string chars to add.
+	 */
+	void overview::grow(const unsigned long &rows, const unsigned long &chars) {
+		const unsigned long need = entries.size() + rows;
+		if (entries.capacity() < need)
+			entries.reserve(std::max<unsigned long>(need, entries.capacity() * 2));
+		strings.reserve(strings.size() + chars);
+	}
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "bufferchain.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * 1 parsed XOVER/OVER line.
+	 *
+	 * @note The fields point into the storage the row came from
+	 * (an overview list or an overview database segment).
+	 */
+	struct overviewrow
+	{
+		unsigned long number;
+		field subject;
+		field from;
+		field date;
+		field messageid;
+		field references;
+		field xref;
+		unsigned long bytes;
+		unsigned long lines;
+	};
+
+	/**
+	 * List of overview rows parsed from XOVER/OVER responses.
+	 *
+	 * @note The string columns are stored back to back in an arena,
+	 * a row only holds the offsets and the numeric columns.
+	 */
+	class overview
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		overview();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~overview();
+
+		/**
+		 * Copy a row into the list.
+		 *
+		 * @public
+		 *
+		 * @param row = The row, the strings are copied into the arena.
+		 */
+		void add(const overviewrow &row);
+
+		/**
+		 * Copy every row of another list to the end of this one.
+		 *
+		 * @public
+		 *
+		 * @param other = The rows to copy.
+		 */
+		void add(const overview &other);
+
+		/**
+		 * Parse a XOVER/OVER response and add every line to the list.
+		 *
+		 * @note Only the default RFC3977 overview format is understood,
+		 * (number, subject, from, date, message-id, references, bytes,
+		 * lines, then optional xref).
+		 * @public
+		 *
+		 * @param finalbuffer = The response, including the response
+		 * line and the terminating .CRLF
+		 * @return       bool = Was the response well formed?
+		 */
+		bool parse(const std::string &finalbuffer);
+
+		/**
+		 * Parse a XOVER/OVER response held in a chain of blocks, see
+		 * parse above.
+		 *
+		 * @public
+		 *
+		 * @param chain = The response, including the response
+		 * line and the terminating .CRLF
+		 * @return bool = Was the response well formed?
+		 */
+		bool parse(const bufferchain &chain);
+
+		/**
+		 * Amount of rows in the list.
+		 *
+		 * @public
+		 */
+		unsigned long size() const {
+			return entries.size();
+		}
+
+		/**
+		 * Article number of a row.
+		 *
+		 * @public
+		 *
+		 * @param index = Position in the list.
+		 * @return The article number.
+		 */
+		unsigned long number(const unsigned long &index) const {
+			return entries[index].number;
+		}
+
+		/**
+		 * Get a row.
+		 *
+		 * @public
+		 *
+		 * @param index = Position in the list.
+		 * @return The row, valid until the list changes.
+		 */
+		overviewrow row(const unsigned long &index) const;
+
+		/**
+		 * Remove every row from the list, keep the memory.
+		 *
+		 * @public
+		 */
+		void clear();
+
+	private:
+		/**
+		 * Amount of string columns in a row.
+		 *
+		 * @private
+		 */
+		static const unsigned short columns = 6;
+
+		/**
+		 * A row, the strings live in the arena back to back in this
+		 * order: subject, from, date, message-id, references, xref.
+		 *
+		 * @private
+		 */
+		struct entry
+		{
+			unsigned long number;
+			unsigned long offset;
+			unsigned int lengths[columns];
+			unsigned long bytes;
+			unsigned long lines;
+		};
+
+		/**
+		 * The rows in the order they were added.
+		 *
+		 * @private
+		 */
+		std::vector<entry> entries;
+
+		/**
+		 * Storage for the string columns.
+		 *
+		 * @private
+		 */
+		arena strings;
+
+		/**
+		 * Parse 1 overview line and add it to the list.
+		 *
+		 * @private
+		 *
+		 * @param     pos = Start of the line.
+		 * @param lineend = End of the line, without the CRLF.
+		 */
+		void parseline(const char *pos, const char *lineend);
+
+		/**
+		 * Make room for more rows, at least doubling so merging many
+		 * responses into 1 list stays linear.
+		 *
+		 * @private
+		 *
+		 * @param  rows = Amount of rows to add.
+		 * @param chars = Amount of string chars to add.
+		 */
+		void grow(const unsigned long &rows, const unsigned long &chars);
+	};
+}
@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "overviewdb.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @note Creates the directory if needed and opens every segment.
+	 * @public
+	 *
+	 * @param      directory = Where the segments are stored
+	 * (example: /home/kevin/overview/alt.binaries.test).
+	 * @param      groupname = The name of the group.
+	 * @param rowspersegment = Rows per segment before a new one
+	 * is started.
+	 */
+	overviewdb::overviewdb(const std::string &directory, const std::string &groupname,
+			const unsigned long &rowspersegment)
+		: directory(directory), groupname(groupname),
+		  rowspersegment(rowspersegment ? rowspersegment : 1) {
+		static_assert(sizeof(record) == 48, "overviewdb records must be 48 bytes");
+
+		if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+			throw OverviewDBException("Unable to create " + directory);
+
+		open();
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @note Flushes the files.
+	 * @public
+	 */
+	overviewdb::~overviewdb() {
+		flush();
+	}
+
+	/**
+	 * Append a row.
+	 *
+	 * @public
+	 *
+	 * @param  row = The row to store.
+	 * @return bool = Was it stored? (False if it was older
+	 * than the newest stored row, filtered, or a crosspost.)
+	 */
+	bool overviewdb::append(const overviewrow &row) {
+		if (size() > begin() && row.number <= newest()) {
+			older++;
+			return false;
+		}
+
+		if (filter != NULL && filter->matches(row.subject) == exclude) {
+			dropped++;
+			return false;
+		}
+
+		// Crossposted, already stored with another group.
+		if (index != NULL && index->contains(row.messageid)) {
+			skipped++;
+			return false;
+		}
+
+		if (segments.back()->rows >= rowspersegment)
+			startsegment();
+
+		const field *fields[6] = {
+			&row.subject, &row.from, &row.date,
+			&row.messageid, &row.references, &row.xref
+		};
+
+		record r;
+		r.number = row.number;
+		r.offset = stringsize;
+		r.bytes = row.bytes;
+		r.lines = row.lines;
+		for (unsigned short i = 0; i < 6; i++) {
+			r.lengths[i] = fields[i]->length;
+			stringsout.write(fields[i]->data, fields[i]->length);
+			stringsize += fields[i]->length;
+		}
+		// The strings go first, so a record never points past the .str file.
+		columnsout.write(reinterpret_cast<const char *>(&r), sizeof(r));
+
+		segment &seg = *segments.back();
+		if (index != NULL) {
+			msgidlocation location;
+			location.group = indexgroup;
+			location.number = row.number;
+			location.row = seg.base + seg.rows;
+			index->insert(row.messageid, location);
+		}
+		if (seg.rows++ == 0)
+			seg.first = row.number;
+		seg.last = row.number;
+		return true;
+	}
+
+	/**
+	 * Append every row of a list.
+	 *
+	 * @public
+	 *
+	 * @param rows = The rows to store.
+	 * @return The amount of rows stored.
+	 */
+	unsigned long overviewdb::append(const overview &rows) {
+		unsigned long stored = 0;
+		for (unsigned long i = 0; i < rows.size(); i++) {
+			if (append(rows.row(i)))
+				stored++;
+		}
+		return stored;
+	}
+
+	/**
+	 * Set the message-id index that is updated on every append
+	 * and used to skip crossposts.
+	 *
+	 * @public
+	 *
+	 * @param index = The index, NULL to stop using it.
+	 */
+	void overviewdb::setindex(msgidindex *index) {
+		this->index = index;
+		if (index != NULL)
+			indexgroup = index->groupid(groupname);
+	}
+
+	/**
+	 * Amount of rows skipped because their message-id was
+	 * already in the index.
+	 *
+	 * @public
+	 */
+	unsigned long overviewdb::duplicates() const {
+		return skipped;
+	}
+
+	/**
+	 * Amount of rows skipped because they were not newer than
+	 * the newest stored row.
+	 *
+	 * @public
+	 */
+	unsigned long overviewdb::outoforder() const {
+		return older;
+	}
+
+	/**
+	 * Set the subject filter used to pick the rows to store.
+	 *
+	 * @public
+	 *
+	 * @param  filter = The filter, NULL to store every row.
+	 * @param exclude = Drop the rows matching the filter instead
+	 * of keeping only them.
+	 */
+	void overviewdb::setfilter(subjectfilter *filter, const bool &exclude) {
+		this->filter = filter;
+		this->exclude = exclude;
+	}
+
+	/**
+	 * Amount of rows dropped by the subject filter.
+	 *
+	 * @public
+	 */
+	unsigned long overviewdb::filtered() const {
+		return dropped;
+	}
+
+	/**
+	 * Find a row by article number.
+	 *
+	 * @public
+	 *
+	 * @param number = The article number.
+	 * @param    row = Where the row is stored, the strings point
+	 * into the mapped segment.
+	 * @return  bool = Was the article found?
+	 */
+	bool overviewdb::find(const unsigned long &number, overviewrow &row) {
+		unsigned long index;
+		if (!locate(number, index))
+			return false;
+
+		row = this->row(index);
+		return true;
+	}
+
+	/**
+	 * Find the position of a row by article number.
+	 *
+	 * @public
+	 *
+	 * @param number = The article number.
+	 * @param  index = Where the position is stored.
+	 * @return  bool = Was the article found?
+	 */
+	bool overviewdb::locate(const unsigned long &number, unsigned long &index) {
+		// Segments hold increasing, non overlapping ranges.
+		unsigned long low = 0, high = segments.size();
+		while (low < high) {
+			unsigned long middle = (low + high) / 2;
+			segment &seg = *segments[middle];
+			if (seg.rows == 0 || number < seg.first)
+				high = middle;
+			else if (number > seg.last)
+				low = middle + 1;
+			else {
+				// Binary search inside the segment.
+				unsigned long first = 0, last = seg.rows;
+				while (first < last) {
+					unsigned long pos = (first + last) / 2;
+					const uint64_t found = at(seg, pos).number;
+					if (found == number) {
+						index = seg.base + pos;
+						return true;
+					}
+					if (found < number)
+						first = pos + 1;
+					else
+						last = pos;
+				}
+				return false;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Get a row by position.
+	 *
+	 * @public
+	 *
+	 * @param index = Position of the row, from 0 to size() - 1.
+	 * @return The row, the strings point into the mapped segment.
+	 */
+	overviewrow overviewdb::row(const unsigned long &index) {
+		segment *seg = holding(index);
+		if (seg == NULL)
+			throw OverviewDBException("Row " + std::to_string(index) + " is not stored.");
+
+		const record &r = at(*seg, index - seg->base);
+		overviewrow row;
+		field *fields[6] = {
+			&row.subject, &row.from, &row.date,
+			&row.messageid, &row.references, &row.xref
+		};
+
+		row.number = r.number;
+		row.bytes = r.bytes;
+		row.lines = r.lines;
+		const char *strings = seg->strings.is_open() ? seg->strings.data() : "";
+		unsigned long offset = r.offset;
+		for (unsigned short i = 0; i < 6; i++) {
+			fields[i]->data = strings + offset;
+			fields[i]->length = r.lengths[i];
+			offset += r.lengths[i];
+		}
+		return row;
+	}
+
+	/**
+	 * Amount of rows in the store (including expired segments
+	 * that were already removed).
+	 *
+	 * @note Positions are never reused, so this is also the
+	 * position the next row will get.
+	 * @public
+	 */
+	unsigned long overviewdb::size() const {
+		return segments.back()->base + segments.back()->rows;
+	}
+
+	/**
+	 * Position of the oldest row still stored.
+	 *
+	 * @public
+	 */
+	unsigned long overviewdb::begin() const {
+		return segments.front()->base;
+	}
+
+	/**
+	 * Oldest stored article number, 0 if the store is empty.
+	 *
+	 * @public
+	 */
+	unsigned long overviewdb::oldest() const {
+		for (unsigned long i = 0; i < segments.size(); i++) {
+			if (segments[i]->rows > 0)
+				return segments[i]->first;
+		}
+		return 0;
+	}
+
+	/**
+	 * Newest stored article number, 0 if the store is empty.
+	 *
+	 * @public
+	 */
+	unsigned long overviewdb::newest() const {
+		for (unsigned long i = segments.size(); i > 0; i--) {
+			if (segments[i - 1]->rows > 0)
+				return segments[i - 1]->last;
+		}
+		return 0;
+	}
+
+	/**
+	 * The name of the group.
+	 *
+	 * @public
+	 */
+	const std::string &overviewdb::group() const {
+		return groupname;
+	}
+
+	/**
+	 * Remove the segments that only hold articles older
+	 * than the low-water mark.
+	 *
+	 * @note Their rows are removed from the message-id index too,
+	 * so later crossposts of those articles are stored again.
+	 * @public
+	 *
+	 * @param low = The oldest article the server still has.
+	 * @return The amount of segments removed.
+	 */
+	unsigned long overviewdb::expire(const unsigned long &low) {
+		unsigned long removed = 0;
+		// Never remove the segment we append to.
+		while (segments.size() > 1 && segments.front()->rows > 0
+				&& segments.front()->last < low) {
+			dropfront();
+			removed++;
+		}
+
+		if (removed > 0)
+			savemanifest();
+		return removed;
+	}
+
+	/**
+	 * Remove every segment and start over with an empty one,
+	 * used when the server renumbered the group.
+	 *
+	 * @note Positions are not reused, the next row gets size().
+	 * The rows are removed from the message-id index too.
+	 * @public
+	 *
+	 * @return The amount of segments removed.
+	 */
+	unsigned long overviewdb::reset() {
+		startsegment();
+		unsigned long removed = 0;
+		while (segments.size() > 1) {
+			dropfront();
+			removed++;
+		}
+		savemanifest();
+		return removed;
+	}
+
+	/**
+	 * Write buffered rows to the files.
+	 *
+	 * @public
+	 *
+	 * @return bool = Did it work?
+	 */
+	bool overviewdb::flush() {
+		// The strings go first, so a record never points past the .str file.
+		stringsout.flush();
+		columnsout.flush();
+		return stringsout.good() && columnsout.good();
+	}
+
+	/**
+	 * Path/file of a segment file.
+	 *
+	 * @private
+	 *
+	 * @param        id = The segment id.
+	 * @param extension = col or str.
+	 * @return The path.
+	 */
+	std::string overviewdb::path(const unsigned long &id, const std::string &extension) const {
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%08lu.", id);
+		return directory + name + extension;
+	}
+
+	/**
+	 * Open the existing segments.
+	 *
+	 * @private
+	 */
+	void overviewdb::open() {
+		// The manifest holds the id and first position of the oldest segment.
+		unsigned long id = 0;
+		{
+			std::ifstream manifest((directory + "/manifest").c_str());
+			if (manifest.is_open())
+				manifest >> id >> firstrow;
+		}
+
+		unsigned long base = firstrow;
+		struct stat info;
+		while (::stat(path(id, "col").c_str(), &info) == 0) {
+			std::unique_ptr<segment> seg(new segment());
+			seg->id = id;
+			seg->base = base;
+			seg->rows = info.st_size / sizeof(record);
+			seg->mappedrows = 0;
+			seg->first = seg->last = 0;
+
+			// Drop records that were only partly written, or whose
+			// strings did not make it to the disk.
+			struct stat strinfo;
+			unsigned long strsize = 0;
+			if (::stat(path(id, "str").c_str(), &strinfo) == 0)
+				strsize = strinfo.st_size;
+			map(*seg);
+			while (seg->rows > 0) {
+				const record &r = at(*seg, seg->rows - 1);
+				unsigned long end = r.offset;
+				for (unsigned short i = 0; i < 6; i++)
+					end += r.lengths[i];
+				if (end <= strsize)
+					break;
+				seg->rows--;
+			}
+			if (static_cast<unsigned long>(info.st_size) != seg->rows * sizeof(record)) {
+				seg->columns.close();
+				if (::truncate(path(id, "col").c_str(), seg->rows * sizeof(record)) != 0)
+					throw OverviewDBException("Unable to repair " + path(id, "col"));
+				map(*seg);
+			}
+
+			base += seg->rows;
+			segments.push_back(std::move(seg));
+			id++;
+		}
+
+		if (segments.empty()) {
+			// startsegment numbers the segment after the newest one.
+			std::unique_ptr<segment> seg(new segment());
+			seg->id = id;
+			seg->base = firstrow;
+			seg->rows = seg->mappedrows = seg->first = seg->last = 0;
+			segments.push_back(std::move(seg));
+			columnsout.open(path(id, "col").c_str(), std::ios::binary | std::ios::trunc);
+			stringsout.open(path(id, "str").c_str(), std::ios::binary | std::ios::trunc);
+			columnsout.close();
+			stringsout.close();
+			savemanifest();
+		}
+		openappend();
+	}
+
+	/**
+	 * Map (or map again) a segment.
+	 *
+	 * @private
+	 *
+	 * @param seg = The segment.
+	 */
+	void overviewdb::map(segment &seg) {
+		seg.columns.close();
+		seg.strings.close();
+		seg.mappedrows = 0;
+		if (seg.rows == 0)
+			return;
+
+		try {
+			seg.columns.open(path(seg.id, "col"));
+			seg.mappedrows = std::min<unsigned long>(seg.rows,
+					seg.columns.size() / sizeof(record));
+
+			struct stat info;
+			if (::stat(path(seg.id, "str").c_str(), &info) == 0 && info.st_size > 0)
+				seg.strings.open(path(seg.id, "str"));
+		} catch (const std::exception &e) {
+			throw OverviewDBException(e.what());
+		}
+
+		const record *records = reinterpret_cast<const record *>(seg.columns.data());
+		if (seg.mappedrows > 0) {
+			seg.first = records[0].number;
+			seg.last = records[seg.mappedrows - 1].number;
+		}
+	}
+
+	/**
+	 * Start a new segment and open its files for appending.
+	 *
+	 * @private
+	 */
+	void overviewdb::startsegment() {
+		flush();
+		const segment &previous = *segments.back();
+		std::unique_ptr<segment> seg(new segment());
+		seg->id = previous.id + 1;
+		seg->base = previous.base + previous.rows;
+		seg->rows = seg->mappedrows = seg->first = seg->last = 0;
+		segments.push_back(std::move(seg));
+		openappend();
+	}
+
+	/**
+	 * Open the newest segment's files for appending.
+	 *
+	 * @private
+	 */
+	void overviewdb::openappend() {
+		const segment &seg = *segments.back();
+		columnsout.close();
+		stringsout.close();
+		columnsout.clear();
+		stringsout.clear();
+		columnsout.open(path(seg.id, "col").c_str(), std::ios::binary | std::ios::app);
+		stringsout.open(path(seg.id, "str").c_str(), std::ios::binary | std::ios::app);
+		if (!columnsout.is_open() || !stringsout.is_open())
+			throw OverviewDBException("Unable to open segment " + path(seg.id, "col"));
+
+		struct stat info;
+		stringsize = 0;
+		if (::stat(path(seg.id, "str").c_str(), &info) == 0)
+			stringsize = info.st_size;
+	}
+
+	/**
+	 * Write the id of the oldest segment.
+	 *
+	 * @private
+	 *
+	 * @return bool = Did it work?
+	 */
+	bool overviewdb::savemanifest() {
+		const std::string manifest = directory + "/manifest";
+		{
+			std::ofstream file((manifest + ".tmp").c_str(), std::ios::trunc);
+			if (!file.is_open())
+				return false;
+			file << segments.front()->id << ' ' << segments.front()->base << '\n';
+			file.flush();
+			if (!file.good())
+				return false;
+		}
+		return std::rename((manifest + ".tmp").c_str(), manifest.c_str()) == 0;
+	}
+
+	/**
+	 * Remove the oldest segment, its files and its rows in the
+	 * message-id index.
+	 *
+	 * @private
+	 */
+	void overviewdb::dropfront() {
+		segment &seg = *segments.front();
+		if (index != NULL) {
+			msgidlocation location;
+			for (unsigned long i = seg.base; i < seg.base + seg.rows; i++) {
+				const overviewrow r = row(i);
+				// Only the rows this group put in the index.
+				if (index->find(r.messageid, location)
+						&& location.group == indexgroup && location.row == i)
+					index->erase(r.messageid);
+			}
+		}
+		seg.columns.close();
+		seg.strings.close();
+		std::remove(path(seg.id, "col").c_str());
+		std::remove(path(seg.id, "str").c_str());
+		segments.erase(segments.begin());
+	}
+
+	/**
+	 * Get a record, mapping the segment again if rows were
+	 * appended to it since it was mapped.
+	 *
+	 * @private
+	 *
+	 * @param   seg = The segment.
+	 * @param local = Position of the record in the segment.
+	 * @return The record.
+	 */
+	const overviewdb::record &overviewdb::at(segment &seg, const unsigned long &local) {
+		if (local >= seg.mappedrows) {
+			flush();
+			map(seg);
+			if (local >= seg.mappedrows)
+				throw OverviewDBException("Segment " + path(seg.id, "col") + " is truncated.");
+		}
+		return reinterpret_cast<const record *>(seg.columns.data())[local];
+	}
+
+	/**
+	 * Find the segment holding a position.
+	 *
+	 * @private
+	 *
+	 * @param index = The position.
+	 * @return The segment, NULL if the position is not stored.
+	 */
+	overviewdb::segment *overviewdb::holding(const unsigned long &index) {
+		unsigned long low = 0, high = segments.size();
+		while (low < high) {
+			unsigned long middle = (low + high) / 2;
+			segment &seg = *segments[middle];
+			if (index < seg.base)
+				high = middle;
+			else if (index >= seg.base + seg.rows)
+				low = middle + 1;
+			else
+				return &seg;
+		}
+		return NULL;
+	}
+}
@@ -0,0 +1,455 @@
+#pragma once
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "msgidindex.hpp"
+#include "overview.hpp"
+#include "subjectfilter.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Append only on-disk store for the overview of 1 group.
+	 *
+	 * @note Rows are stored in segments, each segment is 2 files in
+	 * the directory: NNNNNNNN.col holds fixed width records (article
+	 * number, numeric columns, offset and lengths of the strings) and
+	 * NNNNNNNN.str holds the strings back to back. Both are mapped in
+	 * memory for reading, opening the store only looks at the first and
+	 * last record of each segment, so it costs the same for a thousand
+	 * rows or a billion.
+	 * Rows must be appended in increasing article number order, rows
+	 * older than the newest stored row are skipped (see outoforder,
+	 * and reset for a renumbered group). When a message-id
+	 * index is set, rows already in the index (crossposts stored with
+	 * another group) are skipped too. When a subject filter is set,
+	 * rows are kept or dropped by their subject before anything else.
+	 * Not thread safe.
+	 */
+	class overviewdb
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @note Creates the directory if needed and opens every segment.
+		 * @public
+		 *
+		 * @param      directory = Where the segments are stored
+		 * (example: /home/kevin/overview/alt.binaries.test).
+		 * @param      groupname = The name of the group.
+		 * @param rowspersegment = Rows per segment before a new one
+		 * is started.
+		 */
+		overviewdb(const std::string &directory, const std::string &groupname,
+				const unsigned long &rowspersegment = 1048576);
+
+		/**
+		 * Destructor.
+		 *
+		 * @note Flushes the files.
+		 * @public
+		 */
+		~overviewdb();
+
+		/**
+		 * Append a row.
+		 *
+		 * @public
+		 *
+		 * @param  row = The row to store.
+		 * @return bool = Was it stored? (False if it was older
+		 * than the newest stored row, filtered, or a crosspost.)
+		 */
+		bool append(const overviewrow &row);
+
+		/**
+		 * Append every row of a list.
+		 *
+		 * @public
+		 *
+		 * @param rows = The rows to store.
+		 * @return The amount of rows stored.
+		 */
+		unsigned long append(const overview &rows);
+
+		/**
+		 * Set the message-id index that is updated on every append
+		 * and used to skip crossposts.
+		 *
+		 * @public
+		 *
+		 * @param index = The index, NULL to stop using it.
+		 */
+		void setindex(msgidindex *index);
+
+		/**
+		 * Amount of rows skipped because their message-id was
+		 * already in the index.
+		 *
+		 * @public
+		 */
+		unsigned long duplicates() const;
+
+		/**
+		 * Amount of rows skipped because they were not newer than
+		 * the newest stored row.
+		 *
+		 * @public
+		 */
+		unsigned long outoforder() const;
+
+		/**
+		 * Set the subject filter used to pick the rows to store.
+		 *
+		 * @public
+		 *
+		 * @param  filter = The filter, NULL to store every row.
+		 * @param exclude = Drop the rows matching the filter instead
+		 * of keeping only them.
+		 */
+		void setfilter(subjectfilter *filter, const bool &exclude = false);
+
+		/**
+		 * Amount of rows dropped by the subject filter.
+		 *
+		 * @public
+		 */
+		unsigned long filtered() const;
+
+		/**
+		 * Find a row by article number.
+		 *
+		 * @public
+		 *
+		 * @param number = The article number.
+		 * @param    row = Where the row is stored, the strings point
+		 * into the mapped segment.
+		 * @return  bool = Was the article found?
+		 */
+		bool find(const unsigned long &number, overviewrow &row);
+
+		/**
+		 * Find the position of a row by article number.
+		 *
+		 * @public
+		 *
+		 * @param number = The article number.
+		 * @param  index = Where the position is stored.
+		 * @return  bool = Was the article found?
+		 */
+		bool locate(const unsigned long &number, unsigned long &index);
+
+		/**
+		 * Get a row by position.
+		 *
+		 * @public
+		 *
+		 * @param index = Position of the row, from 0 to size() - 1.
+		 * @return The row, the strings point into the mapped segment.
+		 */
+		overviewrow row(const unsigned long &index);
+
+		/**
+		 * Amount of rows in the store (including expired segments
+		 * that were already removed).
+		 *
+		 * @note Positions are never reused, so this is also the
+		 * position the next row will get.
+		 * @public
+		 */
+		unsigned long size() const;
+
+		/**
+		 * Position of the oldest row still stored.
+		 *
+		 * @public
+		 */
+		unsigned long begin() const;
+
+		/**
+		 * Oldest stored article number, 0 if the store is empty.
+		 *
+		 * @public
+		 */
+		unsigned long oldest() const;
+
+		/**
+		 * Newest stored article number, 0 if the store is empty.
+		 *
+		 * @public
+		 */
+		unsigned long newest() const;
+
+		/**
+		 * The name of the group.
+		 *
+		 * @public
+		 */
+		const std::string &group() const;
+
+		/**
+		 * Remove the segments that only hold articles older
+		 * than the low-water mark.
+		 *
+		 * @note Their rows are removed from the message-id index too,
+		 * so later crossposts of those articles are stored again.
+		 * @public
+		 *
+		 * @param low = The oldest article the server still has.
+		 * @return The amount of segments removed.
+		 */
+		unsigned long expire(const unsigned long &low);
+
+		/**
+		 * Remove every segment and start over with an empty one,
+		 * used when the server renumbered the group.
+		 *
+		 * @note Positions are not reused, the next row gets size().
+		 * The rows are removed from the message-id index too.
+		 * @public
+		 *
+		 * @return The amount of segments removed.
+		 */
+		unsigned long reset();
+
+		/**
+		 * Write buffered rows to the files.
+		 *
+		 * @public
+		 *
+		 * @return bool = Did it work?
+		 */
+		bool flush();
+
+	private:
+		/**
+		 * A record in a .col file.
+		 *
+		 * @private
+		 */
+		struct record
+		{
+			uint64_t number;
+			uint64_t offset;
+			uint32_t lengths[6];
+			uint32_t bytes;
+			uint32_t lines;
+		};
+
+		/**
+		 * A segment (a .col and .str pair).
+		 *
+		 * @private
+		 */
+		struct segment
+		{
+			unsigned long id;
+			unsigned long base;
+			unsigned long rows;
+			unsigned long mappedrows;
+			unsigned long first;
+			unsigned long last;
+			boost::iostreams::mapped_file_source columns;
+			boost::iostreams::mapped_file_source strings;
+		};
+
+		/**
+		 * Where the segments are stored.
+		 *
+		 * @private
+		 */
+		std::string directory;
+
+		/**
+		 * The name of the group.
+		 *
+		 * @private
+		 */
+		std::string groupname;
+
+		/**
+		 * Rows per segment before a new one is started.
+		 *
+		 * @private
+		 */
+		unsigned long rowspersegment;
+
+		/**
+		 * Every segment from oldest to newest.
+		 *
+		 * @private
+		 */
+		std::vector<std::unique_ptr<segment> > segments;
+
+		/**
+		 * Position of the first row of the oldest segment.
+		 *
+		 * @private
+		 */
+		unsigned long firstrow = 0;
+
+		/**
+		 * The message-id index, NULL if not used.
+		 *
+		 * @private
+		 */
+		msgidindex *index = NULL;
+
+		/**
+		 * Id of this group in the message-id index.
+		 *
+		 * @private
+		 */
+		unsigned int indexgroup = 0;
+
+		/**
+		 * Amount of rows skipped as crossposts.
+		 *
+		 * @private
+		 */
+		unsigned long skipped = 0;
+
+		/**
+		 * Amount of rows skipped as older than the newest row.
+		 *
+		 * @private
+		 */
+		unsigned long older = 0;
+
+		/**
+		 * The subject filter, NULL if not used.
+		 *
+		 * @private
+		 */
+		subjectfilter *filter = NULL;
+
+		/**
+		 * Drop the rows matching the filter instead of keeping them?
+		 *
+		 * @private
+		 */
+		bool exclude = false;
+
+		/**
+		 * Amount of rows dropped by the subject filter.
+		 *
+		 * @private
+		 */
+		unsigned long dropped = 0;
+
+		/**
+		 * The .col file of the newest segment, open for appending.
+		 *
+		 * @private
+		 */
+		std::ofstream columnsout;
+
+		/**
+		 * The .str file of the newest segment, open for appending.
+		 *
+		 * @private
+		 */
+		std::ofstream stringsout;
+
+		/**
+		 * Size of the .str file of the newest segment.
+		 *
+		 * @private
+		 */
+		unsigned long stringsize = 0;
+
+		/**
+		 * Path/file of a segment file.
+		 *
+		 * @private
+		 *
+		 * @param        id = The segment id.
+		 * @param extension = col or str.
+		 * @return The path.
+		 */
+		std::string path(const unsigned long &id, const std::string &extension) const;
+
+		/**
+		 * Open the existing segments.
+		 *
+		 * @private
+		 */
+		void open();
+
+		/**
+		 * Map (or map again) a segment.
+		 *
+		 * @private
+		 *
+		 * @param seg = The segment.
+		 */
+		void map(segment &seg);
+
+		/**
+		 * Start a new segment and open its files for appending.
+		 *
+		 * @private
+		 */
+		void startsegment();
+
+		/**
+		 * Open the newest segment's files for appending.
+		 *
+		 * @private
+		 */
+		void openappend();
+
+		/**
+		 * Write the id of the oldest segment.
+		 *
+		 * @private
+		 *
+		 * @return bool = Did it work?
+		 */
+		bool savemanifest();
+
+		/**
+		 * Remove the oldest segment, its files and its rows in the
+		 * message-id index.
+		 *
+		 * @private
+		 */
+		void dropfront();
+
+		/**
+		 * Get a record, mapping the segment again if rows were
+		 * appended to it since it was mapped.
+		 *
+		 * @private
+		 *
+		 * @param   seg = The segment.
+		 * @param local = Position of the record in the segment.
+		 * @return The record.
+		 */
+		const record &at(segment &seg, const unsigned long &local);
+
+		/**
+		 * Find the segment holding a position.
+		 *
+		 * @private
+		 *
+		 * @param index = The position.
+		 * @return The segment, NULL if the position is not stored.
+		 */
+		segment *holding(const unsigned long &index);
+	};
+
+	/**
+	 * Exceptions for class overviewdb.
+	 */
+	class OverviewDBException : public std::runtime_error
+	{
+		public: OverviewDBException(const std::string& error) : runtime_error(error) {
+		}
+	};
+}
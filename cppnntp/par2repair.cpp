@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <openssl/evp.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+#include "gf16.hpp"
+#include "par2repair.hpp"
+namespace cppnntp {
+	/**
+	 * Slices read before they are multiplied, per batch.
+	 */
+	static const unsigned long BATCH = 64;
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param     set = The PAR2 set, with its recovery slices.
+	 * @param    path = Gives the path/file of a file name.
+	 * @param threads = Amount of threads, 0 for 1 per CPU.
+	 */
+	par2repair::par2repair(const par2set &set, const std::function<std::string(const std::string &)> &path,
+			const unsigned short &threads)
+		: set(set), path(path), threads(threads) {
+		if (this->threads == 0)
+			this->threads = std::max(1U, std::thread::hardware_concurrency());
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	par2repair::~par2repair() {}
+
+	/**
+	 * Rebuild the damaged slices and write them to the files.
+	 *
+	 * @note Slices past the end of a file (or all of a missing
+	 * file) are rebuilt too. Fails when a file of the set has no
+	 * description (see par2set::complete).
+	 * @public
+	 *
+	 * @param damaged = Positions of the damaged slices, by file
+	 * name (see par2verifier::damaged).
+	 * @return   bool = Was every slice rebuilt, and do the
+	 * CRC32s match?
+	 */
+	bool par2repair::repair(const std::map<std::string, std::vector<unsigned long> > &damaged) {
+		const std::vector<par2file> &files = set.files();
+		const unsigned long size = set.slicesize();
+		required = 0;
+		// The slices are numbered over every file of the main packet.
+		if (size == 0 || !set.complete())
+			return false;
+
+		// Every slice of the set has a position, the missing ones are
+		// marked by position, and by file and slice.
+		std::vector<unsigned long> first(files.size());
+		std::vector<bool> lost;
+		std::vector<std::pair<unsigned long, unsigned long> > missing;
+		for (unsigned long f = 0; f < files.size(); f++) {
+			const unsigned long count = (files[f].length + size - 1) / size;
+			first[f] = lost.size();
+			lost.resize(lost.size() + count, false);
+
+			std::map<std::string, std::vector<unsigned long> >::const_iterator it = damaged.find(files[f].name);
+			if (it != damaged.end()) {
+				for (unsigned long i = 0; i < it->second.size(); i++) {
+					if (it->second[i] < count)
+						lost[first[f] + it->second[i]] = true;
+				}
+			}
+			struct stat info;
+			const unsigned long present = ::stat(path(files[f].name).c_str(), &info) == 0 ? info.st_size : 0;
+			for (unsigned long s = 0; s < count; s++) {
+				if (std::min((s + 1) * size, files[f].length) > present)
+					lost[first[f] + s] = true;
+			}
+			for (unsigned long s = 0; s < count; s++) {
+				if (lost[first[f] + s])
+					missing.push_back(std::make_pair(f, s));
+			}
+		}
+		required = missing.size();
+		if (missing.empty())
+			return true;
+		// PAR2 has 32768 constants.
+		if (lost.size() > 32768)
+			return false;
+
+		// The constant of slice i is 2^n, n being the i-th number not
+		// divisible by 3, 5, 17 or 257.
+		std::vector<uint16_t> constants;
+		for (unsigned long n = 0; constants.size() < lost.size(); n++) {
+			if (n % 3 != 0 && n % 5 != 0 && n % 17 != 0 && n % 257 != 0)
+				constants.push_back(gf16::exp(n));
+		}
+
+		// Read as many recovery slices as slices are missing.
+		const unsigned long m = missing.size();
+		std::vector<std::vector<unsigned char> > recovery;
+		std::vector<unsigned int> exponents;
+		const std::vector<par2recovery> &slices = set.recovery();
+		for (unsigned long i = 0; i < slices.size() && recovery.size() < m; i++) {
+			std::vector<unsigned char> data;
+			if (slices[i].length == size && read(slices[i], data)) {
+				recovery.push_back(std::vector<unsigned char>());
+				recovery.back().swap(data);
+				exponents.push_back(slices[i].exponent);
+			}
+		}
+		if (recovery.size() < m)
+			return false;
+
+		// Row j holds the constants of the missing slices to the
+		// exponent of recovery slice j.
+		std::vector<uint16_t> matrix(m * m);
+		for (unsigned long j = 0; j < m; j++) {
+			for (unsigned long k = 0; k < m; k++)
+				matrix[j * m + k] = gf16::power(constants[first[missing[k].first] + missing[k].second], exponents[j]);
+		}
+		if (!invert(matrix, m))
+			return false;
+
+		// Missing slice k = sum over j of inverse[k][j] * (recovery
+		// slice j + the good slices times their constant to exponent j).
+		std::vector<std::vector<unsigned char> > outputs(m, std::vector<unsigned char>(size, 0));
+		std::vector<const unsigned char *> inputs;
+		std::vector<std::vector<uint16_t> > factors;
+		for (unsigned long j = 0; j < m; j++) {
+			inputs.push_back(recovery[j].data());
+			factors.push_back(std::vector<uint16_t>(m));
+			for (unsigned long k = 0; k < m; k++)
+				factors.back()[k] = matrix[k * m + j];
+		}
+		accumulate(inputs, factors, outputs);
+		std::vector<std::vector<unsigned char> >().swap(recovery);
+
+		std::vector<std::vector<unsigned char> > buffers(BATCH, std::vector<unsigned char>(size));
+		std::vector<uint16_t> powers(m);
+		inputs.clear();
+		factors.clear();
+		for (unsigned long f = 0; f < files.size(); f++) {
+			std::ifstream file(path(files[f].name).c_str(), std::ios::binary);
+			const unsigned long count = (files[f].length + size - 1) / size;
+			for (unsigned long s = 0; s < count; s++) {
+				const unsigned long i = first[f] + s;
+				if (lost[i])
+					continue;
+
+				// The last slice is padded with zeros.
+				std::vector<unsigned char> &buffer = buffers[inputs.size()];
+				const unsigned long length = std::min(size, files[f].length - s * size);
+				file.seekg(s * size);
+				if (!file.read(reinterpret_cast<char *>(buffer.data()), length))
+					return false;
+				std::fill(buffer.begin() + length, buffer.end(), 0);
+
+				for (unsigned long j = 0; j < m; j++)
+					powers[j] = gf16::power(constants[i], exponents[j]);
+				inputs.push_back(buffer.data());
+				factors.push_back(std::vector<uint16_t>(m, 0));
+				for (unsigned long k = 0; k < m; k++) {
+					uint16_t factor = 0;
+					for (unsigned long j = 0; j < m; j++)
+						factor ^= gf16::multiply(matrix[k * m + j], powers[j]);
+					factors.back()[k] = factor;
+				}
+				if (inputs.size() == BATCH) {
+					accumulate(inputs, factors, outputs);
+					inputs.clear();
+					factors.clear();
+				}
+			}
+		}
+		if (!inputs.empty())
+			accumulate(inputs, factors, outputs);
+
+		// Write the rebuilt slices, checked with their CRC32.
+		bool ok = true;
+		for (unsigned long k = 0; k < m; k++) {
+			const par2file &f = files[missing[k].first];
+			const unsigned long s = missing[k].second;
+			if (!f.crcs.empty() && crc32(0, outputs[k].data(), size) != f.crcs[s]) {
+				ok = false;
+				continue;
+			}
+
+			const int fd = ::open(path(f.name).c_str(), O_WRONLY | O_CREAT, 0644);
+			if (fd < 0) {
+				ok = false;
+				continue;
+			}
+			const unsigned long length = std::min(size, f.length - s * size);
+			unsigned long done = 0;
+			while (done < length) {
+				const ssize_t written = ::pwrite(fd, outputs[k].data() + done, length - done, s * size + done);
+				if (written <= 0)
+					break;
+				done += written;
+			}
+			if (done < length || ::ftruncate(fd, f.length) != 0)
+				ok = false;
+			::close(fd);
+		}
+		return ok;
+	}
+
+	/**
+	 * Amount of recovery slices the last repair needed.
+	 *
+	 * @public
+	 */
+	unsigned long par2repair::needed() const {
+		return required;
+	}
+
+	/**
+	 * Read a recovery slice and check its MD5.
+	 *
+	 * @private
+	 *
+	 * @param slice = The slice.
+	 * @param  data = Where the data is stored.
+	 * @return bool = Was it read, and does the MD5 match?
+	 */
+	bool par2repair::read(const par2recovery &slice, std::vector<unsigned char> &data) const {
+		std::ifstream file(slice.path.c_str(), std::ios::binary);
+		data.resize(slice.length);
+		if (!file.seekg(slice.offset) || !file.read(reinterpret_cast<char *>(data.data()), data.size()))
+			return false;
+
+		// The MD5 covers the set id, the type, the exponent and the data.
+		const unsigned char exponent[4] = {
+			static_cast<unsigned char>(slice.exponent), static_cast<unsigned char>(slice.exponent >> 8),
+			static_cast<unsigned char>(slice.exponent >> 16), static_cast<unsigned char>(slice.exponent >> 24)
+		};
+		unsigned char digest[EVP_MAX_MD_SIZE];
+		unsigned int length = 0;
+		EVP_MD_CTX *context = EVP_MD_CTX_new();
+		const bool ok = context != NULL
+			&& EVP_DigestInit_ex(context, EVP_md5(), NULL) == 1
+			&& EVP_DigestUpdate(context, slice.header.data(), slice.header.size()) == 1
+			&& EVP_DigestUpdate(context, exponent, 4) == 1
+			&& EVP_DigestUpdate(context, data.data(), data.size()) == 1
+			&& EVP_DigestFinal_ex(context, digest, &length) == 1
+			&& length == 16 && slice.md5.compare(0, 16, reinterpret_cast<const char *>(digest), 16) == 0;
+		EVP_MD_CTX_free(context);
+		return ok;
+	}
+
+	/**
+	 * Invert a square matrix.
+	 *
+	 * @private
+	 *
+	 * @param matrix = The matrix, by rows, replaced by its inverse.
+	 * @param   size = Amount of rows.
+	 * @return  bool = Could it be inverted?
+	 */
+	bool par2repair::invert(std::vector<uint16_t> &matrix, const unsigned long &size) {
+		// Gauss-Jordan, the identity becomes the inverse.
+		std::vector<uint16_t> inverse(size * size, 0);
+		for (unsigned long i = 0; i < size; i++)
+			inverse[i * size + i] = 1;
+
+		for (unsigned long column = 0; column < size; column++) {
+			unsigned long pivot = column;
+			while (pivot < size && matrix[pivot * size + column] == 0)
+				pivot++;
+			if (pivot == size)
+				return false;
+			if (pivot != column) {
+				std::swap_ranges(matrix.begin() + pivot * size, matrix.begin() + (pivot + 1) * size,
+					matrix.begin() + column * size);
+				std::swap_ranges(inverse.begin() + pivot * size, inverse.begin() + (pivot + 1) * size,
+					inverse.begin() + column * size);
+			}
+
+			const uint16_t divisor = matrix[column * size + column];
+			for (unsigned long k = 0; k < size; k++) {
+				matrix[column * size + k] = gf16::divide(matrix[column * size + k], divisor);
+				inverse[column * size + k] = gf16::divide(inverse[column * size + k], divisor);
+			}
+			for (unsigned long row = 0; row < size; row++) {
+				const uint16_t factor = matrix[row * size + column];
+				if (row == column || factor == 0)
+					continue;
+				for (unsigned long k = 0; k < size; k++) {
+					matrix[row * size + k] ^= gf16::multiply(factor, matrix[column * size + k]);
+					inverse[row * size + k] ^= gf16::multiply(factor, inverse[column * size + k]);
+				}
+			}
+		}
+		matrix.swap(inverse);
+		return true;
+	}
+
+	/**
+	 * Multiply slices into the rebuilt slices, over the threads.
+	 *
+	 * @private
+	 *
+	 * @param  inputs = The slices.
+	 * @param factors = For each slice, its factor for each output.
+	 * @param outputs = The rebuilt slices.
+	 */
+	void par2repair::accumulate(const std::vector<const unsigned char *> &inputs,
+			const std::vector<std::vector<uint16_t> > &factors,
+			std::vector<std::vector<unsigned char> > &outputs) const {
+		// Each thread owns a byte range of every output, ranges are a
+		// multiple of 64 bytes (the AVX2 step) and at least 64KB.
+		const unsigned long size = set.slicesize();
+		unsigned long range = (size + threads - 1) / threads;
+		range = std::max(65536UL, (range + 63) / 64 * 64);
+
+		std::vector<std::thread> pool;
+		for (unsigned long start = 0; start < size; start += range) {
+			pool.push_back(std::thread([&inputs, &factors, &outputs, start, range, size]() {
+				const unsigned long length = std::min(range, size - start);
+				for (unsigned long i = 0; i < inputs.size(); i++) {
+					for (unsigned long k = 0; k < outputs.size(); k++)
+						gf16::multiplyadd(factors[i][k], inputs[i] + start, outputs[k].data() + start, length);
+				}
+			}));
+		}
+		for (unsigned long i = 0; i < pool.size(); i++)
+			pool[i].join();
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "par2set.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Rebuilds damaged PAR2 slices from the recovery slices of the set.
+	 *
+	 * @note Reed-Solomon over GF(2^16) as the PAR2 spec defines it: the
+	 * matrix of the damaged slices is inverted, then every slice that
+	 * is still good and every recovery slice used is read once and
+	 * multiplied into all the rebuilt slices (see gf16::multiplyadd).
+	 * The slices are split in byte ranges, 1 per thread. Memory used
+	 * is about 2 slices per damaged slice, plus 64 slices being read.
+	 */
+	class par2repair
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param     set = The PAR2 set, with its recovery slices.
+		 * @param    path = Gives the path/file of a file name.
+		 * @param threads = Amount of threads, 0 for 1 per CPU.
+		 */
+		par2repair(const par2set &set, const std::function<std::string(const std::string &)> &path,
+				const unsigned short &threads = 0);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~par2repair();
+
+		/**
+		 * Rebuild the damaged slices and write them to the files.
+		 *
+		 * @note Slices past the end of a file (or all of a missing
+		 * file) are rebuilt too. Fails when a file of the set has no
+		 * description (see par2set::complete).
+		 * @public
+		 *
+		 * @param damaged = Positions of the damaged slices, by file
+		 * name (see par2verifier::damaged).
+		 * @return   bool = Was every slice rebuilt, and do the
+		 * CRC32s match?
+		 */
+		bool repair(const std::map<std::string, std::vector<unsigned long> > &damaged);
+
+		/**
+		 * Amount of recovery slices the last repair needed.
+		 *
+		 * @public
+		 */
+		unsigned long needed() const;
+
+	private:
+		/**
+		 * The PAR2 set.
+		 *
+		 * @private
+		 */
+		const par2set &set;
+
+		/**
+		 * Gives the path/file of a file name.
+		 *
+		 * @private
+		 */
+		std::function<std::string(const std::string &)> path;
+
+		/**
+		 * Amount of threads.
+		 *
+		 * @private
+		 */
+		unsigned short threads;
+
+		/**
+		 * Recovery slices the last repair needed.
+		 *
+		 * @private
+		 */
+		unsigned long required = 0;
+
+		/**
+		 * Read a recovery slice and check its MD5.
+		 *
+		 * @private
+		 *
+		 * @param slice = The slice.
+		 * @param  data = Where the data is stored.
+		 * @return bool = Was it read, and does the MD5 match?
+		 */
+		bool read(const par2recovery &slice, std::vector<unsigned char> &data) const;
+
+		/**
+		 * Invert a square matrix.
+		 *
+		 * @private
+		 *
+		 * @param matrix = The matrix, by rows, replaced by its inverse.
+		 * @param   size = Amount of rows.
+		 * @return  bool = Could it be inverted?
+		 */
+		static bool invert(std::vector<uint16_t> &matrix, const unsigned long &size);
+
+		/**
+		 * Multiply slices into the rebuilt slices, over the threads.
+		 *
+		 * @private
+		 *
+		 * @param  inputs = The slices.
+		 * @param factors = For each slice, its factor for each output.
+		 * @param outputs = The rebuilt slices.
+		 */
+		void accumulate(const std::vector<const unsigned char *> &inputs,
+				const std::vector<std::vector<uint16_t> > &factors,
+				std::vector<std::vector<unsigned char> > &outputs) const;
+	};
+}
@@ -0,0 +1,245 @@
+#include <cstring>
+#include <fstream>
+#include <openssl/evp.h>
+#include "par2set.hpp"
+namespace cppnntp {
+	/**
+	 * Read a little endian number.
+	 *
+	 * @param  data = Where it is.
+	 * @param bytes = Its size, 4 or 8.
+	 * @return The number.
+	 */
+	static uint64_t littleendian(const unsigned char *data, const unsigned short &bytes) {
+		uint64_t value = 0;
+		for (unsigned short i = bytes; i > 0; i--)
+			value = (value << 8) | data[i - 1];
+		return value;
+	}
+
+	/**
+	 * Packet types.
+	 */
+	static const std::string MAIN("PAR 2.0\0Main\0\0\0\0", 16);
+	static const std::string FILEDESC("PAR 2.0\0FileDesc", 16);
+	static const std::string IFSC("PAR 2.0\0IFSC\0\0\0\0", 16);
+	static const std::string RECVSLIC("PAR 2.0\0RecvSlic", 16);
+
+	/**
+	 * Largest packet read, the slice checksums of 32768 slices fit.
+	 */
+	static const unsigned long MAXPACKET = 16777216;
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	par2set::par2set() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	par2set::~par2set() {}
+
+	/**
+	 * Read the packets of a PAR2 file.
+	 *
+	 * @public
+	 *
+	 * @param path = Path/file of the PAR2 file.
+	 * @return bool = Is the set usable (main packet read)?
+	 */
+	bool par2set::load(const std::string &path) {
+		std::ifstream file(path.c_str(), std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		EVP_MD_CTX *context = EVP_MD_CTX_new();
+		if (context == NULL)
+			return false;
+
+		unsigned char header[64];
+		std::vector<unsigned char> body;
+		std::streamoff at = 0;
+		while (file.seekg(at) && file.read(reinterpret_cast<char *>(header), 64)) {
+			const uint64_t length = littleendian(header + 8, 8);
+			if (std::memcmp(header, "PAR2\0PKT", 8) != 0 || length < 64 || length % 4 != 0) {
+				// Damaged data, look for the next packet.
+				const void *next = std::memchr(header + 1, 'P', 63);
+				at += next == NULL ? 64 : static_cast<const unsigned char *>(next) - header;
+				continue;
+			}
+
+			// Packets of other sets are skipped.
+			const std::string set(reinterpret_cast<const char *>(header + 32), 16);
+			if (!setid.empty() && set != setid) {
+				at += length;
+				continue;
+			}
+
+			// Recovery slices are located, other packets are not read.
+			const std::string type(reinterpret_cast<const char *>(header + 48), 16);
+			if (type == RECVSLIC && length >= 68) {
+				unsigned char exponent[4];
+				if (!file.read(reinterpret_cast<char *>(exponent), 4))
+					break;
+				par2recovery r;
+				r.path = path;
+				r.offset = at + 68;
+				r.length = length - 68;
+				r.exponent = littleendian(exponent, 4);
+				r.md5.assign(reinterpret_cast<const char *>(header + 16), 16);
+				r.header.assign(reinterpret_cast<const char *>(header + 32), 32);
+				bool known = false;
+				for (unsigned long i = 0; i < slices.size() && !known; i++)
+					known = slices[i].exponent == r.exponent;
+				if (!known)
+					slices.push_back(r);
+			}
+			if ((type != MAIN && type != FILEDESC && type != IFSC) || length - 64 > MAXPACKET) {
+				at += length;
+				continue;
+			}
+
+			body.resize(length - 64);
+			if (!file.read(reinterpret_cast<char *>(body.data()), body.size()))
+				break;
+
+			// The MD5 covers the packet from the recovery set id on.
+			unsigned char digest[EVP_MAX_MD_SIZE];
+			unsigned int digestlength = 0;
+			if (EVP_DigestInit_ex(context, EVP_md5(), NULL) != 1
+					|| EVP_DigestUpdate(context, header + 32, 32) != 1
+					|| EVP_DigestUpdate(context, body.data(), body.size()) != 1
+					|| EVP_DigestFinal_ex(context, digest, &digestlength) != 1
+					|| digestlength != 16 || std::memcmp(digest, header + 16, 16) != 0) {
+				at++;
+				continue;
+			}
+
+			packet(type, body.data(), body.size());
+			if (type == MAIN && size > 0 && setid.empty())
+				setid = set;
+			at += length;
+		}
+		EVP_MD_CTX_free(context);
+
+		list.clear();
+		for (unsigned long i = 0; i < ids.size(); i++) {
+			std::map<std::string, par2file>::const_iterator d = descriptions.find(ids[i]);
+			if (d == descriptions.end())
+				continue;
+			list.push_back(d->second);
+			std::map<std::string, std::vector<uint32_t> >::const_iterator c = checksums.find(ids[i]);
+			if (c != checksums.end())
+				list.back().crcs = c->second;
+		}
+		return size > 0;
+	}
+
+	/**
+	 * Recovery set id (16 bytes, binary), empty before the main
+	 * packet is read.
+	 *
+	 * @public
+	 */
+	const std::string &par2set::id() const {
+		return setid;
+	}
+
+	/**
+	 * Size of the slices.
+	 *
+	 * @public
+	 */
+	unsigned long par2set::slicesize() const {
+		return size;
+	}
+
+	/**
+	 * The files that can be repaired, in the order of the main
+	 * packet (the order of the recovery computation). Files
+	 * without a description are left out.
+	 *
+	 * @public
+	 */
+	const std::vector<par2file> &par2set::files() const {
+		return list;
+	}
+
+	/**
+	 * Does every file of the main packet have a description?
+	 * Without it the files after a missing one can not be
+	 * given their slice constants, so they can not be repaired.
+	 *
+	 * @public
+	 */
+	bool par2set::complete() const {
+		return size > 0 && list.size() == ids.size();
+	}
+
+	/**
+	 * Find a file by name.
+	 *
+	 * @public
+	 *
+	 * @param name = The file name.
+	 * @return The file, NULL if the set has no such file.
+	 */
+	const par2file *par2set::find(const std::string &name) const {
+		for (unsigned long i = 0; i < list.size(); i++) {
+			if (list[i].name == name)
+				return &list[i];
+		}
+		return NULL;
+	}
+
+	/**
+	 * The recovery slices found, 1 per exponent.
+	 *
+	 * @public
+	 */
+	const std::vector<par2recovery> &par2set::recovery() const {
+		return slices;
+	}
+
+	/**
+	 * Handle 1 packet.
+	 *
+	 * @private
+	 *
+	 * @param   type = Type of the packet (16 bytes).
+	 * @param   body = The packet after the header.
+	 * @param length = Length of body.
+	 */
+	void par2set::packet(const std::string &type, const unsigned char *body, const unsigned long &length) {
+		if (type == MAIN && length >= 12) {
+			const unsigned long count = littleendian(body + 8, 4);
+			const unsigned long bytes = littleendian(body, 8);
+			if (count > (length - 12) / 16 || bytes == 0 || bytes % 4 != 0)
+				return;
+			size = bytes;
+			ids.clear();
+			for (unsigned long i = 0; i < count; i++)
+				ids.push_back(std::string(reinterpret_cast<const char *>(body + 12 + i * 16), 16));
+		} else if (type == FILEDESC && length >= 56) {
+			par2file f;
+			f.id.assign(reinterpret_cast<const char *>(body), 16);
+			f.md5.assign(reinterpret_cast<const char *>(body + 16), 16);
+			f.length = littleendian(body + 48, 8);
+			// The name is padded with zeros to a multiple of 4.
+			const char *name = reinterpret_cast<const char *>(body + 56);
+			f.name.assign(name, strnlen(name, length - 56));
+			descriptions[f.id] = f;
+		} else if (type == IFSC && length >= 16) {
+			// A MD5 and a CRC32 per slice, only the CRC32 is kept.
+			std::vector<uint32_t> &crcs = checksums[std::string(reinterpret_cast<const char *>(body), 16)];
+			crcs.clear();
+			for (unsigned long pos = 16; pos + 20 <= length; pos += 20)
+				crcs.push_back(littleendian(body + pos + 16, 4));
+		}
+	}
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cppnntp
+{
+	/**
+	 * A file protected by a PAR2 recovery set.
+	 */
+	struct par2file
+	{
+		/**
+		 * File id, MD5 of the whole file (16 bytes each, binary).
+		 */
+		std::string id;
+		std::string md5;
+
+		/**
+		 * Name and length of the file.
+		 */
+		std::string name;
+		unsigned long length;
+
+		/**
+		 * CRC32 of each slice, the last slice padded with zeros
+		 * to the slice size (empty if the set had no checksums).
+		 */
+		std::vector<uint32_t> crcs;
+	};
+
+	/**
+	 * A recovery slice in a PAR2 file, read when needed.
+	 */
+	struct par2recovery
+	{
+		/**
+		 * Path/file, where the slice data starts and its length.
+		 */
+		std::string path;
+		unsigned long offset;
+		unsigned long length;
+
+		/**
+		 * Exponent of the slice.
+		 */
+		unsigned int exponent;
+
+		/**
+		 * MD5 of the packet and the part of its header it covers
+		 * (recovery set id and type), to check the data once read.
+		 */
+		std::string md5;
+		std::string header;
+	};
+
+	/**
+	 * Reads the packets of a PAR2 recovery set: the main packet, the
+	 * file descriptions and the slice checksums.
+	 *
+	 * @note Packets whose MD5 does not match are skipped, so a damaged
+	 * index still gives what is left of it. Recovery slices are only
+	 * located, their data is checked when read. Several files of the
+	 * same set (the index, the volumes) can be loaded into 1 par2set,
+	 * packets of other sets are skipped once the main packet is read.
+	 */
+	class par2set
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		par2set();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~par2set();
+
+		/**
+		 * Read the packets of a PAR2 file.
+		 *
+		 * @public
+		 *
+		 * @param path = Path/file of the PAR2 file.
+		 * @return bool = Is the set usable (main packet read)?
+		 */
+		bool load(const std::string &path);
+
+		/**
+		 * Recovery set id (16 bytes, binary), empty before the main
+		 * packet is read.
+		 *
+		 * @public
+		 */
+		const std::string &id() const;
+
+		/**
+		 * Size of the slices.
+		 *
+		 * @public
+		 */
+		unsigned long slicesize() const;
+
+		/**
+		 * The files that can be repaired, in the order of the main
+		 * packet (the order of the recovery computation). Files
+		 * without a description are left out.
+		 *
+		 * @public
+		 */
+		const std::vector<par2file> &files() const;
+
+		/**
+		 * Does every file of the main packet have a description?
+		 * Without it the files after a missing one can not be
+		 * given their slice constants, so they can not be repaired.
+		 *
+		 * @public
+		 */
+		bool complete() const;
+
+		/**
+		 * Find a file by name.
+		 *
+		 * @public
+		 *
+		 * @param name = The file name.
+		 * @return The file, NULL if the set has no such file.
+		 */
+		const par2file *find(const std::string &name) const;
+
+		/**
+		 * The recovery slices found, 1 per exponent.
+		 *
+		 * @public
+		 */
+		const std::vector<par2recovery> &recovery() const;
+
+	private:
+		/**
+		 * Recovery set id, the packets of other sets are skipped.
+		 *
+		 * @private
+		 */
+		std::string setid;
+
+		/**
+		 * Size of the slices, 0 before the main packet is read.
+		 *
+		 * @private
+		 */
+		unsigned long size = 0;
+
+		/**
+		 * Ids of the files, in the order of the main packet.
+		 *
+		 * @private
+		 */
+		std::vector<std::string> ids;
+
+		/**
+		 * File descriptions and slice checksums, by file id.
+		 *
+		 * @private
+		 */
+		std::map<std::string, par2file> descriptions;
+		std::map<std::string, std::vector<uint32_t> > checksums;
+
+		/**
+		 * The files, built from the above after each load.
+		 *
+		 * @private
+		 */
+		std::vector<par2file> list;
+
+		/**
+		 * The recovery slices.
+		 *
+		 * @private
+		 */
+		std::vector<par2recovery> slices;
+
+		/**
+		 * Handle 1 packet.
+		 *
+		 * @private
+		 *
+		 * @param   type = Type of the packet (16 bytes).
+		 * @param   body = The packet after the header.
+		 * @param length = Length of body.
+		 */
+		void packet(const std::string &type, const unsigned char *body, const unsigned long &length);
+	};
+}
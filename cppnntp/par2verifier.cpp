@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <fstream>
+#include <zlib.h>
+#include "par2verifier.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 */
+	par2verifier::par2verifier() {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	par2verifier::~par2verifier() {}
+
+	/**
+	 * Check the files of a PAR2 set from now on.
+	 *
+	 * @public
+	 *
+	 * @param set = The set, files without slice checksums are skipped.
+	 */
+	void par2verifier::addset(const par2set &set) {
+		if (set.slicesize() == 0)
+			return;
+		std::lock_guard<std::mutex> guard(lock);
+		const std::vector<par2file> &list = set.files();
+		for (unsigned long i = 0; i < list.size(); i++) {
+			const par2file &f = list[i];
+			const unsigned long count = (f.length + set.slicesize() - 1) / set.slicesize();
+			if (f.crcs.size() != count || files.find(f.name) != files.end())
+				continue;
+
+			tracked &t = files[f.name];
+			t.slicesize = set.slicesize();
+			t.length = f.length;
+			t.crcs = f.crcs;
+			slice empty;
+			empty.state = FILLING;
+			t.slices.assign(count, empty);
+
+			// The slices of pieces written before are read from the file.
+			std::map<std::string, std::vector<std::pair<unsigned long, unsigned long> > >::iterator
+				it = early.find(f.name);
+			if (it == early.end())
+				continue;
+			for (unsigned long j = 0; j < it->second.size(); j++) {
+				const unsigned long offset = it->second[j].first;
+				const unsigned long last = (offset + it->second[j].second - 1) / t.slicesize;
+				for (unsigned long pos = offset / t.slicesize; pos <= last && pos < count; pos++)
+					t.slices[pos].state = UNKNOWN;
+			}
+			early.erase(it);
+		}
+	}
+
+	/**
+	 * A piece of a file was written.
+	 *
+	 * @public
+	 *
+	 * @param   name = Name of the file.
+	 * @param offset = Where the piece is in the file.
+	 * @param   data = The piece.
+	 * @param length = Length of the piece.
+	 */
+	void par2verifier::add(const std::string &name, const unsigned long &offset,
+			const char *data, const unsigned long &length) {
+		if (length == 0)
+			return;
+
+		std::map<std::string, tracked>::iterator it;
+		unsigned long size;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			it = files.find(name);
+			if (it == files.end()) {
+				early[name].push_back(std::make_pair(offset, length));
+				return;
+			}
+			size = it->second.slicesize;
+		}
+
+		// Split the piece on the slices, the CRC32s are computed unlocked.
+		std::vector<std::pair<unsigned long, part> > parts;
+		const unsigned long end = offset + length;
+		for (unsigned long position = offset; position < end;) {
+			part p;
+			p.length = std::min(size - position % size, end - position);
+			p.crc = crc32(0, reinterpret_cast<const Bytef *>(data + (position - offset)), p.length);
+			parts.push_back(std::make_pair(position, p));
+			position += p.length;
+		}
+
+		// Files are never removed, the iterator stays valid.
+		std::lock_guard<std::mutex> guard(lock);
+		for (unsigned long i = 0; i < parts.size(); i++) {
+			const unsigned long pos = parts[i].first / size;
+			if (pos < it->second.slices.size())
+				join(it->second, pos, parts[i].first % size, parts[i].second);
+		}
+	}
+
+	/**
+	 * Get the damaged slices of a file, once it was written.
+	 *
+	 * @note Slices that could not be checked as they came in are
+	 * read from the file.
+	 * @public
+	 *
+	 * @param   name = Name of the file.
+	 * @param   path = Path/file of the file.
+	 * @param slices = Where the positions of the damaged slices
+	 * are stored.
+	 * @return  bool = Is the file in a PAR2 set?
+	 */
+	bool par2verifier::damaged(const std::string &name, const std::string &path, std::vector<unsigned long> &slices) {
+		slices.clear();
+		std::vector<unsigned long> reread;
+		unsigned long size, length;
+		std::vector<uint32_t> crcs;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			std::map<std::string, tracked>::const_iterator it = files.find(name);
+			if (it == files.end())
+				return false;
+			const tracked &t = it->second;
+			for (unsigned long i = 0; i < t.slices.size(); i++) {
+				if (t.slices[i].state == BAD)
+					slices.push_back(i);
+				else if (t.slices[i].state != GOOD)
+					reread.push_back(i);
+			}
+			if (reread.empty())
+				return true;
+			size = t.slicesize;
+			length = t.length;
+			crcs = t.crcs;
+		}
+
+		// Parts missing from the file read as zeros, or are cut
+		// short, either way the CRC32 does not match.
+		std::vector<unsigned char> buffer(size);
+		std::vector<slicestate> states(reread.size(), BAD);
+		std::ifstream file(path.c_str(), std::ios::binary);
+		for (unsigned long i = 0; i < reread.size() && file.is_open(); i++) {
+			const unsigned long wanted = std::min(size, length - reread[i] * size);
+			file.clear();
+			file.seekg(reread[i] * size);
+			file.read(reinterpret_cast<char *>(buffer.data()), wanted);
+			if (static_cast<unsigned long>(file.gcount()) != wanted)
+				continue;
+			const uint32_t crc = crc32(0, buffer.data(), wanted);
+			if (pad(crc, wanted, size) == crcs[reread[i]])
+				states[i] = GOOD;
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		tracked &t = files[name];
+		for (unsigned long i = 0; i < reread.size(); i++) {
+			slice &s = t.slices[reread[i]];
+			s.state = states[i];
+			s.parts.clear();
+			if (states[i] == BAD)
+				slices.push_back(reread[i]);
+		}
+		std::sort(slices.begin(), slices.end());
+		return true;
+	}
+
+	/**
+	 * Amount of slices checked as they came in.
+	 *
+	 * @public
+	 */
+	unsigned long par2verifier::verified() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return checked;
+	}
+
+	/**
+	 * Add a part to a slice, check the slice if it is complete.
+	 *
+	 * @note lock must be held.
+	 * @private
+	 *
+	 * @param   file = The file.
+	 * @param    pos = Position of the slice.
+	 * @param offset = Where the part is in the slice.
+	 * @param      p = The part.
+	 */
+	void par2verifier::join(tracked &file, const unsigned long &pos, const unsigned long &offset, part p) {
+		slice &s = file.slices[pos];
+		if (s.state != FILLING)
+			return;
+
+		// Parts written twice can not be told apart, the slice is
+		// read from the file.
+		const unsigned long end = offset + p.length;
+		std::map<unsigned long, part>::iterator next = s.parts.lower_bound(offset);
+		std::map<unsigned long, part>::iterator previous = next;
+		if (previous != s.parts.begin())
+			--previous;
+		else
+			previous = s.parts.end();
+		if ((next != s.parts.end() && next->first < end)
+				|| (previous != s.parts.end() && previous->first + previous->second.length > offset)) {
+			s.state = UNKNOWN;
+			s.parts.clear();
+			return;
+		}
+
+		unsigned long start = offset;
+		if (previous != s.parts.end() && previous->first + previous->second.length == offset) {
+			p.crc = crc32_combine(previous->second.crc, p.crc, p.length);
+			p.length += previous->second.length;
+			start = previous->first;
+			s.parts.erase(previous);
+		}
+		if (next != s.parts.end() && next->first == end) {
+			p.crc = crc32_combine(p.crc, next->second.crc, next->second.length);
+			p.length += next->second.length;
+			s.parts.erase(next);
+		}
+
+		const unsigned long length = std::min(file.slicesize, file.length - pos * file.slicesize);
+		if (start == 0 && p.length >= length) {
+			s.state = pad(p.crc, p.length, file.slicesize) == file.crcs[pos] ? GOOD : BAD;
+			s.parts.clear();
+			checked++;
+			return;
+		}
+		s.parts[start] = p;
+	}
+
+	/**
+	 * CRC32 of a slice, padded with zeros to the slice size.
+	 *
+	 * @private
+	 *
+	 * @param    crc = CRC32 of the data.
+	 * @param length = Length of the data.
+	 * @param   size = The slice size.
+	 * @return The padded CRC32.
+	 */
+	uint32_t par2verifier::pad(const uint32_t &crc, const unsigned long &length, const unsigned long &size) {
+		static const Bytef zeros[65536] = {0};
+		uLong padded = crc;
+		for (unsigned long left = length < size ? size - length : 0; left > 0;) {
+			const unsigned long chunk = std::min(left, static_cast<unsigned long>(sizeof(zeros)));
+			padded = crc32(padded, zeros, chunk);
+			left -= chunk;
+		}
+		return padded;
+	}
+}
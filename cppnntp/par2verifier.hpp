@@ -0,0 +1,183 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "par2set.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Checks the PAR2 slices of the files as their segments are
+	 * written, so the damaged slices are known when the download
+	 * ends without reading the files again.
+	 *
+	 * @note Segments arrive in any order and rarely line up with the
+	 * slices: the CRC32 of each part of a slice is computed when it
+	 * arrives and joined to its neighbours with crc32_combine, a
+	 * slice is checked once its parts cover it. Only the CRC32 of the
+	 * slices is used, their MD5 can not be computed out of order.
+	 * Slices written before their PAR2 set was added, or written
+	 * twice, are read from the file by damaged instead.
+	 * Thread safe.
+	 */
+	class par2verifier
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 */
+		par2verifier();
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~par2verifier();
+
+		/**
+		 * Check the files of a PAR2 set from now on.
+		 *
+		 * @public
+		 *
+		 * @param set = The set, files without slice checksums are skipped.
+		 */
+		void addset(const par2set &set);
+
+		/**
+		 * A piece of a file was written.
+		 *
+		 * @public
+		 *
+		 * @param   name = Name of the file.
+		 * @param offset = Where the piece is in the file.
+		 * @param   data = The piece.
+		 * @param length = Length of the piece.
+		 */
+		void add(const std::string &name, const unsigned long &offset,
+				const char *data, const unsigned long &length);
+
+		/**
+		 * Get the damaged slices of a file, once it was written.
+		 *
+		 * @note Slices that could not be checked as they came in are
+		 * read from the file.
+		 * @public
+		 *
+		 * @param   name = Name of the file.
+		 * @param   path = Path/file of the file.
+		 * @param slices = Where the positions of the damaged slices
+		 * are stored.
+		 * @return  bool = Is the file in a PAR2 set?
+		 */
+		bool damaged(const std::string &name, const std::string &path, std::vector<unsigned long> &slices);
+
+		/**
+		 * Amount of slices checked as they came in.
+		 *
+		 * @public
+		 */
+		unsigned long verified() const;
+
+	private:
+		/**
+		 * State of a slice.
+		 *
+		 * @private
+		 */
+		enum slicestate { FILLING, GOOD, BAD, UNKNOWN };
+
+		/**
+		 * CRC32 and length of joined parts of a slice.
+		 *
+		 * @private
+		 */
+		struct part
+		{
+			uint32_t crc;
+			unsigned long length;
+		};
+
+		/**
+		 * A slice, its parts by offset in the slice.
+		 *
+		 * @private
+		 */
+		struct slice
+		{
+			slicestate state;
+			std::map<unsigned long, part> parts;
+		};
+
+		/**
+		 * A file being checked.
+		 *
+		 * @private
+		 */
+		struct tracked
+		{
+			unsigned long slicesize;
+			unsigned long length;
+			std::vector<uint32_t> crcs;
+			std::vector<slice> slices;
+		};
+
+		/**
+		 * The files, by name.
+		 *
+		 * @private
+		 */
+		std::map<std::string, tracked> files;
+
+		/**
+		 * Pieces (offset, length) written before the file was in a set.
+		 *
+		 * @private
+		 */
+		std::map<std::string, std::vector<std::pair<unsigned long, unsigned long> > > early;
+
+		/**
+		 * Slices checked as they came in.
+		 *
+		 * @private
+		 */
+		unsigned long checked = 0;
+
+		/**
+		 * Protects everything.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+
+		/**
+		 * Add a part to a slice, check the slice if it is complete.
+		 *
+		 * @note lock must be held.
+		 * @private
+		 *
+		 * @param   file = The file.
+		 * @param    pos = Position of the slice.
+		 * @param offset = Where the part is in the slice.
+		 * @param      p = The part.
+		 */
+		void join(tracked &file, const unsigned long &pos, const unsigned long &offset, part p);
+
+		/**
+		 * CRC32 of a slice, padded with zeros to the slice size.
+		 *
+		 * @private
+		 *
+		 * @param    crc = CRC32 of the data.
+		 * @param length = Length of the data.
+		 * @param   size = The slice size.
+		 * @return The padded CRC32.
+		 */
+		static uint32_t pad(const uint32_t &crc, const unsigned long &length, const unsigned long &size);
+	};
+}
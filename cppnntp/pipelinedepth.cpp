@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include "pipelinedepth.hpp"
+namespace cppnntp {
+	constexpr double pipelinedepth::WINDOW;
+	const unsigned short pipelinedepth::RTTINTERVAL;
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param maximum = Most commands in flight.
+	 * @param minimum = Fewest commands in flight.
+	 */
+	pipelinedepth::pipelinedepth(const unsigned short &maximum, const unsigned short &minimum)
+		: maximum(std::max<unsigned short>(maximum, 1)),
+		  minimum(std::min(std::max<unsigned short>(minimum, 1), std::max<unsigned short>(maximum, 1))) {
+		// Start shallow, the first responses come back on an idle
+		// connection and give the latency.
+		current = std::max<unsigned short>(this->minimum, std::min<unsigned short>(this->maximum, 2));
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	pipelinedepth::~pipelinedepth() {}
+
+	/**
+	 * Commands were sent.
+	 *
+	 * @public
+	 *
+	 * @param count = How many.
+	 */
+	void pipelinedepth::sent(const unsigned short &count) {
+		command c;
+		c.sent = std::chrono::steady_clock::now();
+		c.idle = inflight.empty();
+		for (unsigned short i = 0; i < count; i++) {
+			inflight.push_back(c);
+			c.idle = false;
+		}
+	}
+
+	/**
+	 * The response to the oldest command in flight was read.
+	 *
+	 * @public
+	 *
+	 * @param firstbyte = When its first byte arrived.
+	 * @param     bytes = Its length.
+	 */
+	void pipelinedepth::received(const std::chrono::steady_clock::time_point &firstbyte,
+			const unsigned long &bytes) {
+		if (inflight.empty())
+			return;
+		const command c = inflight.front();
+		inflight.pop_front();
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		// Only a command sent on an idle connection measures the latency,
+		// the others also waited for the responses ahead of them.
+		// Old minimums expire so a slower route is picked up.
+		if (c.idle) {
+			const double sample = std::max(1e-6, std::chrono::duration<double>(firstbyte - c.sent).count());
+			if (rtt == 0 || sample < rtt || now - rttseen > std::chrono::seconds(RTTINTERVAL)) {
+				rtt = sample;
+				rttseen = now;
+			}
+		}
+
+		// Time spent receiving this response, not counting any gap
+		// after the previous one. A response that came in the same
+		// chunk as the previous one gets almost none, so the rate is
+		// only taken over a window of responses.
+		const std::chrono::steady_clock::time_point start = std::max(std::max(firstbyte, c.sent), last);
+		windowtime += std::chrono::duration<double>(now - start).count();
+		windowbytes += bytes;
+		last = now;
+		if (windowtime >= WINDOW) {
+			const double sample = windowbytes / windowtime;
+			rate = rate == 0 ? sample : rate + (sample - rate) / 8;
+			windowtime = 0;
+			windowbytes = 0;
+		}
+		size = size == 0 ? bytes : size + (bytes - size) / 8;
+
+		if (rtt == 0 || rate == 0 || size < 1)
+			return;
+
+		// Commands needed to cover the bandwidth delay product, with
+		// headroom for jitter and the one being received.
+		const double target = std::ceil(rate * rtt / size * 1.5) + 1;
+		if (target >= maximum)
+			current = maximum;
+		else if (target <= minimum)
+			current = minimum;
+		else
+			current = static_cast<unsigned short>(target);
+	}
+
+	/**
+	 * The connection broke, forget the commands in flight,
+	 * the measurements are kept.
+	 *
+	 * @public
+	 */
+	void pipelinedepth::reset() {
+		inflight.clear();
+		last = std::chrono::steady_clock::time_point();
+		windowtime = 0;
+		windowbytes = 0;
+	}
+
+	/**
+	 * How many commands to keep in flight.
+	 *
+	 * @public
+	 */
+	unsigned short pipelinedepth::depth() const {
+		return current;
+	}
+
+	/**
+	 * Should the caller stop sending until every response came
+	 * back, so the next command measures the latency?
+	 *
+	 * @public
+	 */
+	bool pipelinedepth::draining() const {
+		return !inflight.empty() && rtt > 0
+			&& std::chrono::steady_clock::now() - rttseen > std::chrono::seconds(RTTINTERVAL);
+	}
+
+	/**
+	 * Measured latency in seconds, 0 if unknown.
+	 *
+	 * @public
+	 */
+	double pipelinedepth::latency() const {
+		return rtt;
+	}
+
+	/**
+	 * Measured throughput in bytes per second, 0 if unknown.
+	 *
+	 * @public
+	 */
+	double pipelinedepth::throughput() const {
+		return rate;
+	}
+}
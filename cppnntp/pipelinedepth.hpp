@@ -0,0 +1,183 @@
+#pragma once
+#include <chrono>
+#include <deque>
+
+namespace cppnntp
+{
+	/**
+	 * Picks how many commands 1 connection keeps in flight, from the
+	 * latency and throughput measured on that connection.
+	 *
+	 * @note Enough commands must be in flight to cover the bandwidth
+	 * delay product (bytes per second * latency), any more only sit
+	 * in the server's queue. The latency is the time to first byte of
+	 * commands sent on an idle connection, so responses queued behind
+	 * others never inflate it, every RTTINTERVAL the caller lets the
+	 * pipeline drain once (see draining) to take a new sample. The
+	 * throughput is the bytes received over the time spent receiving
+	 * a window of responses (gaps with nothing arriving excluded), a
+	 * response that was already buffered can not be timed on its own.
+	 * Not thread safe, use 1 per connection.
+	 */
+	class pipelinedepth
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param maximum = Most commands in flight.
+		 * @param minimum = Fewest commands in flight.
+		 */
+		pipelinedepth(const unsigned short &maximum = 64, const unsigned short &minimum = 1);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~pipelinedepth();
+
+		/**
+		 * Commands were sent.
+		 *
+		 * @public
+		 *
+		 * @param count = How many.
+		 */
+		void sent(const unsigned short &count);
+
+		/**
+		 * The response to the oldest command in flight was read.
+		 *
+		 * @public
+		 *
+		 * @param firstbyte = When its first byte arrived.
+		 * @param     bytes = Its length.
+		 */
+		void received(const std::chrono::steady_clock::time_point &firstbyte,
+				const unsigned long &bytes);
+
+		/**
+		 * The connection broke, forget the commands in flight,
+		 * the measurements are kept.
+		 *
+		 * @public
+		 */
+		void reset();
+
+		/**
+		 * How many commands to keep in flight.
+		 *
+		 * @public
+		 */
+		unsigned short depth() const;
+
+		/**
+		 * Should the caller stop sending until every response came
+		 * back, so the next command measures the latency?
+		 *
+		 * @public
+		 */
+		bool draining() const;
+
+		/**
+		 * Measured latency in seconds, 0 if unknown.
+		 *
+		 * @public
+		 */
+		double latency() const;
+
+		/**
+		 * Measured throughput in bytes per second, 0 if unknown.
+		 *
+		 * @public
+		 */
+		double throughput() const;
+
+	private:
+		/**
+		 * A command in flight.
+		 *
+		 * @private
+		 */
+		struct command
+		{
+			std::chrono::steady_clock::time_point sent;
+
+			/**
+			 * Was nothing in flight ahead of it?
+			 */
+			bool idle;
+		};
+
+		/**
+		 * Shortest window the throughput is measured over, in seconds.
+		 *
+		 * @private
+		 */
+		static constexpr double WINDOW = 0.1;
+
+		/**
+		 * Seconds between latency samples.
+		 *
+		 * @private
+		 */
+		static const unsigned short RTTINTERVAL = 30;
+
+		/**
+		 * The limits.
+		 *
+		 * @private
+		 */
+		unsigned short maximum;
+		unsigned short minimum;
+
+		/**
+		 * Commands to keep in flight.
+		 *
+		 * @private
+		 */
+		unsigned short current;
+
+		/**
+		 * Commands in flight, oldest first.
+		 *
+		 * @private
+		 */
+		std::deque<command> inflight;
+
+		/**
+		 * When the previous response was read.
+		 *
+		 * @private
+		 */
+		std::chrono::steady_clock::time_point last;
+
+		/**
+		 * Time spent receiving and bytes received in the current
+		 * throughput window.
+		 *
+		 * @private
+		 */
+		double windowtime = 0;
+		unsigned long windowbytes = 0;
+
+		/**
+		 * Lowest latency seen, and when it was seen.
+		 *
+		 * @private
+		 */
+		double rtt = 0;
+		std::chrono::steady_clock::time_point rttseen;
+
+		/**
+		 * Moving averages of the throughput and response size.
+		 *
+		 * @private
+		 */
+		double rate = 0;
+		double size = 0;
+	};
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include "ratelimiter.hpp"
+namespace cppnntp {
+	/**
+	 * Burst tolerated after the link was idle.
+	 */
+	static const std::chrono::milliseconds burst(50);
+
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param rate = Bytes per second, 0 for no limit.
+	 */
+	ratelimiter::ratelimiter(const unsigned long &rate) : bytespersecond(rate) {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	ratelimiter::~ratelimiter() {}
+
+	/**
+	 * Change the rate.
+	 *
+	 * @public
+	 *
+	 * @param rate = Bytes per second, 0 for no limit.
+	 */
+	void ratelimiter::setrate(const unsigned long &rate) {
+		std::lock_guard<std::mutex> guard(lock);
+		const unsigned long old = bytespersecond;
+		bytespersecond = rate;
+
+		// The bytes already given a slot are spread at the new rate.
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (old == 0 || rate == 0 || allowed < now)
+			allowed = now;
+		else
+			allowed = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				(allowed - now) * (static_cast<double>(old) / rate));
+		generation++;
+		changed.notify_all();
+	}
+
+	/**
+	 * The rate in bytes per second, 0 if there is no limit.
+	 *
+	 * @public
+	 */
+	unsigned long ratelimiter::rate() const {
+		return bytespersecond;
+	}
+
+	/**
+	 * Account for bytes that were read, sleep until the rate
+	 * allows them.
+	 *
+	 * @public
+	 *
+	 * @param bytes = Amount of bytes read.
+	 */
+	void ratelimiter::consume(const unsigned long &bytes) {
+		if (bytespersecond == 0 || bytes == 0)
+			return;
+
+		std::unique_lock<std::mutex> guard(lock);
+		const unsigned long rate = bytespersecond;
+		if (rate == 0)
+			return;
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (allowed < now)
+			allowed = now;
+		allowed += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(static_cast<double>(bytes) / rate));
+
+		// Wait until our slot, minus the tolerated burst.
+		std::chrono::steady_clock::time_point until = allowed - burst;
+		unsigned long current = rate;
+		while (true) {
+			const unsigned long seen = generation;
+			if (!changed.wait_until(guard, until, [this, seen]() { return generation != seen; }))
+				return;
+
+			// The rate changed, rescale what is left of the wait.
+			const unsigned long changedrate = bytespersecond;
+			const std::chrono::steady_clock::time_point woke = std::chrono::steady_clock::now();
+			if (changedrate == 0 || until <= woke)
+				return;
+			until = woke + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				(until - woke) * (static_cast<double>(current) / changedrate));
+			current = changedrate;
+		}
+	}
+
+	/**
+	 * Largest read that keeps the flow smooth at the current rate.
+	 *
+	 * @public
+	 *
+	 * @param wanted = The read size without a limit.
+	 * @return The read size.
+	 */
+	unsigned long ratelimiter::chunk(const unsigned long &wanted) const {
+		const unsigned long rate = bytespersecond;
+		if (rate == 0)
+			return wanted;
+		// About 20ms worth of data per read.
+		return std::min(wanted, std::max(rate / 50, 4096UL));
+	}
+}
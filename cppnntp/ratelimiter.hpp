@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace cppnntp
+{
+	/**
+	 * Token bucket that caps how many bytes per second are read,
+	 * shared by every connection it is given to.
+	 *
+	 * @note Each read is given a slot on a virtual timeline that moves
+	 * forward by bytes / rate, the reader sleeps until its slot comes
+	 * (a short burst is tolerated). Readers are served in the order they
+	 * came, so connections share the rate fairly, and reads are kept
+	 * small (see chunk) so the flow stays smooth.
+	 * The rate can be changed at any time, the waits of sleeping readers
+	 * are rescaled to it.
+	 */
+	class ratelimiter
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param rate = Bytes per second, 0 for no limit.
+		 */
+		ratelimiter(const unsigned long &rate = 0);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~ratelimiter();
+
+		/**
+		 * Change the rate.
+		 *
+		 * @public
+		 *
+		 * @param rate = Bytes per second, 0 for no limit.
+		 */
+		void setrate(const unsigned long &rate);
+
+		/**
+		 * The rate in bytes per second, 0 if there is no limit.
+		 *
+		 * @public
+		 */
+		unsigned long rate() const;
+
+		/**
+		 * Account for bytes that were read, sleep until the rate
+		 * allows them.
+		 *
+		 * @public
+		 *
+		 * @param bytes = Amount of bytes read.
+		 */
+		void consume(const unsigned long &bytes);
+
+		/**
+		 * Largest read that keeps the flow smooth at the current rate.
+		 *
+		 * @public
+		 *
+		 * @param wanted = The read size without a limit.
+		 * @return The read size.
+		 */
+		unsigned long chunk(const unsigned long &wanted) const;
+
+	private:
+		/**
+		 * Bytes per second, 0 for no limit.
+		 *
+		 * @private
+		 */
+		std::atomic<unsigned long> bytespersecond;
+
+		/**
+		 * When the bytes accounted so far are allowed, protected
+		 * by lock.
+		 *
+		 * @private
+		 */
+		std::chrono::steady_clock::time_point allowed;
+
+		/**
+		 * Bumped by setrate so sleeping readers wake up.
+		 *
+		 * @private
+		 */
+		unsigned long generation = 0;
+
+		/**
+		 * Protects allowed and generation.
+		 *
+		 * @private
+		 */
+		std::mutex lock;
+		std::condition_variable changed;
+	};
+}
@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include "segmentscheduler.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param     job = The job.
+	 * @param  limits = Amount of workers (connections) of each
+	 * server, at most 64 servers.
+	 * @param retries = How many times a segment is given back
+	 * by broken connections before it is given up on.
+	 * @param   known = (Optional) Servers already known not to have
+	 * each segment, 1 bit per server, see negativecache.
+	 * @param    done = (Optional) Segments already written, see
+	 * checkpoint. They are not handed out, they must be counted
+	 * as handled.
+	 */
+	segmentscheduler::segmentscheduler(const nzbjob &job, const std::vector<unsigned short> &limits,
+			const unsigned short &retries, const std::vector<uint64_t> &known, const std::vector<bool> &done)
+		: job(job), retries(retries ? retries : 1), outstanding(job.segments()), steals(0) {
+		if (limits.size() > 64)
+			throw SegmentSchedulerException("At most 64 servers are supported.");
+
+		for (unsigned short s = 0; s < limits.size(); s++) {
+			for (unsigned short i = 0; i < limits[s]; i++) {
+				queues.push_back(std::unique_ptr<queue>(new queue));
+				queues.back()->server = s;
+				queues.back()->active = true;
+			}
+		}
+		if (queues.empty())
+			throw SegmentSchedulerException("No connections to schedule segments on.");
+
+		priorities.resize(job.files());
+		for (unsigned long f = 0; f < job.files(); f++)
+			priorities[f] = priority(job.filename(job.file(f)));
+
+		if (known.size() == job.segments())
+			tried = known;
+		else
+			tried.assign(job.segments(), 0);
+		attempts.assign(job.segments(), 0);
+
+		// Deal the segments round robin in priority order, every deque
+		// is sorted and the workers start on the same files together.
+		std::vector<unsigned long> order(job.segments());
+		for (unsigned long i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(),
+			[this](const unsigned long &a, const unsigned long &b) {
+				return priority(a) < priority(b);
+			});
+		// Segments a server is known to lack go to the next worker,
+		// those no server has, and those already written, are not handed out.
+		unsigned long worker = 0;
+		for (unsigned long i = 0; i < order.size(); i++) {
+			if (order[i] < done.size() && done[order[i]])
+				continue;
+			unsigned long tries = 0;
+			while (tries < queues.size()
+					&& (tried[order[i]] & (static_cast<uint64_t>(1) << queues[worker]->server))) {
+				worker = (worker + 1) % queues.size();
+				tries++;
+			}
+			if (tries == queues.size()) {
+				unavailable.push_back(order[i]);
+				continue;
+			}
+			queues[worker]->segments.push_back(order[i]);
+			worker = (worker + 1) % queues.size();
+		}
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	segmentscheduler::~segmentscheduler() {}
+
+	/**
+	 * Amount of workers, they are numbered from 0, the workers
+	 * of the first server first.
+	 *
+	 * @public
+	 */
+	unsigned int segmentscheduler::workers() const {
+		return queues.size();
+	}
+
+	/**
+	 * The server a worker downloads from.
+	 *
+	 * @public
+	 *
+	 * @param worker = The worker.
+	 */
+	unsigned short segmentscheduler::server(const unsigned int &worker) const {
+		return queues[worker]->server;
+	}
+
+	/**
+	 * Take a segment to download.
+	 *
+	 * @public
+	 *
+	 * @param  worker = The worker.
+	 * @param segment = Where the segment position is stored.
+	 * @param    wait = Wait for segments moved to this worker
+	 * if there are none to take or steal right now?
+	 * @return   bool = Was there one? False when waiting if
+	 * every segment was handled.
+	 */
+	bool segmentscheduler::take(const unsigned int &worker, unsigned long &segment, const bool &wait) {
+		queue &own = *queues[worker];
+		while (true) {
+			unsigned long seen;
+			{
+				std::lock_guard<std::mutex> guard(wakelock);
+				seen = version;
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(own.lock);
+				if (!own.segments.empty()) {
+					segment = own.segments.front();
+					own.segments.pop_front();
+					return true;
+				}
+			}
+
+			if (steal(worker, segment))
+				return true;
+			if (!wait || outstanding == 0)
+				return false;
+
+			// Nothing to steal, the segments left are in flight. Sleep
+			// until one is moved around or the job is done.
+			std::unique_lock<std::mutex> guard(wakelock);
+			changed.wait(guard, [this, seen]() {
+				return version != seen || outstanding == 0;
+			});
+		}
+	}
+
+	/**
+	 * Give back a segment whose connection broke, it goes back
+	 * to the front of the deque of the worker.
+	 *
+	 * @public
+	 *
+	 * @param  worker = The worker.
+	 * @param segment = The segment.
+	 * @return   bool = False if it was tried too many times,
+	 * it must then be counted as failed.
+	 */
+	bool segmentscheduler::giveback(const unsigned int &worker, const unsigned long &segment) {
+		if (++attempts[segment] >= retries)
+			return false;
+
+		queue &own = *queues[worker];
+		{
+			std::lock_guard<std::mutex> guard(own.lock);
+			if (own.active) {
+				insert(own, segment, true);
+				// Idle workers can steal it while we reconnect.
+				wake();
+				return true;
+			}
+		}
+		return place(segment);
+	}
+
+	/**
+	 * The server of a worker does not have a segment, move it to
+	 * a server that was not tried yet.
+	 *
+	 * @public
+	 *
+	 * @param  worker = The worker.
+	 * @param segment = The segment.
+	 * @return   bool = False if every server was tried, it must
+	 * then be counted as failed.
+	 */
+	bool segmentscheduler::missing(const unsigned int &worker, const unsigned long &segment) {
+		tried[segment] |= static_cast<uint64_t>(1) << queues[worker]->server;
+		return place(segment);
+	}
+
+	/**
+	 * A worker stops (its server is unreachable), its segments are
+	 * moved to the other workers.
+	 *
+	 * @public
+	 *
+	 * @param worker = The worker.
+	 * @param failed = Where segments no other worker can download
+	 * are stored, they must be counted as failed.
+	 */
+	void segmentscheduler::retire(const unsigned int &worker, std::vector<unsigned long> &failed) {
+		std::deque<unsigned long> left;
+		{
+			std::lock_guard<std::mutex> guard(queues[worker]->lock);
+			queues[worker]->active = false;
+			left.swap(queues[worker]->segments);
+		}
+		for (unsigned long i = 0; i < left.size(); i++) {
+			if (!place(left[i]))
+				failed.push_back(left[i]);
+		}
+	}
+
+	/**
+	 * Mark a segment as handled (downloaded or failed).
+	 *
+	 * @public
+	 */
+	void segmentscheduler::done() {
+		if (--outstanding == 0)
+			wake();
+	}
+
+	/**
+	 * Amount of segments not handled yet.
+	 *
+	 * @public
+	 */
+	unsigned long segmentscheduler::remaining() const {
+		return outstanding;
+	}
+
+	/**
+	 * Amount of segments taken from other workers.
+	 *
+	 * @public
+	 */
+	unsigned long segmentscheduler::stolen() const {
+		return steals;
+	}
+
+	/**
+	 * Segments that were not handed to any worker because every
+	 * server is known not to have them, they must be counted
+	 * as failed.
+	 *
+	 * @public
+	 */
+	const std::vector<unsigned long> &segmentscheduler::skipped() const {
+		return unavailable;
+	}
+
+	/**
+	 * Priority of a file, lower goes first: 0 for PAR2 index
+	 * files, 1 for other files, 2 for PAR2 recovery volumes.
+	 *
+	 * @public
+	 *
+	 * @param name = The file name.
+	 */
+	unsigned char segmentscheduler::priority(const std::string &name) {
+		std::string lower = name;
+		for (unsigned long i = 0; i < lower.length(); i++)
+			lower[i] = std::tolower(static_cast<unsigned char>(lower[i]));
+
+		if (lower.length() < 5 || lower.compare(lower.length() - 5, 5, ".par2") != 0)
+			return 1;
+		// name.vol00+01.par2 holds recovery blocks, name.par2 the index.
+		return lower.find(".vol") == std::string::npos ? 0 : 2;
+	}
+
+	/**
+	 * Priority of a segment.
+	 *
+	 * @private
+	 */
+	unsigned char segmentscheduler::priority(const unsigned long &segment) const {
+		return priorities[job.segment(segment).file];
+	}
+
+	/**
+	 * Insert a segment in a deque, keeping the priority order.
+	 *
+	 * @private
+	 *
+	 * @param       q = The deque, must be locked.
+	 * @param segment = The segment.
+	 * @param   front = Put it before segments of the same priority?
+	 */
+	void segmentscheduler::insert(queue &q, const unsigned long &segment, const bool &front) {
+		const unsigned char p = priority(segment);
+		if (front && (q.segments.empty() || priority(q.segments.front()) >= p)) {
+			q.segments.push_front(segment);
+			return;
+		}
+		if (!front && (q.segments.empty() || priority(q.segments.back()) <= p)) {
+			q.segments.push_back(segment);
+			return;
+		}
+
+		std::deque<unsigned long>::iterator it = q.segments.begin();
+		while (it != q.segments.end() && (front ? priority(*it) < p : priority(*it) <= p))
+			++it;
+		q.segments.insert(it, segment);
+	}
+
+	/**
+	 * Move a segment to the active worker with the shortest deque
+	 * whose server did not try it.
+	 *
+	 * @private
+	 *
+	 * @param segment = The segment.
+	 * @return   bool = Was there such a worker?
+	 */
+	bool segmentscheduler::place(const unsigned long &segment) {
+		while (true) {
+			queue *target = NULL;
+			unsigned long shortest = ULONG_MAX;
+			for (unsigned int i = 0; i < queues.size(); i++) {
+				queue &q = *queues[i];
+				if (tried[segment] & (static_cast<uint64_t>(1) << q.server))
+					continue;
+				std::lock_guard<std::mutex> guard(q.lock);
+				if (q.active && q.segments.size() < shortest) {
+					target = &q;
+					shortest = q.segments.size();
+				}
+			}
+			if (target == NULL)
+				return false;
+
+			bool placed = false;
+			{
+				std::lock_guard<std::mutex> guard(target->lock);
+				// It could have retired since we looked.
+				if (target->active) {
+					insert(*target, segment, false);
+					placed = true;
+				}
+			}
+			if (placed) {
+				wake();
+				return true;
+			}
+		}
+	}
+
+	/**
+	 * Steal segments from another worker.
+	 *
+	 * @private
+	 *
+	 * @param  worker = The thief.
+	 * @param segment = Where the first stolen segment is stored.
+	 * @return   bool = Was anything stolen?
+	 */
+	bool segmentscheduler::steal(const unsigned int &worker, unsigned long &segment) {
+		const uint64_t bit = static_cast<uint64_t>(1) << queues[worker]->server;
+
+		// Taking nothing means we lost a race with the owner or
+		// another thief, look again.
+		std::vector<unsigned long> taken;
+		while (taken.empty()) {
+			// The victim is the worker whose next segment we can take has
+			// the best priority, the longest deque on ties.
+			unsigned int victim = worker;
+			unsigned char best = UCHAR_MAX;
+			unsigned long longest = 0;
+			for (unsigned int i = 0; i < queues.size(); i++) {
+				if (i == worker)
+					continue;
+				queue &q = *queues[i];
+				std::lock_guard<std::mutex> guard(q.lock);
+				for (unsigned long j = 0; j < q.segments.size(); j++) {
+					if (tried[q.segments[j]] & bit)
+						continue;
+					const unsigned char p = priority(q.segments[j]);
+					if (p < best || (p == best && q.segments.size() > longest)) {
+						victim = i;
+						best = p;
+						longest = q.segments.size();
+					}
+					break;
+				}
+			}
+			if (victim == worker)
+				return false;
+
+			// Take half of its deque from the front, so the victim keeps
+			// working on its later segments and priorities are kept.
+			taken.clear();
+			{
+				queue &q = *queues[victim];
+				std::lock_guard<std::mutex> guard(q.lock);
+				const unsigned long want = (q.segments.size() + 1) / 2;
+				unsigned char first = UCHAR_MAX;
+				std::deque<unsigned long>::iterator it = q.segments.begin();
+				while (it != q.segments.end() && taken.size() < want) {
+					if (tried[*it] & bit) {
+						++it;
+						continue;
+					}
+					const unsigned char p = priority(*it);
+					if (first == UCHAR_MAX)
+						first = p;
+					else if (p != first)
+						break;
+					taken.push_back(*it);
+					it = q.segments.erase(it);
+				}
+			}
+		}
+
+		steals += taken.size();
+		segment = taken[0];
+		if (taken.size() > 1) {
+			queue &own = *queues[worker];
+			std::lock_guard<std::mutex> guard(own.lock);
+			for (unsigned long i = 1; i < taken.size(); i++)
+				insert(own, taken[i], false);
+		}
+		return true;
+	}
+
+	/**
+	 * Wake the waiting workers.
+	 *
+	 * @private
+	 */
+	void segmentscheduler::wake() {
+		std::lock_guard<std::mutex> guard(wakelock);
+		version++;
+		changed.notify_all();
+	}
+}
@@ -0,0 +1,313 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "nzbjob.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Hands out the segments of a NZB job to the connection workers
+	 * of 1 or more servers.
+	 *
+	 * @note Every worker has its own deque of segments, filled round
+	 * robin by priority (PAR2 index files, then the data files, then
+	 * the PAR2 recovery volumes). A worker takes from the front of its
+	 * own deque and when it is empty steals half of the deque with the
+	 * best priority from another worker, so fast connections never sit
+	 * idle while slow ones still have work.
+	 * A segment missing on a server is moved to a worker of a server
+	 * that has not tried it yet, workers never get a segment their
+	 * server already reported as missing.
+	 */
+	class segmentscheduler
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param     job = The job.
+		 * @param  limits = Amount of workers (connections) of each
+		 * server, at most 64 servers.
+		 * @param retries = How many times a segment is given back
+		 * by broken connections before it is given up on.
+		 * @param   known = (Optional) Servers already known not to have
+		 * each segment, 1 bit per server, see negativecache.
+		 * @param    done = (Optional) Segments already written, see
+		 * checkpoint. They are not handed out, they must be counted
+		 * as handled.
+		 */
+		segmentscheduler(const nzbjob &job, const std::vector<unsigned short> &limits,
+				const unsigned short &retries = 3,
+				const std::vector<uint64_t> &known = std::vector<uint64_t>(),
+				const std::vector<bool> &done = std::vector<bool>());
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~segmentscheduler();
+
+		/**
+		 * Amount of workers, they are numbered from 0, the workers
+		 * of the first server first.
+		 *
+		 * @public
+		 */
+		unsigned int workers() const;
+
+		/**
+		 * The server a worker downloads from.
+		 *
+		 * @public
+		 *
+		 * @param worker = The worker.
+		 */
+		unsigned short server(const unsigned int &worker) const;
+
+		/**
+		 * Take a segment to download.
+		 *
+		 * @public
+		 *
+		 * @param  worker = The worker.
+		 * @param segment = Where the segment position is stored.
+		 * @param    wait = Wait for segments moved to this worker
+		 * if there are none to take or steal right now?
+		 * @return   bool = Was there one? False when waiting if
+		 * every segment was handled.
+		 */
+		bool take(const unsigned int &worker, unsigned long &segment, const bool &wait);
+
+		/**
+		 * Give back a segment whose connection broke, it goes back
+		 * to the front of the deque of the worker.
+		 *
+		 * @public
+		 *
+		 * @param  worker = The worker.
+		 * @param segment = The segment.
+		 * @return   bool = False if it was tried too many times,
+		 * it must then be counted as failed.
+		 */
+		bool giveback(const unsigned int &worker, const unsigned long &segment);
+
+		/**
+		 * The server of a worker does not have a segment, move it to
+		 * a server that was not tried yet.
+		 *
+		 * @public
+		 *
+		 * @param  worker = The worker.
+		 * @param segment = The segment.
+		 * @return   bool = False if every server was tried, it must
+		 * then be counted as failed.
+		 */
+		bool missing(const unsigned int &worker, const unsigned long &segment);
+
+		/**
+		 * A worker stops (its server is unreachable), its segments are
+		 * moved to the other workers.
+		 *
+		 * @public
+		 *
+		 * @param worker = The worker.
+		 * @param failed = Where segments no other worker can download
+		 * are stored, they must be counted as failed.
+		 */
+		void retire(const unsigned int &worker, std::vector<unsigned long> &failed);
+
+		/**
+		 * Mark a segment as handled (downloaded or failed).
+		 *
+		 * @public
+		 */
+		void done();
+
+		/**
+		 * Amount of segments not handled yet.
+		 *
+		 * @public
+		 */
+		unsigned long remaining() const;
+
+		/**
+		 * Amount of segments taken from other workers.
+		 *
+		 * @public
+		 */
+		unsigned long stolen() const;
+
+		/**
+		 * Segments that were not handed to any worker because every
+		 * server is known not to have them, they must be counted
+		 * as failed.
+		 *
+		 * @public
+		 */
+		const std::vector<unsigned long> &skipped() const;
+
+		/**
+		 * Priority of a file, lower goes first: 0 for PAR2 index
+		 * files, 1 for other files, 2 for PAR2 recovery volumes.
+		 *
+		 * @public
+		 *
+		 * @param name = The file name.
+		 */
+		static unsigned char priority(const std::string &name);
+
+	private:
+		/**
+		 * The segments of 1 worker, in priority order.
+		 *
+		 * @private
+		 */
+		struct queue
+		{
+			std::mutex lock;
+			std::deque<unsigned long> segments;
+			unsigned short server;
+			bool active;
+		};
+
+		/**
+		 * The job.
+		 *
+		 * @private
+		 */
+		const nzbjob &job;
+
+		/**
+		 * The deque of each worker.
+		 *
+		 * @private
+		 */
+		std::vector<std::unique_ptr<queue> > queues;
+
+		/**
+		 * Priority of each file.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned char> priorities;
+
+		/**
+		 * Servers that do not have each segment, 1 bit per server.
+		 * Only changed by the worker holding the segment.
+		 *
+		 * @private
+		 */
+		std::vector<uint64_t> tried;
+
+		/**
+		 * Segments no server has.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned long> unavailable;
+
+		/**
+		 * Times each segment was given back.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned short> attempts;
+
+		/**
+		 * Gives back allowed per segment.
+		 *
+		 * @private
+		 */
+		unsigned short retries;
+
+		/**
+		 * Segments not handled yet.
+		 *
+		 * @private
+		 */
+		std::atomic<unsigned long> outstanding;
+
+		/**
+		 * Segments taken from other workers.
+		 *
+		 * @private
+		 */
+		std::atomic<unsigned long> steals;
+
+		/**
+		 * Waiting workers sleep on changed, version is bumped (under
+		 * wakelock) each time a segment is moved or handled.
+		 *
+		 * @private
+		 */
+		std::mutex wakelock;
+		std::condition_variable changed;
+		unsigned long version = 0;
+
+		/**
+		 * Priority of a segment.
+		 *
+		 * @private
+		 */
+		unsigned char priority(const unsigned long &segment) const;
+
+		/**
+		 * Insert a segment in a deque, keeping the priority order.
+		 *
+		 * @private
+		 *
+		 * @param       q = The deque, must be locked.
+		 * @param segment = The segment.
+		 * @param   front = Put it before segments of the same priority?
+		 */
+		void insert(queue &q, const unsigned long &segment, const bool &front);
+
+		/**
+		 * Move a segment to the active worker with the shortest deque
+		 * whose server did not try it.
+		 *
+		 * @private
+		 *
+		 * @param segment = The segment.
+		 * @return   bool = Was there such a worker?
+		 */
+		bool place(const unsigned long &segment);
+
+		/**
+		 * Steal segments from another worker.
+		 *
+		 * @private
+		 *
+		 * @param  worker = The thief.
+		 * @param segment = Where the first stolen segment is stored.
+		 * @return   bool = Was anything stolen?
+		 */
+		bool steal(const unsigned int &worker, unsigned long &segment);
+
+		/**
+		 * Wake the waiting workers.
+		 *
+		 * @private
+		 */
+		void wake();
+	};
+
+	/**
+	 * Exceptions for class segmentscheduler.
+	 */
+	class SegmentSchedulerException : public std::runtime_error
+	{
+		public: SegmentSchedulerException(const std::string& error) : runtime_error(error) {
+		}
+	};
+}
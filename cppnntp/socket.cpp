@@ -27,6 +27,7 @@ namespace cppnntp {
 	 */
 	bool socket::clioutput(const bool &output) {
 		echocli = output;
+		return echocli;
 	}
 
 	/**
@@ -66,6 +67,8 @@ namespace cppnntp {
 			delete ssl_sock;
 			ssl_sock = NULL;
 		}
+		pending.clear();
+		pendingoffset = 0;
 	}
 
 	/**
@@ -287,6 +290,169 @@ namespace cppnntp {
 		return true;
 	}
 
+	/**
+	 * Pass several commands to usenet in 1 write, without waiting
+	 * for the responses (pipelining).
+	 *
+	 * @note Read the responses in order with read_response.
+	 * @private
+	 *
+	 * @param  commands = The commands, each ending with \r\n.
+	 * @return    bool = Did we succeed?
+	 */
+	bool socket::send_commands(const std::string &commands) {
+		if (!is_connected())
+			return false;
+
+		try {
+			// write() loops until everything is sent, write_some may not.
+			if (tcp_sock != NULL)
+				boost::asio::write(*tcp_sock, boost::asio::buffer(commands));
+			else
+				boost::asio::write(*ssl_sock, boost::asio::buffer(commands));
+		} catch (boost::system::system_error& error) {
+			throw NNTPSockException(error.what());
+		}
+		return true;
+	}
+
+	/**
+	 * Read exactly 1 response, keeping anything after it for
+	 * the next call, so responses to pipelined commands can be
+	 * read back to back.
+	 *
+	 * @note Do not mix with the read_line(s) functions while
+	 * responses are pending.
+	 * @private
+	 *
+	 * @param     response = The expected multi line response code.
+	 * @param  finalbuffer = Where the response is stored: the status
+	 *                       line, and if the code was the expected one,
+	 *                       the data up to and including (.\r\n).
+	 * @param         code = Where the response code is stored.
+	 * @return        bool = Was it the expected response?
+	 */
+	bool socket::read_response(const responsecodes &response,
+			std::string &finalbuffer, unsigned short &code) {
+		if (!is_connected())
+			return false;
+
+		// The status line, note when its first byte arrived.
+		if (pending.empty())
+			fill();
+		started = filled;
+		std::string::size_type eol;
+		while ((eol = pending.find("\r\n", pendingoffset)) == std::string::npos)
+			fill();
+
+		code = 0;
+		for (unsigned long i = pendingoffset; i < pendingoffset + 3 && i < eol; i++) {
+			if (pending[i] < '0' || pending[i] > '9')
+				throw NNTPSockException("Wrong response code from usenet.");
+			code = code * 10 + (pending[i] - '0');
+		}
+		if (echocli)
+			std::cout.write(pending.data() + pendingoffset, eol + 2 - pendingoffset);
+
+		std::string::size_type end = eol + 2;
+		if (code == response) {
+			// The data ends with a line holding a single period, the
+			// status line's \r\n counts for an empty body.
+			std::string::size_type search = eol;
+			while ((end = pending.find("\r\n.\r\n", search)) == std::string::npos) {
+				if (pending.length() > eol + 4)
+					search = pending.length() - 4;
+				fill();
+			}
+			end += 5;
+		}
+
+		// Hand over the whole buffer when it holds just this response.
+		if (pendingoffset == 0 && end == pending.length()) {
+			finalbuffer.swap(pending);
+			pending.clear();
+		} else
+			finalbuffer.assign(pending, pendingoffset, end - pendingoffset);
+
+		pendingoffset = end;
+		if (pendingoffset >= pending.length()) {
+			pending.clear();
+			pendingoffset = 0;
+		} else if (pendingoffset > 1048576) {
+			pending.erase(0, pendingoffset);
+			pendingoffset = 0;
+		}
+		return code == response;
+	}
+
+	/**
+	 * When the first byte of the last response read by
+	 * read_response arrived.
+	 *
+	 * @note If it came in the same chunk as the previous response,
+	 * this is when that chunk was read.
+	 * @private
+	 */
+	std::chrono::steady_clock::time_point socket::firstbyte() const {
+		return started;
+	}
+
+	/**
+	 * Set the bandwidth limits applied to every read.
+	 *
+	 * @private
+	 *
+	 * @param global = Limit shared by every server, NULL for none.
+	 * @param server = Limit of this server, NULL for none.
+	 */
+	void socket::setlimiters(ratelimiter *global, ratelimiter *server) {
+		globallimit = global;
+		serverlimit = server;
+	}
+
+	/**
+	 * Sleep as long as the bandwidth limits require after a read.
+	 *
+	 * @private
+	 *
+	 * @param bytes = Amount of bytes read.
+	 */
+	void socket::throttle(const size_t &bytes) {
+		if (serverlimit != NULL)
+			serverlimit->consume(bytes);
+		if (globallimit != NULL)
+			globallimit->consume(bytes);
+	}
+
+	/**
+	 * Read the next chunk from usenet into pending.
+	 *
+	 * @private
+	 */
+	void socket::fill() {
+		const std::string::size_type used = pending.length();
+		// Smaller reads when a limit is set, so the flow stays smooth.
+		unsigned long size = 65536;
+		if (serverlimit != NULL)
+			size = serverlimit->chunk(size);
+		if (globallimit != NULL)
+			size = globallimit->chunk(size);
+		pending.resize(used + size);
+		try {
+			size_t bytesRead;
+			if (tcp_sock != NULL)
+				bytesRead = tcp_sock->read_some(boost::asio::buffer(&pending[used], size));
+			else
+				bytesRead = ssl_sock->read_some(boost::asio::buffer(&pending[used], size));
+			pending.resize(used + bytesRead);
+			filled = std::chrono::steady_clock::now();
+			throttle(bytesRead);
+		} catch (boost::system::system_error& error) {
+			pending.resize(used);
+			throw NNTPSockException(error.what());
+		}
+	}
+
 	/**
 	 * Read a single line response from usenet, return the response
 	 * code.
@@ -312,6 +478,7 @@ namespace cppnntp {
 					bytesRead = tcp_sock->read_some(boost::asio::buffer(buffer));
 				else
 					bytesRead = ssl_sock->read_some(boost::asio::buffer(buffer));
+				throttle(bytesRead);
 
 				// Prints the buffer sent from usenet.
 				if (echocli)
@@ -361,6 +528,7 @@ namespace cppnntp {
 					bytesRead = tcp_sock->read_some(boost::asio::buffer(buffer));
 				else
 					bytesRead = ssl_sock->read_some(boost::asio::buffer(buffer));
+				throttle(bytesRead);
 
 				// Prints the buffer sent from usenet.
 				if (echocli)
@@ -410,6 +578,7 @@ namespace cppnntp {
 					bytesRead = tcp_sock->read_some(boost::asio::buffer(buffer));
 				else
 					bytesRead = ssl_sock->read_some(boost::asio::buffer(buffer));
+				throttle(bytesRead);
 
 				// Prints the buffer sent from usenet.
 				if (echocli)
@@ -467,6 +636,7 @@ namespace cppnntp {
 					bytesRead = tcp_sock->read_some(boost::asio::buffer(buffer));
 				else
 					bytesRead = ssl_sock->read_some(boost::asio::buffer(buffer));
+				throttle(bytesRead);
 
 				// Prints the buffer sent from usenet without .CRLF
 				if (echocli)
@@ -515,39 +685,71 @@ namespace cppnntp {
 		if (compress && compression)
 			return read_compressed_lines(response, finalbuffer);
 
-		// Read until we find the period.
+		// Read into blocks, then copy them once.
+		bufferchain chain;
+		const bool success = read_lines(response, chain);
+		finalbuffer.reserve(finalbuffer.length() + chain.size());
+		for (unsigned long i = 0; i < chain.chunks(); i++) {
+			unsigned long length;
+			const char *data = chain.chunk(i, length);
+			finalbuffer.append(data, length);
+		}
+		return success;
+	}
+
+	/**
+	 * Read lines sent back from usenet straight into a chain of
+	 * blocks until the buffer ends with .CRLF, then verify the
+	 * expected response code.
+	 *
+	 * @note Big responses (XOVER, HDR, LIST ACTIVE) grow 1 block
+	 * at a time without being moved. On a wrong response code the
+	 * chain holds what was read so the caller can look at it.
+	 * @private
+	 *
+	 * @param  response = The expected response from the NNTP server
+	 *                    for the passed command.
+	 * @param     chain = Where the buffer is stored, it is emptied first.
+	 * @param  compress = Will the buffer be gzip compressed
+	 *                    (usually over/xover commands).
+	 * @return     bool = Did we succeed?
+	 */
+	bool socket::read_lines(const responsecodes &response,
+		bufferchain &chain, const bool &compress) {
+		chain.clear();
+
+		// The compressed buffer is inflated in a string.
+		if (compress && compression) {
+			std::string finalbuffer;
+			const bool success = read_compressed_lines(response, finalbuffer);
+			chain.append(finalbuffer.data(), finalbuffer.length());
+			return success;
+		}
+
+		// Read until the buffer ends with the terminator.
 		try {
-			bool done = false;
-			std::string resp = "";
+			bool checked = false;
 			do {
-				// Create an array, max 1024 chars to store the buffer.
-				boost::array<char, 1024> buffer;
-
-				// Store the buffer into the array, get the array size.
+				// Read in the free space of the last block.
+				unsigned long room;
+				char *space = chain.tail(room);
 				size_t bytesRead;
 				if (tcp_sock != NULL)
-					bytesRead = tcp_sock->read_some(boost::asio::buffer(buffer));
+					bytesRead = tcp_sock->read_some(boost::asio::buffer(space, room));
 				else
-					bytesRead = ssl_sock->read_some(boost::asio::buffer(buffer));
-
-				// Append the current buffer to the final buffer.
-				unsigned short iter = 0;
-				while (iter < bytesRead)
-					finalbuffer += buffer[iter++];
-
-				// Get the 3 first chars of the first buffer, the response.
-				if (resp == "") {
-					resp = resp + buffer[0] + buffer[1] + buffer[2];
-					if (std::stoi(resp) != response)
+					bytesRead = ssl_sock->read_some(boost::asio::buffer(space, room));
+				throttle(bytesRead);
+				chain.commit(bytesRead);
+
+				// Get the 3 first chars, the response.
+				if (!checked && chain.size() >= 3) {
+					checked = true;
+					const int code = (chain[0] - '0') * 100
+						+ (chain[1] - '0') * 10 + (chain[2] - '0');
+					if (code != response)
 						return false;
 				}
-
-				// Look for the terminator (.\r\n)
-				if (buffer[bytesRead-3] == '.'
-					&& buffer[bytesRead-2] == '\r'
-					&& buffer[bytesRead-1] == '\n')
-					done = true;
-			} while (!done);
+			} while (!chain.endswith("\r\n.\r\n", 5));
 		} catch (boost::system::system_error& error) {
 			throw NNTPSockException(error.what());
 			return false;
@@ -580,6 +782,7 @@ namespace cppnntp {
 					bytesRead = tcp_sock->read_some(boost::asio::buffer(buffer));
 				else
 					bytesRead = ssl_sock->read_some(boost::asio::buffer(buffer));
+				throttle(bytesRead);
 
 				// Append the current buffer to the final buffer.
 				unsigned short iter = 0;
@@ -2,10 +2,13 @@
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
 #include <boost/asio/ssl.hpp>
+#include <chrono>
 #include <iostream>
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
+#include "bufferchain.hpp"
+#include "ratelimiter.hpp"
 #include "responsecodes.hpp"
 
 namespace cppnntp
@@ -52,6 +55,55 @@ namespace cppnntp
 		 */
 		bool compression = false;
 
+		/**
+		 * Bytes read from usenet but not returned yet by
+		 * read_response (the start of the next pipelined response).
+		 *
+		 * @private
+		 */
+		std::string pending;
+
+		/**
+		 * Position of the first unread byte in pending.
+		 *
+		 * @private
+		 */
+		unsigned long pendingoffset = 0;
+
+		/**
+		 * When the last chunk was read into pending, and when the
+		 * first byte of the last response of read_response arrived.
+		 *
+		 * @private
+		 */
+		std::chrono::steady_clock::time_point filled;
+		std::chrono::steady_clock::time_point started;
+
+		/**
+		 * Bandwidth limits shared by every server and of this
+		 * server, NULL when not set.
+		 *
+		 * @private
+		 */
+		ratelimiter *globallimit = NULL;
+		ratelimiter *serverlimit = NULL;
+
+		/**
+		 * Read the next chunk from usenet into pending.
+		 *
+		 * @private
+		 */
+		void fill();
+
+		/**
+		 * Sleep as long as the bandwidth limits require after a read.
+		 *
+		 * @private
+		 *
+		 * @param bytes = Amount of bytes read.
+		 */
+		void throttle(const size_t &bytes);
+
 	public:
 		/**
 		 * Constructor.
@@ -142,6 +194,57 @@ namespace cppnntp
 		 */
 		bool send_command(const std::string command);
 
+		/**
+		 * Pass several commands to usenet in 1 write, without waiting
+		 * for the responses (pipelining).
+		 *
+		 * @note Read the responses in order with read_response.
+		 * @private
+		 *
+		 * @param  commands = The commands, each ending with \r\n.
+		 * @return    bool = Did we succeed?
+		 */
+		bool send_commands(const std::string &commands);
+
+		/**
+		 * Read exactly 1 response, keeping anything after it for
+		 * the next call, so responses to pipelined commands can be
+		 * read back to back.
+		 *
+		 * @note Do not mix with the read_line(s) functions while
+		 * responses are pending.
+		 * @private
+		 *
+		 * @param     response = The expected multi line response code.
+		 * @param  finalbuffer = Where the response is stored: the status
+		 *                       line, and if the code was the expected one,
+		 *                       the data up to and including (.\r\n).
+		 * @param         code = Where the response code is stored.
+		 * @return        bool = Was it the expected response?
+		 */
+		bool read_response(const responsecodes &response,
+				std::string &finalbuffer, unsigned short &code);
+
+		/**
+		 * Set the bandwidth limits applied to every read.
+		 *
+		 * @private
+		 *
+		 * @param global = Limit shared by every server, NULL for none.
+		 * @param server = Limit of this server, NULL for none.
+		 */
+		void setlimiters(ratelimiter *global, ratelimiter *server);
+
+		/**
+		 * When the first byte of the last response read by
+		 * read_response arrived.
+		 *
+		 * @note If it came in the same chunk as the previous response,
+		 * this is when that chunk was read.
+		 * @private
+		 */
+		std::chrono::steady_clock::time_point firstbyte() const;
+
 		/**
 		 * Read a single line response from usenet, return the response
 		 * code.
@@ -216,6 +319,26 @@ namespace cppnntp
 		bool read_lines(const responsecodes &response,
 				std::string &finalbuffer, const bool &compress = false);
 
+		/**
+		 * Read lines sent back from usenet straight into a chain of
+		 * blocks until the buffer ends with .CRLF, then verify the
+		 * expected response code.
+		 *
+		 * @note Big responses (XOVER, HDR, LIST ACTIVE) grow 1 block
+		 * at a time without being moved. On a wrong response code the
+		 * chain holds what was read so the caller can look at it.
+		 * @private
+		 *
+		 * @param  response = The expected response from the NNTP server
+		 *                    for the passed command.
+		 * @param     chain = Where the buffer is stored, it is emptied first.
+		 * @param  compress = Will the buffer be gzip compressed
+		 *                    (usually over/xover commands).
+		 * @return     bool = Did we succeed?
+		 */
+		bool read_lines(const responsecodes &response,
+				bufferchain &chain, const bool &compress = false);
+
 		/**
 		 * Read lines sent back from usenet used when using gzip compress.
 		 *
@@ -239,7 +362,7 @@ namespace cppnntp
 	/**
 	 * Exceptions for class socket.
 	 */
-	class NNTPSockException : std::runtime_error
+	class NNTPSockException : public std::runtime_error
 	{
 		public: NNTPSockException(const std::string& error) : runtime_error(error) {
 		}
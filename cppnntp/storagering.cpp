@@ -0,0 +1,252 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef CPPNNTP_IO_URING
+#include <liburing.h>
+#endif
+#include "storagering.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param    entries = Size of the submission queue.
+	 * @param    buffers = Amount of registered buffers.
+	 * @param buffersize = Size of each registered buffer.
+	 */
+	storagering::storagering(const unsigned int &entries, const unsigned int &buffers,
+			const unsigned long &buffersize) {
+#ifdef CPPNNTP_IO_URING
+		this->entries = entries ? entries : 1;
+		ring = new struct io_uring;
+		if (io_uring_queue_init(this->entries, ring, 0) < 0) {
+			delete ring;
+			ring = NULL;
+			return;
+		}
+
+		// The registered buffers are optional (the kernel can refuse them
+		// over RLIMIT_MEMLOCK), without them the caller's buffers are used.
+		std::vector<struct iovec> vectors;
+		for (unsigned int i = 0; i < buffers; i++) {
+			void *memory = NULL;
+			if (::posix_memalign(&memory, 4096, buffersize) != 0)
+				break;
+			this->buffers.push_back(static_cast<char *>(memory));
+			struct iovec vector;
+			vector.iov_base = memory;
+			vector.iov_len = buffersize;
+			vectors.push_back(vector);
+		}
+		if (!vectors.empty() && io_uring_register_buffers(ring, vectors.data(), vectors.size()) == 0) {
+			this->buffersize = buffersize;
+			for (unsigned long i = 0; i < this->buffers.size(); i++)
+				freebuffers.push_back(i);
+		} else {
+			for (unsigned long i = 0; i < this->buffers.size(); i++)
+				::free(this->buffers[i]);
+			this->buffers.clear();
+		}
+#else
+		static_cast<void>(entries);
+		static_cast<void>(buffers);
+		static_cast<void>(buffersize);
+#endif
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	storagering::~storagering() {
+#ifdef CPPNNTP_IO_URING
+		stop();
+		for (unsigned long i = 0; i < buffers.size(); i++)
+			::free(buffers[i]);
+#endif
+	}
+
+	/**
+	 * Can the ring be used?
+	 *
+	 * @public
+	 *
+	 * @return bool = Was io_uring built in and set up?
+	 */
+	bool storagering::available() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return ring != NULL;
+	}
+
+	/**
+	 * Write a batch, returns once every request completed or failed.
+	 *
+	 * @note Short writes are resubmitted for the rest.
+	 * @public
+	 *
+	 * @param batch = The requests, ok is set on each.
+	 */
+	void storagering::write(std::vector<request> &batch) {
+		for (unsigned long i = 0; i < batch.size(); i++)
+			batch[i].ok = false;
+#ifdef CPPNNTP_IO_URING
+		std::lock_guard<std::mutex> guard(lock);
+		if (ring == NULL)
+			return;
+
+		// Bytes written and registered buffer (-1 for none) of each request.
+		std::vector<unsigned long> done(batch.size(), 0);
+		std::vector<int> buffer(batch.size(), -1);
+		std::deque<unsigned long> waiting;
+		for (unsigned long i = 0; i < batch.size(); i++) {
+			if (batch[i].length == 0)
+				batch[i].ok = true;
+			else
+				waiting.push_back(i);
+		}
+
+		unsigned long inflight = 0;
+		while (!waiting.empty() || inflight > 0) {
+			// Fill the submission queue.
+			while (!waiting.empty() && inflight < entries) {
+				struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+				if (sqe == NULL)
+					break;
+				const unsigned long i = waiting.front();
+				waiting.pop_front();
+				const request &r = batch[i];
+				if (buffer[i] < 0 && done[i] == 0 && r.length <= buffersize && !freebuffers.empty()) {
+					buffer[i] = freebuffers.back();
+					freebuffers.pop_back();
+					std::memcpy(buffers[buffer[i]], r.data, r.length);
+				}
+
+				// The length of 1 write is 32 bits.
+				unsigned long rest = r.length - done[i];
+				if (rest > 1073741824)
+					rest = 1073741824;
+				if (buffer[i] >= 0)
+					io_uring_prep_write_fixed(sqe, r.fd, buffers[buffer[i]] + done[i], rest,
+							r.offset + done[i], buffer[i]);
+				else
+					io_uring_prep_write(sqe, r.fd, r.data + done[i], rest, r.offset + done[i]);
+				io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(static_cast<uintptr_t>(i)));
+				inflight++;
+			}
+
+			const int submitted = io_uring_submit_and_wait(ring, 1);
+			if (submitted < 0 && submitted != -EINTR && submitted != -EAGAIN && submitted != -EBUSY) {
+				// The ring is broken, the callers go back to pwrite. What
+				// was not submitted yet is reported as failed.
+				stop();
+				break;
+			}
+
+			struct io_uring_cqe *cqe = NULL;
+			while (inflight > 0 && io_uring_peek_cqe(ring, &cqe) == 0) {
+				const unsigned long i = static_cast<unsigned long>(
+						reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+				const int result = cqe->res;
+				io_uring_cqe_seen(ring, cqe);
+				inflight--;
+
+				if (result == -EINTR || result == -EAGAIN) {
+					waiting.push_back(i);
+					continue;
+				}
+				if (result > 0) {
+					done[i] += result;
+					if (done[i] < batch[i].length) {
+						waiting.push_back(i);
+						continue;
+					}
+					batch[i].ok = true;
+				}
+				if (buffer[i] >= 0) {
+					freebuffers.push_back(buffer[i]);
+					buffer[i] = -1;
+				}
+			}
+		}
+#endif
+	}
+
+	/**
+	 * Close a file, optionally flushing its data first.
+	 *
+	 * @public
+	 *
+	 * @param   fd = The file descriptor.
+	 * @param sync = Flush the data to the disk before closing?
+	 * @return bool = Did it flush and close without errors?
+	 */
+	bool storagering::close(const int &fd, const bool &sync) {
+#ifdef CPPNNTP_IO_URING
+		std::unique_lock<std::mutex> guard(lock);
+		if (ring != NULL) {
+			// The close is linked to the fsync, it only runs once the
+			// data is on the disk, both are submitted together.
+			struct io_uring_sqe *flush = sync ? io_uring_get_sqe(ring) : NULL;
+			struct io_uring_sqe *closing = io_uring_get_sqe(ring);
+			if ((!sync || flush != NULL) && closing != NULL) {
+				if (sync) {
+					io_uring_prep_fsync(flush, fd, IORING_FSYNC_DATASYNC);
+					io_uring_sqe_set_flags(flush, IOSQE_IO_LINK);
+					io_uring_sqe_set_data(flush, NULL);
+				}
+				io_uring_prep_close(closing, fd);
+				io_uring_sqe_set_data(closing, reinterpret_cast<void *>(static_cast<uintptr_t>(1)));
+
+				const unsigned int count = sync ? 2 : 1;
+				int submitted;
+				do {
+					submitted = io_uring_submit_and_wait(ring, count);
+				} while (submitted == -EINTR);
+				if (submitted < 0)
+					stop();
+
+				bool flushed = !sync;
+				int closed = -ECANCELED;
+				for (unsigned int i = 0; i < count && submitted >= 0; i++) {
+					struct io_uring_cqe *cqe = NULL;
+					if (io_uring_wait_cqe(ring, &cqe) != 0)
+						break;
+					if (io_uring_cqe_get_data(cqe) == NULL)
+						flushed = cqe->res == 0;
+					else
+						closed = cqe->res;
+					io_uring_cqe_seen(ring, cqe);
+				}
+				// A failed fsync cancels the close, old kernels can not close.
+				if (closed == -ECANCELED || closed == -EINVAL)
+					closed = ::close(fd);
+				return flushed && closed == 0;
+			}
+		}
+		guard.unlock();
+#endif
+		const bool flushed = !sync || ::fdatasync(fd) == 0;
+		return ::close(fd) == 0 && flushed;
+	}
+
+	/**
+	 * Tear the ring down, the callers go back to pwrite.
+	 *
+	 * @private
+	 */
+	void storagering::stop() {
+#ifdef CPPNNTP_IO_URING
+		if (ring != NULL) {
+			io_uring_queue_exit(ring);
+			delete ring;
+			ring = NULL;
+		}
+#endif
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+struct io_uring;
+
+namespace cppnntp
+{
+	/**
+	 * Writes batches of buffers to files with io_uring.
+	 *
+	 * @note A batch is submitted with 1 system call and its
+	 * completions are reaped together, instead of 1 pwrite per
+	 * segment. Segments that fit are copied into buffers registered
+	 * with the kernel once, so their pages are not pinned again on
+	 * every write. Closing a file queues an fsync linked to the
+	 * close, so both go in 1 submission.
+	 * Only built when CPPNNTP_IO_URING is defined (see CMakeLists.txt),
+	 * otherwise, or when the kernel refuses the ring, available()
+	 * is false and the caller uses pwrite.
+	 * Thread safe, batches are written 1 at a time.
+	 */
+	class storagering
+	{
+	public:
+		/**
+		 * A buffer to write.
+		 */
+		struct request
+		{
+			int fd;
+			const char *data;
+			unsigned long length;
+			unsigned long offset;
+
+			/**
+			 * Set by write, was it all written?
+			 */
+			bool ok;
+		};
+
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param    entries = Size of the submission queue.
+		 * @param    buffers = Amount of registered buffers.
+		 * @param buffersize = Size of each registered buffer.
+		 */
+		storagering(const unsigned int &entries = 64, const unsigned int &buffers = 16,
+				const unsigned long &buffersize = 1048576);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~storagering();
+
+		/**
+		 * Can the ring be used?
+		 *
+		 * @public
+		 *
+		 * @return bool = Was io_uring built in and set up?
+		 */
+		bool available() const;
+
+		/**
+		 * Write a batch, returns once every request completed or failed.
+		 *
+		 * @note Short writes are resubmitted for the rest.
+		 * @public
+		 *
+		 * @param batch = The requests, ok is set on each.
+		 */
+		void write(std::vector<request> &batch);
+
+		/**
+		 * Close a file, optionally flushing its data first.
+		 *
+		 * @public
+		 *
+		 * @param   fd = The file descriptor.
+		 * @param sync = Flush the data to the disk before closing?
+		 * @return bool = Did it flush and close without errors?
+		 */
+		bool close(const int &fd, const bool &sync);
+
+	private:
+		/**
+		 * The ring, NULL when not available.
+		 *
+		 * @private
+		 */
+		struct io_uring *ring = NULL;
+
+		/**
+		 * Size of the submission queue.
+		 *
+		 * @private
+		 */
+		unsigned int entries = 0;
+
+		/**
+		 * The registered buffers, their size, and the ones not in use.
+		 *
+		 * @private
+		 */
+		std::vector<char *> buffers;
+		unsigned long buffersize = 0;
+		std::vector<int> freebuffers;
+
+		/**
+		 * 1 batch at a time.
+		 *
+		 * @private
+		 */
+		mutable std::mutex lock;
+
+		/**
+		 * Tear the ring down, the callers go back to pwrite.
+		 *
+		 * @private
+		 */
+		void stop();
+	};
+}
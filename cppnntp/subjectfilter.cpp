@@ -0,0 +1,722 @@
+#include <algorithm>
+#include "subjectfilter.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param     icase = Ignore the case of letters?
+	 * @param maxstates = Amount of DFA states to cache before
+	 * the cache is emptied.
+	 */
+	subjectfilter::subjectfilter(const bool &icase, const unsigned int &maxstates)
+		: icase(icase), maxstates(maxstates < 16 ? 16 : maxstates) {}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	subjectfilter::~subjectfilter() {}
+
+	/**
+	 * Add a pattern.
+	 *
+	 * @public
+	 * @throws SubjectFilterException on invalid patterns.
+	 *
+	 * @param pattern = The pattern.
+	 * @return The id of the pattern, in the order they were added
+	 * starting from 0.
+	 */
+	unsigned int subjectfilter::add(const std::string &pattern) {
+		if (pattern.empty())
+			throw SubjectFilterException("Subject filter: empty pattern.");
+
+		// Split off the anchors, a $ is literal when escaped.
+		unsigned long first = 0, last = pattern.length();
+		const bool anchored = pattern[0] == '^';
+		if (anchored)
+			first++;
+		unsigned long backslashes = 0;
+		while (backslashes + 1 < last && pattern[last - 2 - backslashes] == '\\')
+			backslashes++;
+		const bool endanchored = last > first && pattern[last - 1] == '$' && backslashes % 2 == 0;
+		if (endanchored)
+			last--;
+
+		const std::string body = pattern.substr(first, last - first);
+		const unsigned long setcount = sets.size();
+		node root;
+		try {
+			unsigned long pos = 0;
+			root = parsealternate(body, pos, 0);
+			if (pos != body.length())
+				throw SubjectFilterException("Subject filter: unmatched ).");
+		} catch (SubjectFilterException &e) {
+			sets.resize(setcount);
+			throw SubjectFilterException(std::string(e.what()) + " (pattern: " + pattern + ")");
+		}
+
+		const unsigned int id = patterns.size();
+		const int match = addstate(endanchored ? MATCHEND : MATCH, id, -1, -1);
+		const int start = build(root, match);
+		if (anchored)
+			anchoredstarts.push_back(start);
+		else
+			starts.push_back(start);
+
+		patterns.push_back(pattern);
+		compiled = false;
+		return id;
+	}
+
+	/**
+	 * Amount of patterns.
+	 *
+	 * @public
+	 */
+	unsigned int subjectfilter::size() const {
+		return patterns.size();
+	}
+
+	/**
+	 * Get a pattern by id.
+	 *
+	 * @public
+	 *
+	 * @param id = The id.
+	 * @return The pattern.
+	 */
+	const std::string &subjectfilter::pattern(const unsigned int &id) const {
+		return patterns.at(id);
+	}
+
+	/**
+	 * Find every pattern matching a subject.
+	 *
+	 * @public
+	 *
+	 * @param subject = The subject.
+	 * @param     ids = Where the ids of the matching patterns are
+	 * stored, in increasing order.
+	 * @return   bool = Did any pattern match?
+	 */
+	bool subjectfilter::match(const field &subject, std::vector<unsigned int> &ids) {
+		if (!compiled)
+			compile();
+
+		ids.clear();
+		if (seen.size() < patterns.size())
+			seen.resize(patterns.size(), 0);
+		if (++round == 0) {
+			std::fill(seen.begin(), seen.end(), 0);
+			round = 1;
+		}
+
+		const unsigned long width = representatives.size();
+		const unsigned char *pos = reinterpret_cast<const unsigned char *>(subject.data);
+		const unsigned char *end = pos + subject.length;
+		int current = 0;
+		collect(dfa[0].accepts, ids);
+		for (; pos < end; pos++) {
+			const unsigned char klass = classes[*pos];
+			int next = transitions[current * width + klass];
+			if (next < 0)
+				next = step(current, klass);
+			current = next;
+			if (!dfa[current].accepts.empty())
+				collect(dfa[current].accepts, ids);
+		}
+		collect(dfa[current].endaccepts, ids);
+
+		std::sort(ids.begin(), ids.end());
+		return !ids.empty();
+	}
+
+	/**
+	 * Does any pattern match a subject?
+	 *
+	 * @note Stops at the first match.
+	 * @public
+	 *
+	 * @param subject = The subject.
+	 * @return   bool = Did any pattern match?
+	 */
+	bool subjectfilter::matches(const field &subject) {
+		if (!compiled)
+			compile();
+
+		const unsigned long width = representatives.size();
+		const unsigned char *pos = reinterpret_cast<const unsigned char *>(subject.data);
+		const unsigned char *end = pos + subject.length;
+		int current = 0;
+		if (!dfa[0].accepts.empty())
+			return true;
+		for (; pos < end; pos++) {
+			const unsigned char klass = classes[*pos];
+			int next = transitions[current * width + klass];
+			if (next < 0)
+				next = step(current, klass);
+			current = next;
+			if (!dfa[current].accepts.empty())
+				return true;
+		}
+		return !dfa[current].endaccepts.empty();
+	}
+
+	/**
+	 * Does any pattern match a subject?
+	 *
+	 * @public
+	 *
+	 * @param subject = The subject.
+	 * @return   bool = Did any pattern match?
+	 */
+	bool subjectfilter::matches(const std::string &subject) {
+		field f = { subject.data(), subject.length() };
+		return matches(f);
+	}
+
+	/**
+	 * Amount of DFA states currently cached.
+	 *
+	 * @public
+	 */
+	unsigned long subjectfilter::states() const {
+		return dfa.size();
+	}
+
+	/**
+	 * Remove every pattern.
+	 *
+	 * @public
+	 */
+	void subjectfilter::clear() {
+		patterns.clear();
+		sets.clear();
+		nfa.clear();
+		anchoredstarts.clear();
+		starts.clear();
+		dfa.clear();
+		transitions.clear();
+		dfaindex.clear();
+		compiled = false;
+	}
+
+	/**
+	 * Parse the alternatives of a pattern.
+	 *
+	 * @private
+	 *
+	 * @param pattern = The pattern.
+	 * @param     pos = Current position in the pattern.
+	 * @param   depth = Nesting level of parentheses.
+	 * @return The node.
+	 */
+	subjectfilter::node subjectfilter::parsealternate(const std::string &pattern,
+			unsigned long &pos, const unsigned int &depth) {
+		node first = parseconcat(pattern, pos, depth);
+		if (pos >= pattern.length() || pattern[pos] != '|')
+			return first;
+
+		node alternate;
+		alternate.kind = node::ALTERNATE;
+		alternate.children.push_back(first);
+		while (pos < pattern.length() && pattern[pos] == '|') {
+			pos++;
+			alternate.children.push_back(parseconcat(pattern, pos, depth));
+		}
+		return alternate;
+	}
+
+	/**
+	 * Parse a sequence of atoms.
+	 *
+	 * @private
+	 *
+	 * @param pattern = The pattern.
+	 * @param     pos = Current position in the pattern.
+	 * @param   depth = Nesting level of parentheses.
+	 * @return The node.
+	 */
+	subjectfilter::node subjectfilter::parseconcat(const std::string &pattern,
+			unsigned long &pos, const unsigned int &depth) {
+		node sequence;
+		sequence.kind = node::CONCAT;
+		while (pos < pattern.length() && pattern[pos] != '|' && pattern[pos] != ')')
+			sequence.children.push_back(parseatom(pattern, pos, depth));
+
+		if (pos < pattern.length() && pattern[pos] == ')' && depth == 0)
+			throw SubjectFilterException("Subject filter: unmatched ).");
+
+		if (sequence.children.empty())
+			sequence.kind = node::EMPTY;
+		else if (sequence.children.size() == 1)
+			return sequence.children[0];
+		return sequence;
+	}
+
+	/**
+	 * Parse an atom.
+	 *
+	 * @private
+	 *
+	 * @param pattern = The pattern.
+	 * @param     pos = Current position in the pattern.
+	 * @param   depth = Nesting level of parentheses.
+	 * @return The node.
+	 */
+	subjectfilter::node subjectfilter::parseatom(const std::string &pattern,
+			unsigned long &pos, const unsigned int &depth) {
+		node atom;
+		atom.kind = node::CHARS;
+		const char c = pattern[pos++];
+		switch (c) {
+			case '(':
+				// Groups never capture, (?:...) is the same as (...).
+				if (pattern.compare(pos, 2, "?:") == 0)
+					pos += 2;
+				atom = parsealternate(pattern, pos, depth + 1);
+				if (pos >= pattern.length() || pattern[pos] != ')')
+					throw SubjectFilterException("Subject filter: missing ).");
+				pos++;
+				break;
+			case '[':
+				atom.set = parseclass(pattern, pos);
+				break;
+			case '.':
+				atom.set = addset(std::bitset<256>().set(), false);
+				break;
+			case '\\': {
+				std::bitset<256> set;
+				parseescape(pattern, pos, set);
+				atom.set = addset(set, false);
+				break;
+			}
+			case '*':
+			case '+':
+			case '?':
+				throw SubjectFilterException("Subject filter: nothing to repeat before " + std::string(1, c) + ".");
+			case '^':
+			case '$':
+				throw SubjectFilterException("Subject filter: ^ and $ are only supported at the start and end.");
+			default: {
+				std::bitset<256> set;
+				set.set(static_cast<unsigned char>(c));
+				atom.set = addset(set, false);
+			}
+		}
+
+		// Repeats, a ? after a repeat (lazy) changes nothing here.
+		while (pos < pattern.length()) {
+			node repeat;
+			const char r = pattern[pos];
+			if (r == '*')
+				repeat.kind = node::STAR;
+			else if (r == '+')
+				repeat.kind = node::PLUS;
+			else if (r == '?')
+				repeat.kind = node::QUESTION;
+			else if (r == '{') {
+				// {n}, {n,} or {n,m}, anything else is a literal {.
+				unsigned long end = pos + 1, low = 0, high = 0;
+				bool digits = false, comma = false, highdigits = false;
+				for (; end < pattern.length() && pattern[end] != '}'; end++) {
+					if (pattern[end] >= '0' && pattern[end] <= '9') {
+						if (comma) {
+							high = high * 10 + (pattern[end] - '0');
+							highdigits = true;
+						} else {
+							low = low * 10 + (pattern[end] - '0');
+							digits = true;
+						}
+						if (low > 1000 || high > 1000)
+							throw SubjectFilterException("Subject filter: repeat count over 1000.");
+					} else if (pattern[end] == ',' && !comma)
+						comma = true;
+					else
+						break;
+				}
+				if (!digits || end >= pattern.length() || pattern[end] != '}')
+					break;
+				if (!comma)
+					high = low;
+				if (highdigits && high < low)
+					throw SubjectFilterException("Subject filter: invalid repeat range.");
+				pos = end + 1;
+
+				repeat.kind = node::CONCAT;
+				for (unsigned long i = 0; i < low; i++)
+					repeat.children.push_back(atom);
+				if (comma && !highdigits) {
+					node star;
+					star.kind = node::STAR;
+					star.children.push_back(atom);
+					repeat.children.push_back(star);
+				} else {
+					for (unsigned long i = low; i < high; i++) {
+						node question;
+						question.kind = node::QUESTION;
+						question.children.push_back(atom);
+						repeat.children.push_back(question);
+					}
+				}
+				if (repeat.children.empty())
+					repeat.kind = node::EMPTY;
+				atom = repeat;
+				continue;
+			} else
+				break;
+
+			pos++;
+			repeat.children.push_back(atom);
+			atom = repeat;
+		}
+		return atom;
+	}
+
+	/**
+	 * Parse a [...] class, pos is after the [.
+	 *
+	 * @private
+	 *
+	 * @param pattern = The pattern.
+	 * @param     pos = Current position in the pattern.
+	 * @return Id of the set.
+	 */
+	unsigned int subjectfilter::parseclass(const std::string &pattern, unsigned long &pos) {
+		std::bitset<256> set;
+		bool negated = false;
+		if (pos < pattern.length() && pattern[pos] == '^') {
+			negated = true;
+			pos++;
+		}
+
+		// A ] right after the [ or [^ is literal.
+		bool first = true;
+		while (true) {
+			if (pos >= pattern.length())
+				throw SubjectFilterException("Subject filter: missing ].");
+			if (pattern[pos] == ']' && !first) {
+				pos++;
+				break;
+			}
+			first = false;
+
+			unsigned char low = pattern[pos++];
+			if (low == '\\') {
+				std::bitset<256> escaped;
+				parseescape(pattern, pos, escaped);
+				if (escaped.count() != 1) {
+					set |= escaped;
+					continue;
+				}
+				for (low = 0; !escaped[low]; low++) {}
+			}
+
+			if (pos + 1 < pattern.length() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+				pos++;
+				unsigned char high = pattern[pos++];
+				if (high == '\\') {
+					std::bitset<256> escaped;
+					parseescape(pattern, pos, escaped);
+					if (escaped.count() != 1)
+						throw SubjectFilterException("Subject filter: invalid range in [].");
+					for (high = 0; !escaped[high]; high++) {}
+				}
+				if (high < low)
+					throw SubjectFilterException("Subject filter: invalid range in [].");
+				for (unsigned int i = low; i <= high; i++)
+					set.set(i);
+			} else
+				set.set(low);
+		}
+		return addset(set, negated);
+	}
+
+	/**
+	 * Parse an escape, pos is after the \.
+	 *
+	 * @private
+	 *
+	 * @param pattern = The pattern.
+	 * @param     pos = Current position in the pattern.
+	 * @param     set = Where the characters are added.
+	 */
+	void subjectfilter::parseescape(const std::string &pattern, unsigned long &pos,
+			std::bitset<256> &set) {
+		if (pos >= pattern.length())
+			throw SubjectFilterException("Subject filter: trailing \\.");
+
+		std::bitset<256> digits, words, spaces;
+		for (unsigned int i = '0'; i <= '9'; i++)
+			digits.set(i);
+		words = digits;
+		for (unsigned int i = 'a'; i <= 'z'; i++)
+			words.set(i).set(i - 'a' + 'A');
+		words.set('_');
+		spaces.set(' ').set('\t').set('\r').set('\n').set('\f').set('\v');
+
+		const char c = pattern[pos++];
+		switch (c) {
+			case 'd': set |= digits; break;
+			case 'D': set |= ~digits; break;
+			case 'w': set |= words; break;
+			case 'W': set |= ~words; break;
+			case 's': set |= spaces; break;
+			case 'S': set |= ~spaces; break;
+			case 't': set.set('\t'); break;
+			case 'n': set.set('\n'); break;
+			case 'r': set.set('\r'); break;
+			case 'f': set.set('\f'); break;
+			case 'v': set.set('\v'); break;
+			case 'x': {
+				unsigned int value = 0;
+				for (unsigned short i = 0; i < 2; i++, pos++) {
+					const char h = pos < pattern.length() ? pattern[pos] : 0;
+					if (h >= '0' && h <= '9')
+						value = value * 16 + (h - '0');
+					else if ((h | 0x20) >= 'a' && (h | 0x20) <= 'f')
+						value = value * 16 + ((h | 0x20) - 'a' + 10);
+					else
+						throw SubjectFilterException("Subject filter: \\x needs 2 hex digits.");
+				}
+				set.set(value);
+				break;
+			}
+			default:
+				if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+					throw SubjectFilterException("Subject filter: unsupported escape \\" + std::string(1, c) + ".");
+				set.set(static_cast<unsigned char>(c));
+		}
+	}
+
+	/**
+	 * Store a set, adding the other case of letters if needed.
+	 *
+	 * @private
+	 *
+	 * @param      set = The set.
+	 * @param negated = Store the characters not in the set?
+	 * @return Id of the set.
+	 */
+	unsigned int subjectfilter::addset(std::bitset<256> set, const bool &negated) {
+		if (icase) {
+			for (unsigned int i = 'a'; i <= 'z'; i++) {
+				if (set[i] || set[i - 'a' + 'A'])
+					set.set(i).set(i - 'a' + 'A');
+			}
+		}
+		if (negated)
+			set.flip();
+		sets.push_back(set);
+		return sets.size() - 1;
+	}
+
+	/**
+	 * Build the NFA states of a node.
+	 *
+	 * @private
+	 *
+	 * @param    n = The node.
+	 * @param next = The state following the node.
+	 * @return The first state of the node.
+	 */
+	int subjectfilter::build(const node &n, const int &next) {
+		switch (n.kind) {
+			case node::CHARS:
+				return addstate(CHARSET, n.set, next, -1);
+			case node::CONCAT: {
+				int first = next;
+				for (unsigned long i = n.children.size(); i-- > 0;)
+					first = build(n.children[i], first);
+				return first;
+			}
+			case node::ALTERNATE: {
+				int first = build(n.children.back(), next);
+				for (unsigned long i = n.children.size() - 1; i-- > 0;)
+					first = addstate(SPLIT, 0, build(n.children[i], next), first);
+				return first;
+			}
+			case node::STAR: {
+				const int loop = addstate(SPLIT, 0, -1, next);
+				const int body = build(n.children[0], loop);
+				nfa[loop].out = body;
+				return loop;
+			}
+			case node::PLUS: {
+				const int loop = addstate(SPLIT, 0, -1, next);
+				const int body = build(n.children[0], loop);
+				nfa[loop].out = body;
+				return body;
+			}
+			case node::QUESTION:
+				return addstate(SPLIT, 0, build(n.children[0], next), next);
+			default:
+				return next;
+		}
+	}
+
+	/**
+	 * Add a NFA state.
+	 *
+	 * @private
+	 *
+	 * @return Position of the state.
+	 */
+	int subjectfilter::addstate(const nfakind &kind, const unsigned int &value,
+			const int &out, const int &out1) {
+		nfastate s = { kind, value, out, out1 };
+		nfa.push_back(s);
+		return nfa.size() - 1;
+	}
+
+	/**
+	 * Build the byte classes and start a new DFA.
+	 *
+	 * @private
+	 */
+	void subjectfilter::compile() {
+		// Split the bytes by every set, bytes that end up together
+		// are in or out of every set.
+		unsigned int count = 1;
+		std::fill(classes, classes + 256, 0);
+		for (unsigned long s = 0; s < sets.size() && count < 256; s++) {
+			std::vector<int> renumber(count * 2, -1);
+			unsigned int next = 0;
+			for (unsigned int b = 0; b < 256; b++) {
+				int &k = renumber[classes[b] * 2 + sets[s][b]];
+				if (k < 0)
+					k = next++;
+				classes[b] = k;
+			}
+			count = next;
+		}
+
+		representatives.assign(count, 0);
+		for (unsigned int b = 256; b-- > 0;)
+			representatives[classes[b]] = b;
+
+		reset();
+		compiled = true;
+	}
+
+	/**
+	 * Empty the DFA cache, keeping only the start state.
+	 *
+	 * @private
+	 */
+	void subjectfilter::reset() {
+		dfa.clear();
+		transitions.clear();
+		dfaindex.clear();
+
+		std::vector<int> roots(anchoredstarts);
+		roots.insert(roots.end(), starts.begin(), starts.end());
+		state(roots);
+	}
+
+	/**
+	 * Get the DFA state of a set of NFA states, adding it
+	 * if needed.
+	 *
+	 * @private
+	 *
+	 * @param roots = The NFA states, before the epsilon closure.
+	 * @return The DFA state.
+	 */
+	int subjectfilter::state(const std::vector<int> &roots) {
+		if (marks.size() < nfa.size())
+			marks.resize(nfa.size(), 0);
+		if (++generation == 0) {
+			std::fill(marks.begin(), marks.end(), 0);
+			generation = 1;
+		}
+
+		// Epsilon closure, only the states that read a byte or match are kept.
+		std::vector<int> stack(roots), found;
+		while (!stack.empty()) {
+			const int s = stack.back();
+			stack.pop_back();
+			if (s < 0 || marks[s] == generation)
+				continue;
+			marks[s] = generation;
+			if (nfa[s].kind == SPLIT) {
+				stack.push_back(nfa[s].out1);
+				stack.push_back(nfa[s].out);
+			} else
+				found.push_back(s);
+		}
+		std::sort(found.begin(), found.end());
+
+		const std::string key(reinterpret_cast<const char *>(found.data()), found.size() * sizeof(int));
+		std::unordered_map<std::string, int>::const_iterator it = dfaindex.find(key);
+		if (it != dfaindex.end())
+			return it->second;
+
+		dfastate d;
+		d.nfa.swap(found);
+		for (unsigned long i = 0; i < d.nfa.size(); i++) {
+			const nfastate &s = nfa[d.nfa[i]];
+			if (s.kind == MATCH)
+				d.accepts.push_back(s.value);
+			else if (s.kind == MATCHEND)
+				d.endaccepts.push_back(s.value);
+		}
+
+		dfa.push_back(d);
+		transitions.resize(dfa.size() * representatives.size(), -1);
+		dfaindex[key] = dfa.size() - 1;
+		return dfa.size() - 1;
+	}
+
+	/**
+	 * Build the transition of a DFA state for a byte class.
+	 *
+	 * @private
+	 *
+	 * @param  from = The DFA state.
+	 * @param klass = The byte class.
+	 * @return The next DFA state.
+	 */
+	int subjectfilter::step(int from, const unsigned char &klass) {
+		// Too many states (lots of patterns and unusual subjects), start over.
+		if (dfa.size() >= maxstates) {
+			const std::vector<int> current(dfa[from].nfa);
+			reset();
+			from = state(current);
+		}
+
+		const unsigned char byte = representatives[klass];
+		std::vector<int> roots(starts);
+		const std::vector<int> &current = dfa[from].nfa;
+		for (unsigned long i = 0; i < current.size(); i++) {
+			const nfastate &s = nfa[current[i]];
+			if (s.kind == CHARSET && sets[s.value][byte])
+				roots.push_back(s.out);
+		}
+
+		const int to = state(roots);
+		transitions[from * representatives.size() + klass] = to;
+		return to;
+	}
+
+	/**
+	 * Add the patterns matched by a DFA state to a list, once each.
+	 *
+	 * @private
+	 *
+	 * @param accepts = The patterns matched.
+	 * @param     ids = The list.
+	 */
+	void subjectfilter::collect(const std::vector<unsigned int> &accepts, std::vector<unsigned int> &ids) {
+		for (unsigned long i = 0; i < accepts.size(); i++) {
+			if (seen[accepts[i]] != round) {
+				seen[accepts[i]] = round;
+				ids.push_back(accepts[i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,429 @@
+#pragma once
+#include <bitset>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Matches subjects against many patterns at once.
+	 *
+	 * @note Every pattern is compiled into 1 automaton (NFA), which is
+	 * turned into a DFA lazily while matching, so a subject is read
+	 * once no matter how many patterns there are.
+	 * Patterns are a regex subset: literals, ., [...] and [^...]
+	 * classes, \d \w \s \D \W \S \t \r \n \xHH escapes, grouping,
+	 * |, *, +, ?, {n}, {n,}, {n,m}, ^ at the start and $ at the end.
+	 * A pattern matches anywhere in the subject unless it starts with ^.
+	 * There are no back references.
+	 * Not thread safe, use 1 filter per thread.
+	 */
+	class subjectfilter
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param     icase = Ignore the case of letters?
+		 * @param maxstates = Amount of DFA states to cache before
+		 * the cache is emptied.
+		 */
+		subjectfilter(const bool &icase = true, const unsigned int &maxstates = 8192);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~subjectfilter();
+
+		/**
+		 * Add a pattern.
+		 *
+		 * @public
+		 * @throws SubjectFilterException on invalid patterns.
+		 *
+		 * @param pattern = The pattern.
+		 * @return The id of the pattern, in the order they were added
+		 * starting from 0.
+		 */
+		unsigned int add(const std::string &pattern);
+
+		/**
+		 * Amount of patterns.
+		 *
+		 * @public
+		 */
+		unsigned int size() const;
+
+		/**
+		 * Get a pattern by id.
+		 *
+		 * @public
+		 *
+		 * @param id = The id.
+		 * @return The pattern.
+		 */
+		const std::string &pattern(const unsigned int &id) const;
+
+		/**
+		 * Find every pattern matching a subject.
+		 *
+		 * @public
+		 *
+		 * @param subject = The subject.
+		 * @param     ids = Where the ids of the matching patterns are
+		 * stored, in increasing order.
+		 * @return   bool = Did any pattern match?
+		 */
+		bool match(const field &subject, std::vector<unsigned int> &ids);
+
+		/**
+		 * Does any pattern match a subject?
+		 *
+		 * @note Stops at the first match.
+		 * @public
+		 *
+		 * @param subject = The subject.
+		 * @return   bool = Did any pattern match?
+		 */
+		bool matches(const field &subject);
+
+		/**
+		 * Does any pattern match a subject?
+		 *
+		 * @public
+		 *
+		 * @param subject = The subject.
+		 * @return   bool = Did any pattern match?
+		 */
+		bool matches(const std::string &subject);
+
+		/**
+		 * Amount of DFA states currently cached.
+		 *
+		 * @public
+		 */
+		unsigned long states() const;
+
+		/**
+		 * Remove every pattern.
+		 *
+		 * @public
+		 */
+		void clear();
+
+	private:
+		/**
+		 * Kinds of NFA states.
+		 *
+		 * @private
+		 */
+		enum nfakind { SPLIT, CHARSET, MATCH, MATCHEND };
+
+		/**
+		 * A NFA state.
+		 *
+		 * @private
+		 */
+		struct nfastate
+		{
+			nfakind kind;
+			// CHARSET: the set, MATCH/MATCHEND: the pattern id.
+			unsigned int value;
+			int out;
+			int out1;
+		};
+
+		/**
+		 * A DFA state.
+		 *
+		 * @private
+		 */
+		struct dfastate
+		{
+			// The sorted NFA states (only CHARSET and match states).
+			std::vector<int> nfa;
+			// Patterns matched when this state is reached.
+			std::vector<unsigned int> accepts;
+			// Patterns matched when the subject ends in this state.
+			std::vector<unsigned int> endaccepts;
+		};
+
+		/**
+		 * A parsed pattern.
+		 *
+		 * @private
+		 */
+		struct node
+		{
+			enum { CHARS, CONCAT, ALTERNATE, STAR, PLUS, QUESTION, EMPTY } kind;
+			unsigned int set;
+			std::vector<node> children;
+		};
+
+		/**
+		 * Ignore the case of letters?
+		 *
+		 * @private
+		 */
+		bool icase;
+
+		/**
+		 * DFA states to cache before emptying the cache.
+		 *
+		 * @private
+		 */
+		unsigned int maxstates;
+
+		/**
+		 * The patterns.
+		 *
+		 * @private
+		 */
+		std::vector<std::string> patterns;
+
+		/**
+		 * Every character set used by the NFA.
+		 *
+		 * @private
+		 */
+		std::vector<std::bitset<256> > sets;
+
+		/**
+		 * The NFA.
+		 *
+		 * @private
+		 */
+		std::vector<nfastate> nfa;
+
+		/**
+		 * First NFA state of patterns starting with ^.
+		 *
+		 * @private
+		 */
+		std::vector<int> anchoredstarts;
+
+		/**
+		 * First NFA state of the other patterns, these are
+		 * restarted at every character.
+		 *
+		 * @private
+		 */
+		std::vector<int> starts;
+
+		/**
+		 * Is the DFA up to date with the patterns?
+		 *
+		 * @private
+		 */
+		bool compiled = false;
+
+		/**
+		 * Bytes no pattern tells apart share a class, the DFA
+		 * has 1 transition per class instead of 256.
+		 *
+		 * @private
+		 */
+		unsigned char classes[256];
+
+		/**
+		 * A byte of each class.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned char> representatives;
+
+		/**
+		 * The cached DFA states, 0 is the start state.
+		 *
+		 * @private
+		 */
+		std::vector<dfastate> dfa;
+
+		/**
+		 * Transitions, dfa state * amount of classes + class,
+		 * -1 when not built yet.
+		 *
+		 * @private
+		 */
+		std::vector<int> transitions;
+
+		/**
+		 * DFA state of each NFA state set.
+		 *
+		 * @private
+		 */
+		std::unordered_map<std::string, int> dfaindex;
+
+		/**
+		 * Marks for the epsilon closure.
+		 *
+		 * @private
+		 */
+		std::vector<unsigned int> marks;
+		unsigned int generation = 0;
+
+		/**
+		 * Marks for the patterns already matched by match().
+		 *
+		 * @private
+		 */
+		std::vector<unsigned int> seen;
+		unsigned int round = 0;
+
+		/**
+		 * Parse the alternatives of a pattern.
+		 *
+		 * @private
+		 *
+		 * @param pattern = The pattern.
+		 * @param     pos = Current position in the pattern.
+		 * @param   depth = Nesting level of parentheses.
+		 * @return The node.
+		 */
+		node parsealternate(const std::string &pattern, unsigned long &pos,
+				const unsigned int &depth);
+
+		/**
+		 * Parse a sequence of atoms.
+		 *
+		 * @private
+		 *
+		 * @param pattern = The pattern.
+		 * @param     pos = Current position in the pattern.
+		 * @param   depth = Nesting level of parentheses.
+		 * @return The node.
+		 */
+		node parseconcat(const std::string &pattern, unsigned long &pos,
+				const unsigned int &depth);
+
+		/**
+		 * Parse an atom.
+		 *
+		 * @private
+		 *
+		 * @param pattern = The pattern.
+		 * @param     pos = Current position in the pattern.
+		 * @param   depth = Nesting level of parentheses.
+		 * @return The node.
+		 */
+		node parseatom(const std::string &pattern, unsigned long &pos,
+				const unsigned int &depth);
+
+		/**
+		 * Parse a [...] class, pos is after the [.
+		 *
+		 * @private
+		 *
+		 * @param pattern = The pattern.
+		 * @param     pos = Current position in the pattern.
+		 * @return Id of the set.
+		 */
+		unsigned int parseclass(const std::string &pattern, unsigned long &pos);
+
+		/**
+		 * Parse an escape, pos is after the \.
+		 *
+		 * @private
+		 *
+		 * @param pattern = The pattern.
+		 * @param     pos = Current position in the pattern.
+		 * @param     set = Where the characters are added.
+		 */
+		void parseescape(const std::string &pattern, unsigned long &pos,
+				std::bitset<256> &set);
+
+		/**
+		 * Store a set, adding the other case of letters if needed.
+		 *
+		 * @private
+		 *
+		 * @param      set = The set.
+		 * @param negated = Store the characters not in the set?
+		 * @return Id of the set.
+		 */
+		unsigned int addset(std::bitset<256> set, const bool &negated);
+
+		/**
+		 * Build the NFA states of a node.
+		 *
+		 * @private
+		 *
+		 * @param    n = The node.
+		 * @param next = The state following the node.
+		 * @return The first state of the node.
+		 */
+		int build(const node &n, const int &next);
+
+		/**
+		 * Add a NFA state.
+		 *
+		 * @private
+		 *
+		 * @return Position of the state.
+		 */
+		int addstate(const nfakind &kind, const unsigned int &value,
+				const int &out, const int &out1);
+
+		/**
+		 * Build the byte classes and start a new DFA.
+		 *
+		 * @private
+		 */
+		void compile();
+
+		/**
+		 * Empty the DFA cache, keeping only the start state.
+		 *
+		 * @private
+		 */
+		void reset();
+
+		/**
+		 * Get the DFA state of a set of NFA states, adding it
+		 * if needed.
+		 *
+		 * @private
+		 *
+		 * @param roots = The NFA states, before the epsilon closure.
+		 * @return The DFA state.
+		 */
+		int state(const std::vector<int> &roots);
+
+		/**
+		 * Build the transition of a DFA state for a byte class.
+		 *
+		 * @private
+		 *
+		 * @param  from = The DFA state.
+		 * @param klass = The byte class.
+		 * @return The next DFA state.
+		 */
+		int step(int from, const unsigned char &klass);
+
+		/**
+		 * Add the patterns matched by a DFA state to a list, once each.
+		 *
+		 * @private
+		 *
+		 * @param accepts = The patterns matched.
+		 * @param     ids = The list.
+		 */
+		void collect(const std::vector<unsigned int> &accepts, std::vector<unsigned int> &ids);
+	};
+
+	/**
+	 * Exceptions for class subjectfilter.
+	 */
+	class SubjectFilterException : public std::runtime_error
+	{
+		public: SubjectFilterException(const std::string& error) : runtime_error(error) {
+		}
+	};
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "xoverscan.hpp"
+namespace cppnntp {
+	/**
+	 * Constructor.
+	 *
+	 * @public
+	 *
+	 * @param      pool = The connections to use.
+	 * @param chunksize = Amount of article numbers per XOVER.
+	 * @param   retries = How many times a chunk is tried before
+	 * it is given up on.
+	 */
+	xoverscan::xoverscan(connectionpool &pool, const unsigned long &chunksize,
+			const unsigned short &retries)
+		: pool(pool), chunksize(chunksize ? chunksize : 1),
+		  retries(retries ? retries : 1) {
+	}
+
+	/**
+	 * Destructor.
+	 *
+	 * @public
+	 */
+	xoverscan::~xoverscan() {}
+
+	/**
+	 * Download the overview of every article in a group.
+	 *
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @param      rows = Where the rows are added, in article
+	 * number order.
+	 * @return     bool = Did every chunk succeed?
+	 */
+	bool xoverscan::scan(const std::string &groupname, overview &rows) {
+		unsigned long oldest, newest;
+		if (!bounds(groupname, oldest, newest))
+			return false;
+
+		return scan(groupname, oldest, newest, rows);
+	}
+
+	/**
+	 * Download the overview of a range of articles in a group.
+	 *
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @param     first = The oldest wanted article.
+	 * @param      last = The newest wanted article.
+	 * @param      rows = Where the rows are added, in article
+	 * number order.
+	 * @return     bool = Did every chunk succeed?
+	 */
+	bool xoverscan::scan(const std::string &groupname, const unsigned long &first,
+			const unsigned long &last, overview &rows) {
+		return scan(groupname, first, last,
+			[&rows](const overview &chunk) {
+				rows.add(chunk);
+				return true;
+			});
+	}
+
+	/**
+	 * Download the overview of a range of articles in a group
+	 * straight into an overview database.
+	 *
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @param     first = The oldest wanted article.
+	 * @param      last = The newest wanted article.
+	 * @param        db = Where the rows are appended.
+	 * @return     bool = Did every chunk succeed?
+	 */
+	bool xoverscan::scan(const std::string &groupname, const unsigned long &first,
+			const unsigned long &last, overviewdb &db) {
+		return scan(groupname, first, last,
+			[&db](const overview &chunk) {
+				db.append(chunk);
+				return true;
+			}) && db.flush();
+	}
+
+	/**
+	 * Download the overview of a range of articles in a group
+	 * and pass every chunk to a function.
+	 *
+	 * @note The function is called from the worker threads, but
+	 * never twice at the same time, and always in article
+	 * number order.
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @param     first = The oldest wanted article.
+	 * @param      last = The newest wanted article.
+	 * @param      sink = Called with the rows of each chunk,
+	 * returning false stops the scan.
+	 * @return     bool = Did every chunk succeed?
+	 */
+	bool xoverscan::scan(const std::string &groupname, const unsigned long &first,
+			const unsigned long &last,
+			const std::function<bool(const overview &)> &sink) {
+		if (last < first)
+			return true;
+
+		const unsigned long chunks = (last - first) / chunksize + 1;
+		const unsigned long count = std::min<unsigned long>(pool.size(), chunks);
+		// How far past the oldest unmerged chunk a chunk is handed
+		// out, so a slow chunk can not make the others pile up.
+		const unsigned long window = count * 2;
+		// Set when a chunk failed or the sink wants us to stop.
+		std::atomic<bool> failed(false), stopped(false);
+
+		// Next chunk to hand out, chunks that finished before an
+		// older chunk, and the next chunk number the sink expects.
+		// Protected by lock, room is signalled when merged moves.
+		std::mutex lock;
+		std::condition_variable room;
+		unsigned long next = 0;
+		std::map<unsigned long, std::unique_ptr<overview> > finished;
+		unsigned long merged = 0;
+
+		auto worker = [&]() {
+			nntp *connection = NULL;
+			unsigned long chunk;
+			while (true) {
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					room.wait(guard, [&]() {
+						return stopped || next >= chunks || next < merged + window;
+					});
+					if (stopped || next >= chunks)
+						break;
+					chunk = next++;
+				}
+
+				const unsigned long start = first + chunk * chunksize;
+				const unsigned long end = std::min(last, start + chunksize - 1);
+
+				std::unique_ptr<overview> rows(new overview());
+				bool fetched = false;
+				for (unsigned short attempt = 0; attempt < retries && !fetched; attempt++) {
+					try {
+						// Every new connection has to select the group.
+						if (connection == NULL) {
+							connection = pool.acquire();
+							if (connection == NULL)
+								continue;
+							if (!connection->group(groupname))
+								throw NNTPException("Unable to select " + groupname);
+						}
+
+						rows->clear();
+						fetched = connection->xover(std::to_string(start),
+								std::to_string(end), *rows);
+					} catch (const std::exception &) {
+						fetched = false;
+					}
+
+					// Retry on a fresh connection.
+					if (!fetched && connection != NULL) {
+						pool.release(connection, true);
+						connection = NULL;
+					}
+				}
+
+				if (!fetched) {
+					failed = true;
+					rows.reset();
+				}
+
+				// Hand every chunk that is now in order to the sink, stop
+				// at a failed chunk so the sink never sees a gap.
+				std::lock_guard<std::mutex> guard(lock);
+				finished[chunk] = std::move(rows);
+				while (!finished.empty() && finished.begin()->first == merged) {
+					if (!finished.begin()->second)
+						stopped = true;
+					else if (!stopped && !sink(*finished.begin()->second))
+						stopped = true;
+					finished.erase(finished.begin());
+					merged++;
+				}
+				room.notify_all();
+			}
+
+			if (connection != NULL)
+				pool.release(connection);
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned long i = 0; i < count; i++)
+			threads.push_back(std::thread(worker));
+		for (unsigned long i = 0; i < threads.size(); i++)
+			threads[i].join();
+
+		return !failed && !stopped;
+	}
+
+	/**
+	 * Get the oldest and newest article of a group.
+	 *
+	 * @public
+	 *
+	 * @param groupname = The name of the group.
+	 * @param    oldest = Where the oldest article number is stored.
+	 * @param    newest = Where the newest article number is stored.
+	 * @return     bool = Did we select the group?
+	 */
+	bool xoverscan::bounds(const std::string &groupname, unsigned long &oldest,
+			unsigned long &newest) {
+		nntp *connection = pool.acquire();
+		if (connection == NULL)
+			return false;
+
+		try {
+			if (!connection->group(groupname)) {
+				pool.release(connection);
+				return false;
+			}
+			oldest = connection->group_oldest();
+			newest = connection->group_newest();
+		} catch (const std::exception &) {
+			pool.release(connection, true);
+			return false;
+		}
+
+		pool.release(connection);
+		return true;
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <functional>
+#include <string>
+#include "connectionpool.hpp"
+#include "overview.hpp"
+#include "overviewdb.hpp"
+
+namespace cppnntp
+{
+	/**
+	 * Downloads the overview of a range of articles using every
+	 * connection of a pool at once.
+	 *
+	 * @note The range is split in chunks, each connection selects the
+	 * group and takes the next chunk until none are left. Finished
+	 * chunks are merged in article number order, a chunk that fails
+	 * is retried on a fresh connection. If a chunk still fails, no
+	 * newer chunk is passed on, so the rows never have a gap. A chunk
+	 * is only handed out while it is less than twice the amount of
+	 * connections past the oldest chunk not merged yet, so the
+	 * finished chunks waiting on a slow one stay bounded.
+	 */
+	class xoverscan
+	{
+	public:
+		/**
+		 * Constructor.
+		 *
+		 * @public
+		 *
+		 * @param      pool = The connections to use.
+		 * @param chunksize = Amount of article numbers per XOVER.
+		 * @param   retries = How many times a chunk is tried before
+		 * it is given up on.
+		 */
+		xoverscan(connectionpool &pool, const unsigned long &chunksize = 50000,
+				const unsigned short &retries = 3);
+
+		/**
+		 * Destructor.
+		 *
+		 * @public
+		 */
+		~xoverscan();
+
+		/**
+		 * Download the overview of every article in a group.
+		 *
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @param      rows = Where the rows are added, in article
+		 * number order.
+		 * @return     bool = Did every chunk succeed?
+		 */
+		bool scan(const std::string &groupname, overview &rows);
+
+		/**
+		 * Download the overview of a range of articles in a group.
+		 *
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @param     first = The oldest wanted article.
+		 * @param      last = The newest wanted article.
+		 * @param      rows = Where the rows are added, in article
+		 * number order.
+		 * @return     bool = Did every chunk succeed?
+		 */
+		bool scan(const std::string &groupname, const unsigned long &first,
+				const unsigned long &last, overview &rows);
+
+		/**
+		 * Download the overview of a range of articles in a group
+		 * straight into an overview database.
+		 *
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @param     first = The oldest wanted article.
+		 * @param      last = The newest wanted article.
+		 * @param        db = Where the rows are appended.
+		 * @return     bool = Did every chunk succeed?
+		 */
+		bool scan(const std::string &groupname, const unsigned long &first,
+				const unsigned long &last, overviewdb &db);
+
+		/**
+		 * Download the overview of a range of articles in a group
+		 * and pass every chunk to a function.
+		 *
+		 * @note The function is called from the worker threads, but
+		 * never twice at the same time, and always in article
+		 * number order.
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @param     first = The oldest wanted article.
+		 * @param      last = The newest wanted article.
+		 * @param      sink = Called with the rows of each chunk,
+		 * returning false stops the scan.
+		 * @return     bool = Did every chunk succeed?
+		 */
+		bool scan(const std::string &groupname, const unsigned long &first,
+				const unsigned long &last,
+				const std::function<bool(const overview &)> &sink);
+
+		/**
+		 * Get the oldest and newest article of a group.
+		 *
+		 * @public
+		 *
+		 * @param groupname = The name of the group.
+		 * @param    oldest = Where the oldest article number is stored.
+		 * @param    newest = Where the newest article number is stored.
+		 * @return     bool = Did we select the group?
+		 */
+		bool bounds(const std::string &groupname, unsigned long &oldest,
+				unsigned long &newest);
+
+	private:
+		/**
+		 * The connections to use.
+		 *
+		 * @private
+		 */
+		connectionpool &pool;
+
+		/**
+		 * Amount of article numbers per XOVER.
+		 *
+		 * @private
+		 */
+		unsigned long chunksize;
+
+		/**
+		 * How many times a chunk is tried.
+		 *
+		 * @private
+		 */
+		unsigned short retries;
+	};
+}
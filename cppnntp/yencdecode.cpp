@@ -1,3 +1,5 @@
+#include <cstring>
+#include <zlib.h>
 #include "yencdecode.hpp"
 namespace cppnntp {
 	/**
@@ -65,4 +67,234 @@ namespace cppnntp {
 		}
 		return true;
 	}
+
+	/**
+	 * Find the value of a keyword on a yEnc header line.
+	 *
+	 * @param   line = The line.
+	 * @param    end = End of the line.
+	 * @param    key = The keyword with the =, (example: "size=").
+	 * @return Start of the value, NULL if missing.
+	 */
+	static const char *yencvalue(const char *line, const char *end, const char *key) {
+		const unsigned long keylength = std::strlen(key);
+		for (const char *pos = line; pos + keylength <= end; pos++) {
+			if ((pos == line || pos[-1] == ' ') && std::memcmp(pos, key, keylength) == 0)
+				return pos + keylength;
+		}
+		return NULL;
+	}
+
+	/**
+	 * Read a yEnc header number.
+	 *
+	 * @param line = The line.
+	 * @param  end = End of the line.
+	 * @param  key = The keyword with the =.
+	 * @param base = 10, or 16 for CRCs.
+	 * @return The number, 0 if missing.
+	 */
+	static unsigned long yencnumber(const char *line, const char *end, const char *key,
+			const unsigned short &base = 10) {
+		const char *pos = yencvalue(line, end, key);
+		unsigned long value = 0;
+		for (; pos != NULL && pos < end; pos++) {
+			const char c = *pos;
+			if (c >= '0' && c <= '9')
+				value = value * base + (c - '0');
+			else if (base == 16 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+				value = value * base + ((c | 0x20) - 'a' + 10);
+			else
+				break;
+		}
+		return value;
+	}
+
+	/**
+	 * Decode a yEnc article without regex, in 1 pass.
+	 *
+	 * @note Lines starting with .. (dot stuffed by the server) are
+	 * handled, so a raw BODY response can be passed as is.
+	 * The decoded data is appended to outdata.
+	 * @public
+	 *
+	 * @param    data = The article, or the whole BODY response.
+	 * @param  length = Length of the article.
+	 * @param outdata = Where the decoded data is appended.
+	 * @param    info = Where the yEnc header values are stored.
+	 * @return   bool = Were =ybegin and =yend found? (See
+	 * info.valid for the size and CRC32 check.)
+	 */
+	bool yencdecode::decode(const char *data, const unsigned long &length,
+			std::string &outdata, yencinfo &info) {
+		const char *end = data + length;
+		const char *pos = header(data, length, info);
+		if (pos == NULL)
+			return false;
+
+		// The output is never longer than the input.
+		const std::string::size_type start = outdata.length();
+		outdata.resize(start + (end - pos));
+		unsigned long decoded = 0;
+		const bool ended = body(pos, end - pos, &outdata[start], end - pos, decoded, info);
+		outdata.resize(start + decoded);
+		return ended;
+	}
+
+	/**
+	 * Read the =ybegin and =ypart lines of a yEnc article.
+	 *
+	 * @note Used with body to decode straight into the memory the
+	 * data goes to, once info says where that is.
+	 * @public
+	 *
+	 * @param   data = The article, or the whole BODY response.
+	 * @param length = Length of the article.
+	 * @param   info = Where the yEnc header values are stored.
+	 * @return Where the encoded data starts, NULL if there is no
+	 * =ybegin line.
+	 */
+	const char *yencdecode::header(const char *data, const unsigned long &length, yencinfo &info) {
+		info.part = info.total = 0;
+		info.size = info.begin = info.end = 0;
+		info.name.clear();
+		info.crc = 0;
+		info.hascrc = info.valid = false;
+
+		const char *pos = data;
+		const char *end = data + length;
+
+		// Find the =ybegin line.
+		while (true) {
+			if (end - pos >= 8 && std::memcmp(pos, "=ybegin ", 8) == 0)
+				break;
+			pos = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+			if (pos == NULL)
+				return NULL;
+			pos++;
+		}
+		const char *eol = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+		if (eol == NULL)
+			return NULL;
+		const char *lineend = eol > pos && eol[-1] == '\r' ? eol - 1 : eol;
+		info.part = yencnumber(pos, lineend, "part=");
+		info.total = yencnumber(pos, lineend, "total=");
+		info.size = yencnumber(pos, lineend, "size=");
+		// The name is the rest of the line, it can hold spaces.
+		const char *name = yencvalue(pos, lineend, "name=");
+		if (name != NULL)
+			info.name.assign(name, lineend);
+		pos = eol + 1;
+
+		if (end - pos >= 7 && std::memcmp(pos, "=ypart ", 7) == 0) {
+			eol = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+			if (eol == NULL)
+				return NULL;
+			info.begin = yencnumber(pos, eol, "begin=");
+			info.end = yencnumber(pos, eol, "end=");
+			pos = eol + 1;
+		}
+		return pos;
+	}
+
+	/**
+	 * Decode the data of a yEnc article, after header.
+	 *
+	 * @public
+	 *
+	 * @param     data = Where the encoded data starts (returned by header).
+	 * @param   length = Bytes left in the article.
+	 * @param      out = Where the decoded data is written.
+	 * @param capacity = Most bytes out can take.
+	 * @param  decoded = Set to the amount of bytes decoded.
+	 * @param     info = The values from header, the =yend values
+	 * and valid are set.
+	 * @return    bool = Was =yend found, without going over capacity?
+	 */
+	bool yencdecode::body(const char *data, const unsigned long &length, char *out,
+			const unsigned long &capacity, unsigned long &decoded, yencinfo &info) {
+		const char *pos = data;
+		const char *end = data + length;
+		const char *eol;
+		unsigned char *next = reinterpret_cast<unsigned char *>(out);
+		unsigned char *const first = next;
+		unsigned char *const last = first + capacity;
+		bool ended = false, overflow = false;
+		// Decode line by line.
+		while (pos < end) {
+			// Dot stuffing, and the end of the NNTP response.
+			if (*pos == '.') {
+				if (end - pos >= 2 && pos[1] == '.')
+					pos++;
+				else if (end - pos >= 3 && pos[1] == '\r' && pos[2] == '\n')
+					break;
+			}
+			if (end - pos >= 5 && std::memcmp(pos, "=yend", 5) == 0) {
+				eol = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+				if (eol == NULL)
+					eol = end;
+				const unsigned long endsize = yencnumber(pos, eol, "size=");
+				if (yencvalue(pos, eol, "pcrc32=") != NULL) {
+					info.crc = yencnumber(pos, eol, "pcrc32=", 16);
+					info.hascrc = true;
+				} else if (yencvalue(pos, eol, "crc32=") != NULL && info.begin == 0) {
+					info.crc = yencnumber(pos, eol, "crc32=", 16);
+					info.hascrc = true;
+				}
+				ended = true;
+				info.valid = endsize == static_cast<unsigned long>(next - first);
+				break;
+			}
+
+			const unsigned char *p = reinterpret_cast<const unsigned char *>(pos);
+			const unsigned char *lend = static_cast<const unsigned char *>(std::memchr(p, '\n', end - pos));
+			if (lend == NULL)
+				lend = reinterpret_cast<const unsigned char *>(end);
+			// A line never decodes to more bytes than it has, only a
+			// line that might not fit is checked byte by byte.
+			if (lend - p > last - next) {
+				for (; p < lend; p++) {
+					unsigned char c = *p;
+					if (c == '\r')
+						continue;
+					if (c == '=') {
+						if (++p == lend)
+							break;
+						c = *p - 64;
+					}
+					if (next == last) {
+						overflow = true;
+						break;
+					}
+					*next++ = c - 42;
+				}
+				if (overflow)
+					break;
+			} else {
+				for (; p < lend; p++) {
+					unsigned char c = *p;
+					if (c == '\r')
+						continue;
+					if (c == '=') {
+						if (++p == lend)
+							break;
+						c = *p - 64;
+					}
+					*next++ = c - 42;
+				}
+			}
+			pos = reinterpret_cast<const char *>(lend) + 1;
+		}
+		decoded = next - first;
+
+		if (!ended || overflow) {
+			info.valid = false;
+			return false;
+		}
+		if (info.begin != 0 && info.end >= info.begin && info.end - info.begin + 1 != decoded)
+			info.valid = false;
+		if (info.valid && info.hascrc)
+			info.valid = crc32(0, reinterpret_cast<const Bytef *>(first), decoded) == info.crc;
+		return true;
+	}
 }
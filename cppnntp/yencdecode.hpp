@@ -1,10 +1,54 @@
 #pragma once
 #include <boost/regex.hpp>
 #include "boostRegexExceptions.hpp"
+#include <cstdint>
 #include <iostream>
+#include <string>
 
 namespace cppnntp
 {
+	/**
+	 * What the =ybegin, =ypart and =yend lines of a yEnc
+	 * article say.
+	 */
+	struct yencinfo
+	{
+		/**
+		 * Part number and amount of parts, 0 for single part posts.
+		 */
+		unsigned int part;
+		unsigned int total;
+
+		/**
+		 * Size of the whole file.
+		 */
+		unsigned long size;
+
+		/**
+		 * First and last byte of the part in the file, starting
+		 * from 1 (0 for single part posts).
+		 */
+		unsigned long begin;
+		unsigned long end;
+
+		/**
+		 * Name of the file.
+		 */
+		std::string name;
+
+		/**
+		 * CRC32 of the part (pcrc32, or crc32 for single part
+		 * posts) and was it present?
+		 */
+		uint32_t crc;
+		bool hascrc;
+
+		/**
+		 * Did the size and the CRC32 of the decoded data match?
+		 */
+		bool valid;
+	};
+
 	class yencdecode
 	{
 	public:
@@ -35,5 +79,55 @@ namespace cppnntp
 		 * @return   bool = True if it was decoded.
 		 */
 		bool decodeyencstring(const std::string &indata, std::string &outdata);
+
+		/**
+		 * Decode a yEnc article without regex, in 1 pass.
+		 *
+		 * @note Lines starting with .. (dot stuffed by the server) are
+		 * handled, so a raw BODY response can be passed as is.
+		 * The decoded data is appended to outdata.
+		 * @public
+		 *
+		 * @param    data = The article, or the whole BODY response.
+		 * @param  length = Length of the article.
+		 * @param outdata = Where the decoded data is appended.
+		 * @param    info = Where the yEnc header values are stored.
+		 * @return   bool = Were =ybegin and =yend found? (See
+		 * info.valid for the size and CRC32 check.)
+		 */
+		static bool decode(const char *data, const unsigned long &length,
+				std::string &outdata, yencinfo &info);
+
+		/**
+		 * Read the =ybegin and =ypart lines of a yEnc article.
+		 *
+		 * @note Used with body to decode straight into the memory the
+		 * data goes to, once info says where that is.
+		 * @public
+		 *
+		 * @param   data = The article, or the whole BODY response.
+		 * @param length = Length of the article.
+		 * @param   info = Where the yEnc header values are stored.
+		 * @return Where the encoded data starts, NULL if there is no
+		 * =ybegin line.
+		 */
+		static const char *header(const char *data, const unsigned long &length, yencinfo &info);
+
+		/**
+		 * Decode the data of a yEnc article, after header.
+		 *
+		 * @public
+		 *
+		 * @param     data = Where the encoded data starts (returned by header).
+		 * @param   length = Bytes left in the article.
+		 * @param      out = Where the decoded data is written.
+		 * @param capacity = Most bytes out can take.
+		 * @param  decoded = Set to the amount of bytes decoded.
+		 * @param     info = The values from header, the =yend values
+		 * and valid are set.
+		 * @return    bool = Was =yend found, without going over capacity?
+		 */
+		static bool body(const char *data, const unsigned long &length, char *out,
+				const unsigned long &capacity, unsigned long &decoded, yencinfo &info);
 	};
 }
@@ -96,6 +96,20 @@ void start() {
 				if (!nntp.xover(xover))
 					continue;
 			}
+			else if (in == "hdr") {
+				std::string header, start, end;
+				std::cout << "Please enter a header name (example: Subject).\n> ";
+				std::getline (std::cin, header);
+				std::cout << "Please enter the oldest article number.\n> ";
+				std::getline (std::cin, start);
+				std::cout << "Please enter the newest article number.\n> ";
+				std::getline (std::cin, end);
+				cppnntp::hdrlist values;
+				if (!nntp.hdr(header, start, end, values))
+					continue;
+				for (unsigned long i = 0; i < values.size(); i++)
+					std::cout << values.number(i) << ": " << values.value(i).str() << std::endl;
+			}
 			else
 				std::cout << "Command not understood, type help.\n";
 		} catch (const std::runtime_error &e) {
@@ -132,7 +146,8 @@ void help() {
 	<< "article        : Display an article.\n"
 	<< "body           : Display the body of an article.\n"
 	<< "head           : Display the header of an article.\n"
-	<< "xover          : Display the header of an article.\n";
+	<< "xover          : Display the header of an article.\n"
+	<< "hdr            : Display 1 header for a range of articles.\n";
 }
 
 bool readconf() {